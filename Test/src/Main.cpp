@@ -6,11 +6,16 @@
 #include <SoftwareCore/DefaultLogger.hpp>
 #include <SoftwareCore/Process.hpp>
 #include <Eigen/Dense>
+#include <algorithm>
 #include <array>
+#include <atomic>
 #include <chrono>
+#include <cstring>
 #include <future>
 #include <iostream>
 #include <thread>
+#include <utility>
+#include <vector>
 
 const int windowWidth = 720;
 const int windowHeight = 480;
@@ -213,6 +218,125 @@ void HandleInput(float timeDelta)
 	lastMouseY = mouseY;
 }
 
+// Benchmarks (run with --benchmark).
+
+// Per-call cost of SetUniform from several producer threads while the render thread drains the updates.
+void BenchmarkUniformUpdates(HawkEye::Pipeline& pipeline, EverViewport::Window* window)
+{
+	const int producerCount = 8;
+	const int callsPerProducer = 100000;
+	const HawkEye::HUniform cameraUniform = pipeline.GetUniformHandle("rasterizedNode", "camera");
+
+	std::atomic<int> runningProducers(producerCount);
+	std::vector<double> callNanoseconds(producerCount);
+	std::vector<std::thread> producers;
+	for (int p = 0; p < producerCount; ++p)
+	{
+		producers.emplace_back([&, p]()
+		{
+			Eigen::Matrix4f matrix = Eigen::Matrix4f::Identity();
+			auto start = std::chrono::high_resolution_clock::now();
+			for (int c = 0; c < callsPerProducer; ++c)
+			{
+				matrix(0, 3) = float(c);
+				pipeline.SetUniform(cameraUniform, matrix);
+			}
+			auto end = std::chrono::high_resolution_clock::now();
+			callNanoseconds[p] = std::chrono::duration<double, std::nano>(end - start).count() / callsPerProducer;
+			--runningProducers;
+		});
+	}
+
+	int frameCount = 0;
+	while (runningProducers > 0)
+	{
+		window->PollMessages();
+		pipeline.DrawFrame();
+		++frameCount;
+	}
+	for (auto& producer : producers)
+	{
+		producer.join();
+	}
+
+	double averageNanoseconds = 0;
+	double slowestNanoseconds = 0;
+	for (int p = 0; p < producerCount; ++p)
+	{
+		averageNanoseconds += callNanoseconds[p] / producerCount;
+		slowestNanoseconds = std::max(slowestNanoseconds, callNanoseconds[p]);
+	}
+	CoreLogInfo(DefaultLogger, "Benchmark: SetUniform from %d threads - %.1f ns per call on average, %.1f ns on the slowest thread (%d frames drawn).",
+		producerCount, averageNanoseconds, slowestNanoseconds, frameCount);
+}
+
+static uint64_t GetDeviceLocalBytes(HawkEye::HRendererData rendererData)
+{
+	return HawkEye::GetMemoryReport(rendererData).deviceLocalBytes;
+}
+
+// Encoding throughput of CompressTexture and the device memory each format saves over 8-bit RGBA.
+void BenchmarkTextureCompression(HawkEye::HRendererData rendererData)
+{
+	constexpr int width = 2048;
+	constexpr int height = 2048;
+	std::vector<unsigned char> image(HawkEye::GetTextureDataSize(width, height, HawkEye::TextureFormat::RGBA,
+		HawkEye::TextureCompression::None));
+	for (int y = 0; y < height; ++y)
+	{
+		for (int x = 0; x < width; ++x)
+		{
+			// Gradients with a fine pattern on top, so that the blocks are not flat.
+			image[(y * width + x) * 4 + 0] = (unsigned char)(x * 255 / (width - 1));
+			image[(y * width + x) * 4 + 1] = (unsigned char)(y * 255 / (height - 1));
+			image[(y * width + x) * 4 + 2] = (unsigned char)((x ^ y) & 255);
+			image[(y * width + x) * 4 + 3] = (unsigned char)(255 - ((x + y) & 63));
+		}
+	}
+
+	uint64_t deviceLocalBytes = GetDeviceLocalBytes(rendererData);
+	HawkEye::HTexture uncompressedTexture = HawkEye::UploadTexture(rendererData, image.data(), (int)image.size(), width, height,
+		HawkEye::TextureFormat::RGBA, HawkEye::ColorCompression::None, HawkEye::TextureCompression::None, false);
+	const uint64_t uncompressedBytes = GetDeviceLocalBytes(rendererData) - deviceLocalBytes;
+	HawkEye::WaitForUpload(rendererData, uncompressedTexture);
+
+	const std::pair<HawkEye::TextureCompression, const char*> compressions[] =
+	{
+		{ HawkEye::TextureCompression::BC1, "BC1" },
+		{ HawkEye::TextureCompression::BC3, "BC3" },
+		{ HawkEye::TextureCompression::BC4, "BC4" },
+		{ HawkEye::TextureCompression::BC5, "BC5" },
+		{ HawkEye::TextureCompression::BC7, "BC7" }
+	};
+	for (const auto& compression : compressions)
+	{
+		std::vector<unsigned char> blocks(HawkEye::GetTextureDataSize(width, height, HawkEye::TextureFormat::RGBA,
+			compression.first));
+
+		auto start = std::chrono::high_resolution_clock::now();
+		if (!HawkEye::CompressTexture(rendererData, image.data(), width, height, compression.first, blocks.data()))
+		{
+			CoreLogError(DefaultLogger, "Benchmark: Failed to encode %s - skipping.", compression.second);
+			continue;
+		}
+		auto end = std::chrono::high_resolution_clock::now();
+		const double seconds = std::chrono::duration<double>(end - start).count();
+
+		deviceLocalBytes = GetDeviceLocalBytes(rendererData);
+		HawkEye::HTexture compressedTexture = HawkEye::UploadTexture(rendererData, blocks.data(), (int)blocks.size(), width, height,
+			HawkEye::TextureFormat::RGBA, HawkEye::ColorCompression::None, compression.first, false);
+		const uint64_t compressedBytes = GetDeviceLocalBytes(rendererData) - deviceLocalBytes;
+		HawkEye::WaitForUpload(rendererData, compressedTexture);
+		HawkEye::DeleteTexture(rendererData, compressedTexture);
+
+		CoreLogInfo(DefaultLogger, "Benchmark: %s encoding - %.1f megapixels/s, %llu KiB of device memory instead of %llu KiB (%llu KiB saved).",
+			compression.second, width * height / seconds / 1000000.0, (unsigned long long)(compressedBytes / 1024),
+			(unsigned long long)(uncompressedBytes / 1024), (unsigned long long)((uncompressedBytes - compressedBytes) / 1024));
+	}
+
+	HawkEye::DeleteTexture(rendererData, uncompressedTexture);
+}
+
 int main(int argc, char* argv[])
 {
 	//try
@@ -230,7 +354,10 @@ int main(int argc, char* argv[])
 
 		// Renderer data.
 
-		HawkEye::HRendererData rendererData = HawkEye::Initialize(backendConfigFile.c_str());
+		// Has to match the device features the backend configuration enables.
+		HawkEye::DeviceFeatures deviceFeatures;
+		deviceFeatures.timelineSemaphore = true;
+		HawkEye::HRendererData rendererData = HawkEye::Initialize(backendConfigFile.c_str(), deviceFeatures);
 
 		// Window.
 
@@ -379,6 +506,13 @@ int main(int argc, char* argv[])
 		drawBuffers[1].instanceBuffer = instanceBuffer;
 
 		renderingPipeline1.UseBuffers("rasterizedNode", drawBuffers, drawBufferCount);
+
+		if (argc > 1 && strcmp(argv[1], "--benchmark") == 0)
+		{
+			BenchmarkUniformUpdates(renderingPipeline1, testWindow1);
+			BenchmarkTextureCompression(rendererData);
+		}
+
 		Eigen::Matrix4f viewProjectionMatrix = camera1.GetProjectionMatrix() * camera1.GetViewMatrix();
 		renderingPipeline1.SetUniform("rasterizedNode", "camera", viewProjectionMatrix);
 		
@@ -394,7 +528,8 @@ int main(int argc, char* argv[])
 		float timeDelta = 1;
 		auto before = std::chrono::high_resolution_clock::now();
 		unsigned int currentTime = (unsigned int)(std::chrono::duration_cast<std::chrono::milliseconds>(before.time_since_epoch()).count());
-		renderingPipeline1.SetUniform("generativeNode", "time", currentTime);
+		const HawkEye::HUniform timeUniform = renderingPipeline1.GetUniformHandle("generativeNode", "time");
+		renderingPipeline1.SetUniform(timeUniform, currentTime);
 #ifdef SECOND_WINDOW
 		while (!testWindow1->ShouldClose() && !testWindow2->ShouldClose())
 #else
@@ -413,7 +548,7 @@ int main(int argc, char* argv[])
 			before = std::chrono::high_resolution_clock::now();
 			HandleInput(timeDelta);
 			unsigned int currentTime = (unsigned int)(std::chrono::duration_cast<std::chrono::milliseconds>(now.time_since_epoch()).count());
-			renderingPipeline1.SetUniform("generativeNode", "time", currentTime);
+			renderingPipeline1.SetUniform(timeUniform, currentTime);
 			
 			// Stabilizing frame rate.
 			if (timeDelta < targetTimeDelta)
@@ -1,5 +1,6 @@
 #pragma once
 #include <cstdint>
+#include <functional>
 #include <string>
 
 namespace HawkEye
@@ -7,9 +8,23 @@ namespace HawkEye
 	typedef struct HRendererData_t* HRendererData;
 	typedef struct HTexture_t* HTexture;
 	typedef struct HBuffer_t* HBuffer;
+	typedef struct HBufferArena_t* HBufferArena;
 	typedef int HMaterial;
+	typedef int HUniform;
 
-	HRendererData Initialize(const char* backendConfigFile);
+	// Device features enabled by the backend configuration. Vulkan cannot report the features a device
+	// was created with, so features that are not listed here are never used.
+	struct DeviceFeatures
+	{
+		// Timeline semaphores (core in Vulkan 1.2). Required, Initialize fails without them.
+		bool timelineSemaphore = false;
+		// Descriptor indexing with update-after-bind for sampled images and storage buffers, partially bound
+		// and update-unused-while-pending bindings, runtime descriptor arrays and non-uniform sampled image indexing.
+		// Without it, bindless nodes fall back to material descriptor sets.
+		bool descriptorIndexing = false;
+	};
+
+	HRendererData Initialize(const char* backendConfigFile, const DeviceFeatures& enabledFeatures = {});
 	void Shutdown();
 
 	class Pipeline
@@ -44,6 +59,10 @@ namespace HawkEye
 
 		uint64_t GetPresentedFrame() const;
 		uint64_t GetFramesInFlight() const;
+		// Heap allocations made for uniform updates. They only happen at Configure, SetUniform and UpdateUniforms never allocate.
+		uint64_t GetUpdateAllocationCount() const;
+		// Scratch copies taken from the frame arenas for uniform updates, at most one per updated uniform and frame.
+		uint64_t GetUpdateCopyCount() const;
 
 		uint64_t GetUUID() const;
 
@@ -59,7 +78,8 @@ namespace HawkEye
 			return CreateMaterialImpl(nodeName, &material, sizeof(MaterialType));
 		}
 
-		// TODO: Delete material.
+		// Drops the material's draws. The handle may be returned again by CreateMaterial.
+		void DeleteMaterial(const std::string& nodeName, HMaterial material);
 
 		void SetUniform(const std::string& nodeName, const std::string& name, HTexture texture);
 
@@ -77,11 +97,31 @@ namespace HawkEye
 
 		void SetUniform(const std::string& nodeName, const std::string& name, HBuffer buffer);
 
+		// Resolves the uniform once, so that frequent updates skip the name lookups. Returns -1 on failure.
+		HUniform GetUniformHandle(const std::string& nodeName, const std::string& name) const;
+
+		void SetUniform(HUniform uniform, HTexture texture);
+
+		template<typename Type>
+		void SetUniform(HUniform uniform, Type& data)
+		{
+			SetUniformImpl(uniform, &data, sizeof(Type));
+		}
+
+		template<typename Type>
+		void SetUniform(HUniform uniform, Type&& data)
+		{
+			SetUniformImpl(uniform, &data, sizeof(Type));
+		}
+
+		void SetUniform(HUniform uniform, HBuffer buffer);
+
 		struct Private;
 		Private* p_;
 
 	private:
 		void SetUniformImpl(const std::string& nodeName, const std::string& name, void* data, int dataSize);
+		void SetUniformImpl(HUniform uniform, void* data, int dataSize);
 		HMaterial CreateMaterialImpl(const std::string& nodeName, void* data, int dataSize);
 		void UpdateUniforms(int frameInFlight);
 	};
@@ -102,9 +142,16 @@ namespace HawkEye
 		SRGB
 	};
 
+	// The data of block-compressed textures are the blocks themselves (see CompressTexture).
+	// Block-compressed textures cannot generate mips on upload.
 	enum class TextureCompression
 	{
-		None
+		None,
+		BC1,
+		BC3,
+		BC4,
+		BC5,
+		BC7
 	};
 
 	enum class TextureQueue
@@ -113,14 +160,39 @@ namespace HawkEye
 		Compute
 	};
 
+	// GPU blits need blit and linear filter support for the format, otherwise no mips are generated.
+	// The CPU filters work for every uncompressed format and upload the whole chain in one copy.
+	enum class MipFilter
+	{
+		GpuBlit,
+		CpuBox,
+		CpuKaiser
+	};
+
 	HTexture UploadTexture(HRendererData rendererData, void* data, int dataSize, int width, int height,
 		TextureFormat format, ColorCompression colorCompression, TextureCompression textureCompression,
-		bool generateMips, TextureQueue usage = TextureQueue::General);
+		bool generateMips, TextureQueue usage = TextureQueue::General, MipFilter mipFilter = MipFilter::GpuBlit);
+	// Returns immediately; staging and recording happen on a background worker. The data has to stay valid until
+	// onRecorded is called (on the worker thread). Use UploadFinished/WaitForUpload to check that the copy has executed.
+	HTexture UploadTextureAsync(HRendererData rendererData, void* data, int dataSize, int width, int height,
+		TextureFormat format, ColorCompression colorCompression, TextureCompression textureCompression,
+		bool generateMips, TextureQueue usage = TextureQueue::General, MipFilter mipFilter = MipFilter::GpuBlit,
+		std::function<void(HTexture)> onRecorded = {});
+	// Maps a KTX2 or DDS file and stages its levels and array layers straight from the mapping, in the stored format.
+	// Returns nullptr if the file cannot be loaded.
+	HTexture LoadTextureFile(HRendererData rendererData, const char* path, TextureQueue usage = TextureQueue::General);
 	void DeleteTexture(HRendererData rendererData, HTexture& texture);
 
 	void WaitForUpload(HRendererData rendererData, HTexture texture);
 	bool UploadFinished(HRendererData rendererData, HTexture texture);
 
+	// Size of the 8-bit texels or, for block-compressed textures, of the blocks.
+	int GetTextureDataSize(int width, int height, TextureFormat format, TextureCompression textureCompression);
+	// Encodes 8-bit RGBA texels into blocks on the renderer's encoding workers, meant for import time.
+	// BC4 keeps the red channel, BC5 red and green. The output has to hold GetTextureDataSize bytes.
+	bool CompressTexture(HRendererData rendererData, const void* rgbaData, int width, int height,
+		TextureCompression textureCompression, void* compressedData);
+
 	// ======================== Buffers ========================
 
 	enum class BufferUsage
@@ -145,10 +217,55 @@ namespace HawkEye
 
 	HBuffer UploadBuffer(HRendererData rendererData, void* data, int dataSize, BufferUsage usage, BufferType type,
 		BufferQueue bufferQueue = BufferQueue::General);
+	// Same rules as UploadTextureAsync.
+	HBuffer UploadBufferAsync(HRendererData rendererData, void* data, int dataSize, BufferUsage usage, BufferType type,
+		BufferQueue bufferQueue = BufferQueue::General, std::function<void(HBuffer)> onRecorded = {});
 	void DeleteBuffer(HRendererData rendererData, HBuffer& buffer);
 
 	void UpdateBuffer(HRendererData rendererData, HBuffer buffer, void* data, int dataSize);
+	// Copies only the given range. Never waits on the CPU, the copy is ordered after the frames already submitted.
+	void UpdateBuffer(HRendererData rendererData, HBuffer buffer, int offset, void* data, int dataSize);
+
+	// One large device-local buffer that small buffers are sub-allocated from. Vertex and index arenas can hold both,
+	// so that the draws of a whole mesh batch bind the arena once and address their data by offsets.
+	HBufferArena CreateBufferArena(HRendererData rendererData, int size, BufferUsage usage);
+	// All buffers allocated from the arena have to be deleted first.
+	void DeleteBufferArena(HRendererData rendererData, HBufferArena& arena);
+	// Returns nullptr if the arena has no free range large enough. Deleted with DeleteBuffer like any other buffer.
+	HBuffer UploadBuffer(HRendererData rendererData, HBufferArena arena, void* data, int dataSize);
 
 	void WaitForUpload(HRendererData rendererData, HBuffer buffer);
 	bool UploadFinished(HRendererData rendererData, HBuffer buffer);
+
+	// ======================== Uploads ========================
+
+	// Uploads are batched and submitted together, at the latest when the next frame is drawn.
+	void FlushUploads(HRendererData rendererData);
+
+	struct UploadStatistics
+	{
+		uint64_t batchCount;
+		uint64_t copyCount;
+		uint64_t uploadedBytes;
+		// Last finished batch, timed from its submit until its completion was noticed.
+		uint64_t lastBatchCopyCount;
+		uint64_t lastBatchBytes;
+		double lastBatchMilliseconds;
+	};
+
+	UploadStatistics GetUploadStatistics(HRendererData rendererData);
+
+	// ======================== Memory =========================
+
+	struct MemoryReport
+	{
+		// Host memory reserved for staging (shared ring and oversized uploads still in flight).
+		uint64_t stagingBytes;
+		uint64_t stagingBytesInUse;
+		uint64_t deviceLocalBytes;
+		// Mapped buffers.
+		uint64_t hostVisibleBytes;
+	};
+
+	MemoryReport GetMemoryReport(HRendererData rendererData);
 }
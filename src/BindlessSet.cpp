@@ -0,0 +1,234 @@
+#include "BindlessSet.hpp"
+#include "RendererData.hpp"
+#include "Resources.hpp"
+#include <SoftwareCore/DefaultLogger.hpp>
+#include <VulkanBackend/ErrorCheck.hpp>
+#include <algorithm>
+
+void BindlessSet::Init(HawkEye::HRendererData rendererData, int textureCapacity, int bufferCapacity)
+{
+	this->rendererData = rendererData;
+	const VulkanBackend::BackendData& backendData = rendererData->backendData;
+
+	VkPhysicalDeviceDescriptorIndexingFeatures indexingFeatures{};
+	indexingFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES;
+	VkPhysicalDeviceFeatures2 features{};
+	features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+	features.pNext = &indexingFeatures;
+	vkGetPhysicalDeviceFeatures2(backendData.physicalDevice, &features);
+	if (!indexingFeatures.runtimeDescriptorArray || !indexingFeatures.descriptorBindingPartiallyBound ||
+		!indexingFeatures.descriptorBindingUpdateUnusedWhilePending ||
+		!indexingFeatures.descriptorBindingSampledImageUpdateAfterBind ||
+		!indexingFeatures.descriptorBindingStorageBufferUpdateAfterBind ||
+		!indexingFeatures.shaderSampledImageArrayNonUniformIndexing)
+	{
+		return;
+	}
+
+	VkPhysicalDeviceDescriptorIndexingProperties indexingProperties{};
+	indexingProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_PROPERTIES;
+	VkPhysicalDeviceProperties2 properties{};
+	properties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+	properties.pNext = &indexingProperties;
+	vkGetPhysicalDeviceProperties2(backendData.physicalDevice, &properties);
+	this->textureCapacity = std::min(textureCapacity,
+		(int)std::min(indexingProperties.maxPerStageDescriptorUpdateAfterBindSampledImages,
+			indexingProperties.maxDescriptorSetUpdateAfterBindSampledImages));
+	this->bufferCapacity = std::min(bufferCapacity,
+		(int)std::min(indexingProperties.maxPerStageDescriptorUpdateAfterBindStorageBuffers,
+			indexingProperties.maxDescriptorSetUpdateAfterBindStorageBuffers));
+
+	// descriptor set layout
+	VkDescriptorSetLayoutBinding layoutBindings[2]{};
+	layoutBindings[0].binding = 0;
+	layoutBindings[0].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+	layoutBindings[0].descriptorCount = (uint32_t)this->textureCapacity;
+	layoutBindings[0].stageFlags = VK_SHADER_STAGE_ALL;
+	layoutBindings[1].binding = 1;
+	layoutBindings[1].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+	layoutBindings[1].descriptorCount = (uint32_t)this->bufferCapacity;
+	layoutBindings[1].stageFlags = VK_SHADER_STAGE_ALL;
+
+	// Slots can be written while command buffers using other slots are pending.
+	const VkDescriptorBindingFlags bindingFlags[2] =
+	{
+		VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT | VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT |
+			VK_DESCRIPTOR_BINDING_UPDATE_UNUSED_WHILE_PENDING_BIT,
+		VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT | VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT |
+			VK_DESCRIPTOR_BINDING_UPDATE_UNUSED_WHILE_PENDING_BIT
+	};
+	VkDescriptorSetLayoutBindingFlagsCreateInfo bindingFlagsCreateInfo{};
+	bindingFlagsCreateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO;
+	bindingFlagsCreateInfo.bindingCount = 2;
+	bindingFlagsCreateInfo.pBindingFlags = bindingFlags;
+
+	VkDescriptorSetLayoutCreateInfo setLayoutCreateInfo{};
+	setLayoutCreateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+	setLayoutCreateInfo.pNext = &bindingFlagsCreateInfo;
+	setLayoutCreateInfo.flags = VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT;
+	setLayoutCreateInfo.bindingCount = 2;
+	setLayoutCreateInfo.pBindings = layoutBindings;
+	VulkanCheck(vkCreateDescriptorSetLayout(backendData.logicalDevice, &setLayoutCreateInfo, nullptr, &setLayout));
+
+	// descriptor pool
+	VkDescriptorPoolSize poolSizes[2];
+	poolSizes[0] = { VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, (uint32_t)this->textureCapacity };
+	poolSizes[1] = { VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, (uint32_t)this->bufferCapacity };
+
+	VkDescriptorPoolCreateInfo poolCreateInfo{};
+	poolCreateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+	poolCreateInfo.flags = VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT;
+	poolCreateInfo.maxSets = 1;
+	poolCreateInfo.poolSizeCount = 2;
+	poolCreateInfo.pPoolSizes = poolSizes;
+	VulkanCheck(vkCreateDescriptorPool(backendData.logicalDevice, &poolCreateInfo, nullptr, &descriptorPool));
+
+	descriptorSet = VulkanBackend::AllocateDescriptorSet(backendData, descriptorPool, setLayout);
+}
+
+void BindlessSet::Shutdown()
+{
+	if (descriptorPool != VK_NULL_HANDLE)
+	{
+		VulkanBackend::DestroyDescriptorPool(rendererData->backendData, descriptorPool);
+		VulkanBackend::DestroyDescriptorSetLayout(rendererData->backendData, setLayout);
+		descriptorPool = VK_NULL_HANDLE;
+		setLayout = VK_NULL_HANDLE;
+		descriptorSet = VK_NULL_HANDLE;
+	}
+	pendingTextures.clear();
+	retiredTextureSlots.clear();
+	retiredBufferSlots.clear();
+}
+
+bool BindlessSet::IsAvailable() const
+{
+	return descriptorSet != VK_NULL_HANDLE;
+}
+
+VkDescriptorSetLayout BindlessSet::GetSetLayout() const
+{
+	return setLayout;
+}
+
+VkDescriptorSet BindlessSet::GetSet() const
+{
+	return descriptorSet;
+}
+
+int BindlessSet::AllocateIndex(std::vector<int>& freeIndices, std::vector<RetiredSlot>& retiredSlots, int& usedCount, int capacity)
+{
+	for (int r = (int)retiredSlots.size() - 1; r >= 0; --r)
+	{
+		if (rendererData->graphicsTimeline.Reached(retiredSlots[r].graphicsValue))
+		{
+			freeIndices.push_back(retiredSlots[r].index);
+			retiredSlots[r] = retiredSlots.back();
+			retiredSlots.pop_back();
+		}
+	}
+
+	if (!freeIndices.empty())
+	{
+		const int index = freeIndices.back();
+		freeIndices.pop_back();
+		return index;
+	}
+	if (usedCount == capacity)
+	{
+		return -1;
+	}
+	return usedCount++;
+}
+
+int BindlessSet::AddTexture(HawkEye::HTexture texture)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	const int index = AllocateIndex(freeTextureIndices, retiredTextureSlots, usedTextureCount, textureCapacity);
+	if (index < 0)
+	{
+		CoreLogError(DefaultLogger, "Bindless set: All %d texture slots are in use.", textureCapacity);
+		return -1;
+	}
+
+	if (HawkEye::UploadFinished(rendererData, texture))
+	{
+		WriteTexture(index, texture);
+	}
+	else
+	{
+		WriteTexture(index, rendererData->placeholderTexture);
+		pendingTextures.push_back({ index, texture });
+	}
+	return index;
+}
+
+int BindlessSet::AddBuffer(HawkEye::HBuffer buffer)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	const int index = AllocateIndex(freeBufferIndices, retiredBufferSlots, usedBufferCount, bufferCapacity);
+	if (index < 0)
+	{
+		CoreLogError(DefaultLogger, "Bindless set: All %d buffer slots are in use.", bufferCapacity);
+		return -1;
+	}
+
+	WriteBuffer(index, buffer);
+	return index;
+}
+
+void BindlessSet::RemoveTexture(int index)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	for (int p = 0; p < pendingTextures.size(); ++p)
+	{
+		if (pendingTextures[p].first == index)
+		{
+			pendingTextures[p] = pendingTextures.back();
+			pendingTextures.pop_back();
+			break;
+		}
+	}
+	retiredTextureSlots.push_back({ rendererData->graphicsTimeline.GetSubmittedValue(), index });
+}
+
+void BindlessSet::RemoveBuffer(int index)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	retiredBufferSlots.push_back({ rendererData->graphicsTimeline.GetSubmittedValue(), index });
+}
+
+void BindlessSet::ApplyPendingWrites()
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	for (int p = (int)pendingTextures.size() - 1; p >= 0; --p)
+	{
+		if (HawkEye::UploadFinished(rendererData, pendingTextures[p].second))
+		{
+			WriteTexture(pendingTextures[p].first, pendingTextures[p].second);
+			pendingTextures[p] = pendingTextures.back();
+			pendingTextures.pop_back();
+		}
+	}
+}
+
+void BindlessSet::WriteTexture(int index, HawkEye::HTexture texture)
+{
+	// Uploads always leave textures ready for sampling.
+	VkDescriptorImageInfo imageInfo{};
+	imageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+	imageInfo.imageView = texture->imageView;
+	imageInfo.sampler = texture->sampler;
+
+	rendererData->descriptorWriter.WriteImage(descriptorSet, 0, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, imageInfo, index);
+}
+
+void BindlessSet::WriteBuffer(int index, HawkEye::HBuffer buffer)
+{
+	VkDescriptorBufferInfo bufferInfo{};
+	bufferInfo.buffer = buffer->buffer.buffer;
+	bufferInfo.offset = buffer->offset;
+	bufferInfo.range = buffer->dataSize;
+
+	rendererData->descriptorWriter.WriteBuffer(descriptorSet, 1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, bufferInfo, index);
+}
@@ -0,0 +1,68 @@
+#pragma once
+#include "HawkEye/HawkEyeAPI.hpp"
+#include <VulkanBackend/VulkanBackendAPI.hpp>
+#include <vulkan/vulkan.hpp>
+#include <mutex>
+#include <vector>
+
+// Global descriptor set of partially bound, update-after-bind arrays (descriptor indexing).
+// Binding 0 holds combined image samplers, binding 1 storage buffers; resources are referenced by their array index.
+class BindlessSet
+{
+public:
+	BindlessSet() = default;
+	~BindlessSet() = default;
+
+	// Only called if the application declared descriptor indexing enabled in the backend configuration.
+	// Stays unavailable if the device does not support all of the required features anyway.
+	// Slots are written through the renderer's descriptor writer.
+	void Init(HawkEye::HRendererData rendererData, int textureCapacity, int bufferCapacity);
+	void Shutdown();
+
+	bool IsAvailable() const;
+	VkDescriptorSetLayout GetSetLayout() const;
+	VkDescriptorSet GetSet() const;
+
+	// Return -1 if the array is full.
+	// Textures still being uploaded get the renderer's placeholder until ApplyPendingWrites finds their upload completed.
+	// Buffers are written right away, frames wait for their uploads on the GPU.
+	int AddTexture(HawkEye::HTexture texture);
+	int AddBuffer(HawkEye::HBuffer buffer);
+	// Command buffers recorded from now on may no longer use the index.
+	// It is reused once the graphics work submitted before the removal has finished.
+	void RemoveTexture(int index);
+	void RemoveBuffer(int index);
+
+	// Slots may be written while in use, so this can be called at any point before the writes are flushed.
+	void ApplyPendingWrites();
+
+private:
+	struct RetiredSlot
+	{
+		// Graphics timeline value of the last frame that may use the slot.
+		uint64_t graphicsValue;
+		int index;
+	};
+
+	int AllocateIndex(std::vector<int>& freeIndices, std::vector<RetiredSlot>& retiredSlots, int& usedCount, int capacity);
+	void WriteTexture(int index, HawkEye::HTexture texture);
+	void WriteBuffer(int index, HawkEye::HBuffer buffer);
+
+	HawkEye::HRendererData rendererData = nullptr;
+	VkDescriptorSetLayout setLayout = VK_NULL_HANDLE;
+	VkDescriptorPool descriptorPool = VK_NULL_HANDLE;
+	VkDescriptorSet descriptorSet = VK_NULL_HANDLE;
+	int textureCapacity = 0;
+	int bufferCapacity = 0;
+	// Indices below the used counts that were removed again and are no longer in use.
+	std::vector<int> freeTextureIndices;
+	std::vector<int> freeBufferIndices;
+	// Removed slots that frames in flight may still read.
+	std::vector<RetiredSlot> retiredTextureSlots;
+	std::vector<RetiredSlot> retiredBufferSlots;
+	int usedTextureCount = 0;
+	int usedBufferCount = 0;
+	// Slots holding the placeholder, with the texture whose upload they wait for.
+	std::vector<std::pair<int, HawkEye::HTexture>> pendingTextures;
+	std::mutex mutex;
+};
@@ -0,0 +1,451 @@
+#include "BlockCompression.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+
+// Endpoints along the principal axis of the block's texels (in the first ChannelCount channels).
+template<int ChannelCount>
+static void FindPrincipalEndpoints(const uint8_t* texels, float* start, float* end)
+{
+	// Channel by channel, so that the loops over the texels run across all 16 of them at once.
+	int values[ChannelCount][16];
+	for (int t = 0; t < 16; ++t)
+	{
+		for (int c = 0; c < ChannelCount; ++c)
+		{
+			values[c][t] = texels[t * 4 + c];
+		}
+	}
+
+	int sums[ChannelCount] = {};
+	float mean[ChannelCount];
+	for (int c = 0; c < ChannelCount; ++c)
+	{
+		for (int t = 0; t < 16; ++t)
+		{
+			sums[c] += values[c][t];
+		}
+		mean[c] = sums[c] / 16.f;
+	}
+
+	// Scaled by the texel count (which leaves the axis as is), so that it stays in integers.
+	float covariance[ChannelCount][ChannelCount];
+	for (int a = 0; a < ChannelCount; ++a)
+	{
+		for (int b = 0; b < ChannelCount; ++b)
+		{
+			int products = 0;
+			for (int t = 0; t < 16; ++t)
+			{
+				products += values[a][t] * values[b][t];
+			}
+			covariance[a][b] = (float)(16 * products - sums[a] * sums[b]);
+		}
+	}
+
+	// Power iteration, starting from the channel with the largest variance.
+	int largestChannel = 0;
+	for (int c = 1; c < ChannelCount; ++c)
+	{
+		largestChannel = covariance[c][c] > covariance[largestChannel][largestChannel] ? c : largestChannel;
+	}
+	float axis[ChannelCount];
+	for (int c = 0; c < ChannelCount; ++c)
+	{
+		axis[c] = covariance[largestChannel][c];
+	}
+	for (int i = 0; i < 8; ++i)
+	{
+		float nextAxis[ChannelCount] = {};
+		float largest = 0.f;
+		for (int a = 0; a < ChannelCount; ++a)
+		{
+			for (int b = 0; b < ChannelCount; ++b)
+			{
+				nextAxis[a] += covariance[a][b] * axis[b];
+			}
+			largest = std::max(largest, std::fabs(nextAxis[a]));
+		}
+		// A zero axis stays zero.
+		const float scale = largest > 0.f ? 1.f / largest : 0.f;
+		for (int c = 0; c < ChannelCount; ++c)
+		{
+			axis[c] = nextAxis[c] * scale;
+		}
+	}
+
+	float length = 0.f;
+	for (int c = 0; c < ChannelCount; ++c)
+	{
+		length += axis[c] * axis[c];
+	}
+	length = std::sqrt(length);
+	// Solid blocks have no axis, both endpoints end up at the mean.
+	const float inverseLength = length > 0.f ? 1.f / length : 0.f;
+	for (int c = 0; c < ChannelCount; ++c)
+	{
+		axis[c] *= inverseLength;
+	}
+
+	float projections[16] = {};
+	for (int c = 0; c < ChannelCount; ++c)
+	{
+		for (int t = 0; t < 16; ++t)
+		{
+			projections[t] += (values[c][t] - mean[c]) * axis[c];
+		}
+	}
+	float minProjection = 0.f;
+	float maxProjection = 0.f;
+	for (int t = 0; t < 16; ++t)
+	{
+		minProjection = std::min(minProjection, projections[t]);
+		maxProjection = std::max(maxProjection, projections[t]);
+	}
+	for (int c = 0; c < ChannelCount; ++c)
+	{
+		start[c] = std::min(std::max(mean[c] + minProjection * axis[c], 0.f), 255.f);
+		end[c] = std::min(std::max(mean[c] + maxProjection * axis[c], 0.f), 255.f);
+	}
+}
+
+// The palette is stored channel by channel, so that the distances to all of its entries are computed together.
+// Ties go to the lower palette index.
+template<int PaletteSize, int ChannelCount>
+static int FindNearestColor(const uint8_t* texel, const int (*palette)[PaletteSize])
+{
+	int distances[PaletteSize] = {};
+	for (int c = 0; c < ChannelCount; ++c)
+	{
+		for (int p = 0; p < PaletteSize; ++p)
+		{
+			const int difference = texel[c] - palette[c][p];
+			distances[p] += difference * difference;
+		}
+	}
+
+	int nearest = 0;
+	for (int p = 1; p < PaletteSize; ++p)
+	{
+		nearest = distances[p] < distances[nearest] ? p : nearest;
+	}
+	return nearest;
+}
+
+static uint16_t PackColor565(const float* color)
+{
+	const int r = (int)(color[0] * 31.f / 255.f + .5f);
+	const int g = (int)(color[1] * 63.f / 255.f + .5f);
+	const int b = (int)(color[2] * 31.f / 255.f + .5f);
+	return (uint16_t)((r << 11) | (g << 5) | b);
+}
+
+// Writes the color into the given entry of a palette stored channel by channel.
+static void UnpackColor565(uint16_t packedColor, int (*palette)[4], int entry)
+{
+	const int r = (packedColor >> 11) & 31;
+	const int g = (packedColor >> 5) & 63;
+	const int b = packedColor & 31;
+	palette[0][entry] = (r << 3) | (r >> 2);
+	palette[1][entry] = (g << 2) | (g >> 4);
+	palette[2][entry] = (b << 3) | (b >> 2);
+}
+
+// The color block shared by BC1 and BC3. BC3 always interpolates four colors, regardless of the endpoint order.
+static void EncodeColorBlock(const uint8_t* texels, bool allowTransparency, uint8_t* block)
+{
+	bool transparent = false;
+	for (int t = 0; t < 16; ++t)
+	{
+		transparent |= texels[t * 4 + 3] < 128;
+	}
+	transparent &= allowTransparency;
+
+	float start[3];
+	float end[3];
+	FindPrincipalEndpoints<3>(texels, start, end);
+	uint16_t color0 = PackColor565(end);
+	uint16_t color1 = PackColor565(start);
+	// BC1 interpolates four colors if color0 > color1, three colors and transparent black otherwise.
+	if (allowTransparency && (transparent ? color0 > color1 : color0 < color1))
+	{
+		std::swap(color0, color1);
+	}
+
+	int palette[3][4];
+	UnpackColor565(color0, palette, 0);
+	UnpackColor565(color1, palette, 1);
+	if (!allowTransparency || color0 > color1)
+	{
+		for (int c = 0; c < 3; ++c)
+		{
+			palette[c][2] = (2 * palette[c][0] + palette[c][1]) / 3;
+			palette[c][3] = (palette[c][0] + 2 * palette[c][1]) / 3;
+		}
+	}
+	else
+	{
+		for (int c = 0; c < 3; ++c)
+		{
+			palette[c][2] = (palette[c][0] + palette[c][1]) / 2;
+			// Index 3 is transparent black. The duplicate keeps the search at four entries without ever winning a tie.
+			palette[c][3] = palette[c][2];
+		}
+	}
+
+	uint32_t indices = 0;
+	for (int t = 0; t < 16; ++t)
+	{
+		const uint8_t* texel = texels + t * 4;
+		const int nearest = FindNearestColor<4, 3>(texel, palette);
+		const int index = (transparent && texel[3] < 128) ? 3 : nearest;
+		indices |= (uint32_t)index << (2 * t);
+	}
+
+	block[0] = (uint8_t)(color0 & 0xFF);
+	block[1] = (uint8_t)(color0 >> 8);
+	block[2] = (uint8_t)(color1 & 0xFF);
+	block[3] = (uint8_t)(color1 >> 8);
+	for (int b = 0; b < 4; ++b)
+	{
+		block[4 + b] = (uint8_t)(indices >> (8 * b));
+	}
+}
+
+int BlockCompression::GetBlockSize(HawkEye::TextureCompression textureCompression)
+{
+	switch (textureCompression)
+	{
+	case HawkEye::TextureCompression::BC1:
+	case HawkEye::TextureCompression::BC4:
+		return 8;
+	case HawkEye::TextureCompression::BC3:
+	case HawkEye::TextureCompression::BC5:
+	case HawkEye::TextureCompression::BC7:
+		return 16;
+	default:
+		return 0;
+	}
+}
+
+void BlockCompression::EncodeBC1(const uint8_t* texels, uint8_t* block)
+{
+	EncodeColorBlock(texels, true, block);
+}
+
+void BlockCompression::EncodeBC3(const uint8_t* texels, uint8_t* block)
+{
+	EncodeBC4(texels, 3, block);
+	EncodeColorBlock(texels, false, block + 8);
+}
+
+void BlockCompression::EncodeBC4(const uint8_t* texels, int channel, uint8_t* block)
+{
+	int minValue = 255;
+	int maxValue = 0;
+	for (int t = 0; t < 16; ++t)
+	{
+		minValue = std::min(minValue, (int)texels[t * 4 + channel]);
+		maxValue = std::max(maxValue, (int)texels[t * 4 + channel]);
+	}
+
+	// With the first endpoint larger, the six values in between are interpolated.
+	int palette[8];
+	palette[0] = maxValue;
+	palette[1] = minValue;
+	for (int p = 1; p < 7; ++p)
+	{
+		palette[p + 1] = ((7 - p) * maxValue + p * minValue + 3) / 7;
+	}
+
+	uint64_t indices = 0;
+	for (int t = 0; t < 16; ++t)
+	{
+		const int value = texels[t * 4 + channel];
+		int nearest = 0;
+		int nearestDistance = std::abs(value - palette[0]);
+		for (int p = 1; p < 8; ++p)
+		{
+			const int distance = std::abs(value - palette[p]);
+			const bool closer = distance < nearestDistance;
+			nearest = closer ? p : nearest;
+			nearestDistance = closer ? distance : nearestDistance;
+		}
+		indices |= (uint64_t)nearest << (3 * t);
+	}
+
+	block[0] = (uint8_t)maxValue;
+	block[1] = (uint8_t)minValue;
+	for (int b = 0; b < 6; ++b)
+	{
+		block[2 + b] = (uint8_t)(indices >> (8 * b));
+	}
+}
+
+void BlockCompression::EncodeBC5(const uint8_t* texels, uint8_t* block)
+{
+	EncodeBC4(texels, 0, block);
+	EncodeBC4(texels, 1, block + 8);
+}
+
+// Picks the shared bit of a mode 6 endpoint (7 bits per channel plus one shared least significant bit).
+static void QuantizeBC7Endpoint(const float* endpoint, int* quantized, int& pBit)
+{
+	int bestError = INT32_MAX;
+	for (int p = 0; p < 2; ++p)
+	{
+		int candidate[4];
+		int error = 0;
+		for (int c = 0; c < 4; ++c)
+		{
+			candidate[c] = std::min(std::max((int)((endpoint[c] - p) / 2.f + .5f), 0), 127);
+			const int difference = ((candidate[c] << 1) | p) - (int)(endpoint[c] + .5f);
+			error += difference * difference;
+		}
+		if (error < bestError)
+		{
+			bestError = error;
+			pBit = p;
+			memcpy(quantized, candidate, sizeof(candidate));
+		}
+	}
+}
+
+static void WriteBits(uint8_t* block, int& bitPosition, uint32_t value, int bitCount)
+{
+	for (int b = 0; b < bitCount; ++b, ++bitPosition)
+	{
+		block[bitPosition >> 3] |= (uint8_t)(((value >> b) & 1) << (bitPosition & 7));
+	}
+}
+
+void BlockCompression::EncodeBC7(const uint8_t* texels, uint8_t* block)
+{
+	static const int weights[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+	float start[4];
+	float end[4];
+	FindPrincipalEndpoints<4>(texels, start, end);
+
+	int endpoints[2][4];
+	int pBits[2];
+	QuantizeBC7Endpoint(start, endpoints[0], pBits[0]);
+	QuantizeBC7Endpoint(end, endpoints[1], pBits[1]);
+
+	int palette[4][16];
+	for (int c = 0; c < 4; ++c)
+	{
+		const int value0 = (endpoints[0][c] << 1) | pBits[0];
+		const int value1 = (endpoints[1][c] << 1) | pBits[1];
+		for (int p = 0; p < 16; ++p)
+		{
+			palette[c][p] = ((64 - weights[p]) * value0 + weights[p] * value1 + 32) >> 6;
+		}
+	}
+
+	int indices[16];
+	for (int t = 0; t < 16; ++t)
+	{
+		indices[t] = FindNearestColor<16, 4>(texels + t * 4, palette);
+	}
+
+	// The first index is stored without its most significant bit, which therefore has to be zero.
+	if (indices[0] >= 8)
+	{
+		std::swap(endpoints[0], endpoints[1]);
+		std::swap(pBits[0], pBits[1]);
+		for (int t = 0; t < 16; ++t)
+		{
+			indices[t] = 15 - indices[t];
+		}
+	}
+
+	memset(block, 0, 16);
+	int bitPosition = 0;
+	WriteBits(block, bitPosition, 1 << 6, 7);
+	for (int c = 0; c < 4; ++c)
+	{
+		WriteBits(block, bitPosition, endpoints[0][c], 7);
+		WriteBits(block, bitPosition, endpoints[1][c], 7);
+	}
+	WriteBits(block, bitPosition, pBits[0], 1);
+	WriteBits(block, bitPosition, pBits[1], 1);
+	WriteBits(block, bitPosition, indices[0], 3);
+	for (int t = 1; t < 16; ++t)
+	{
+		WriteBits(block, bitPosition, indices[t], 4);
+	}
+}
+
+static void EncodeBC4Red(const uint8_t* texels, uint8_t* block)
+{
+	BlockCompression::EncodeBC4(texels, 0, block);
+}
+
+typedef void (*BlockEncoder)(const uint8_t* texels, uint8_t* block);
+
+static BlockEncoder GetBlockEncoder(HawkEye::TextureCompression textureCompression)
+{
+	switch (textureCompression)
+	{
+	case HawkEye::TextureCompression::BC1:
+		return BlockCompression::EncodeBC1;
+	case HawkEye::TextureCompression::BC3:
+		return BlockCompression::EncodeBC3;
+	case HawkEye::TextureCompression::BC4:
+		return EncodeBC4Red;
+	case HawkEye::TextureCompression::BC5:
+		return BlockCompression::EncodeBC5;
+	case HawkEye::TextureCompression::BC7:
+		return BlockCompression::EncodeBC7;
+	default:
+		return nullptr;
+	}
+}
+
+void BlockCompression::EncodeBlockRows(const uint8_t* rgbaData, int width, int height,
+	HawkEye::TextureCompression textureCompression, int firstBlockRow, int lastBlockRow, uint8_t* compressedData)
+{
+	const BlockEncoder encodeBlock = GetBlockEncoder(textureCompression);
+	if (!encodeBlock)
+	{
+		return;
+	}
+	const int blockSize = GetBlockSize(textureCompression);
+	const int blocksPerRow = (width + 3) / 4;
+	// Blocks that lie completely inside the image copy whole texel rows, only the last one may need clamping.
+	const int innerBlocksPerRow = width / 4;
+
+	uint8_t texels[64];
+	for (int by = firstBlockRow; by < lastBlockRow; ++by)
+	{
+		const uint8_t* sourceRows[4];
+		for (int y = 0; y < 4; ++y)
+		{
+			sourceRows[y] = rgbaData + (size_t)std::min(by * 4 + y, height - 1) * width * 4;
+		}
+		uint8_t* blockRow = compressedData + (size_t)by * blocksPerRow * blockSize;
+
+		int bx = 0;
+		for (; bx < innerBlocksPerRow; ++bx)
+		{
+			for (int y = 0; y < 4; ++y)
+			{
+				memcpy(texels + y * 16, sourceRows[y] + bx * 16, 16);
+			}
+			encodeBlock(texels, blockRow + bx * blockSize);
+		}
+		for (; bx < blocksPerRow; ++bx)
+		{
+			for (int y = 0; y < 4; ++y)
+			{
+				for (int x = 0; x < 4; ++x)
+				{
+					memcpy(texels + (y * 4 + x) * 4, sourceRows[y] + std::min(bx * 4 + x, width - 1) * 4, 4);
+				}
+			}
+			encodeBlock(texels, blockRow + bx * blockSize);
+		}
+	}
+}
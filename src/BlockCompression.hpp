@@ -0,0 +1,25 @@
+#pragma once
+#include "HawkEye/HawkEyeAPI.hpp"
+#include <cstdint>
+
+// CPU encoders for block-compressed textures. Every block is 4x4 texels of 8-bit RGBA (64 bytes, row by row).
+namespace BlockCompression
+{
+	// Bytes per block (0 for TextureCompression::None).
+	int GetBlockSize(HawkEye::TextureCompression textureCompression);
+
+	// BC1 switches to its three color mode (with transparent black) if any texel has alpha below 128.
+	void EncodeBC1(const uint8_t* texels, uint8_t* block);
+	void EncodeBC3(const uint8_t* texels, uint8_t* block);
+	// Encodes a single channel.
+	void EncodeBC4(const uint8_t* texels, int channel, uint8_t* block);
+	// Encodes the red and green channels.
+	void EncodeBC5(const uint8_t* texels, uint8_t* block);
+	// Only uses mode 6 (a single RGBA subset with 4-bit indices).
+	void EncodeBC7(const uint8_t* texels, uint8_t* block);
+
+	// Encodes the block rows [firstBlockRow, lastBlockRow) of the image into the output (which holds the whole image).
+	// Edge texels are repeated in partial blocks.
+	void EncodeBlockRows(const uint8_t* rgbaData, int width, int height, HawkEye::TextureCompression textureCompression,
+		int firstBlockRow, int lastBlockRow, uint8_t* compressedData);
+}
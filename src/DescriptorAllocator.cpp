@@ -0,0 +1,120 @@
+#include "DescriptorAllocator.hpp"
+#include <VulkanBackend/ErrorCheck.hpp>
+#include <algorithm>
+
+// Pages double in size up to the limit, so rarely used layouts do not reserve much.
+static const int firstPageSetCount = 16;
+static const int maxPageSetCount = 1024;
+
+void DescriptorAllocator::Init(VulkanBackend::BackendData* backendData)
+{
+	this->backendData = backendData;
+}
+
+void DescriptorAllocator::Shutdown()
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	for (auto& pageGroup : pageGroups)
+	{
+		for (int p = 0; p < pageGroup.second.pages.size(); ++p)
+		{
+			VulkanBackend::DestroyDescriptorPool(*backendData, pageGroup.second.pages[p]);
+		}
+	}
+	pageGroups.clear();
+	freeSets.clear();
+	setPages.clear();
+}
+
+VkDescriptorPool DescriptorAllocator::AddPage(PageGroup& pageGroup)
+{
+	pageGroup.setsPerPage = std::min(pageGroup.setsPerPage == 0 ? firstPageSetCount : pageGroup.setsPerPage * 2,
+		maxPageSetCount);
+
+	std::vector<VkDescriptorPoolSize> pagePoolSizes = pageGroup.poolSizes;
+	for (int s = 0; s < pagePoolSizes.size(); ++s)
+	{
+		pagePoolSizes[s].descriptorCount *= pageGroup.setsPerPage;
+	}
+
+	// Sets go back to their page when their layout is released.
+	VkDescriptorPoolCreateInfo poolCreateInfo{};
+	poolCreateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+	poolCreateInfo.flags = VK_DESCRIPTOR_POOL_CREATE_FREE_DESCRIPTOR_SET_BIT;
+	poolCreateInfo.maxSets = (uint32_t)pageGroup.setsPerPage;
+	poolCreateInfo.poolSizeCount = (uint32_t)pagePoolSizes.size();
+	poolCreateInfo.pPoolSizes = pagePoolSizes.data();
+
+	VkDescriptorPool page;
+	VulkanCheck(vkCreateDescriptorPool(backendData->logicalDevice, &poolCreateInfo, nullptr, &page));
+	pageGroup.pages.push_back(page);
+	return page;
+}
+
+VkDescriptorSet DescriptorAllocator::Allocate(VkDescriptorSetLayout setLayout, const std::vector<VkDescriptorPoolSize>& poolSizes)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+
+	auto layoutFreeSets = freeSets.find(setLayout);
+	if (layoutFreeSets != freeSets.end() && !layoutFreeSets->second.empty())
+	{
+		VkDescriptorSet descriptorSet = layoutFreeSets->second.back();
+		layoutFreeSets->second.pop_back();
+		return descriptorSet;
+	}
+
+	std::vector<uint32_t> signature;
+	for (int s = 0; s < poolSizes.size(); ++s)
+	{
+		signature.push_back((uint32_t)poolSizes[s].type);
+		signature.push_back(poolSizes[s].descriptorCount);
+	}
+	PageGroup& pageGroup = pageGroups[signature];
+	if (pageGroup.pages.empty())
+	{
+		pageGroup.poolSizes = poolSizes;
+		AddPage(pageGroup);
+	}
+
+	VkDescriptorSetAllocateInfo allocateInfo{};
+	allocateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+	allocateInfo.descriptorPool = pageGroup.pages.back();
+	allocateInfo.descriptorSetCount = 1;
+	allocateInfo.pSetLayouts = &setLayout;
+
+	VkDescriptorSet descriptorSet;
+	VkResult result = vkAllocateDescriptorSets(backendData->logicalDevice, &allocateInfo, &descriptorSet);
+	if (result == VK_ERROR_OUT_OF_POOL_MEMORY || result == VK_ERROR_FRAGMENTED_POOL)
+	{
+		allocateInfo.descriptorPool = AddPage(pageGroup);
+		result = vkAllocateDescriptorSets(backendData->logicalDevice, &allocateInfo, &descriptorSet);
+	}
+	VulkanCheck(result);
+
+	setPages[descriptorSet] = allocateInfo.descriptorPool;
+	return descriptorSet;
+}
+
+void DescriptorAllocator::Free(VkDescriptorSetLayout setLayout, VkDescriptorSet descriptorSet)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	freeSets[setLayout].push_back(descriptorSet);
+}
+
+void DescriptorAllocator::ReleaseLayout(VkDescriptorSetLayout setLayout)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	auto layoutFreeSets = freeSets.find(setLayout);
+	if (layoutFreeSets == freeSets.end())
+	{
+		return;
+	}
+
+	for (VkDescriptorSet descriptorSet : layoutFreeSets->second)
+	{
+		auto setPage = setPages.find(descriptorSet);
+		vkFreeDescriptorSets(backendData->logicalDevice, setPage->second, 1, &descriptorSet);
+		setPages.erase(setPage);
+	}
+	freeSets.erase(layoutFreeSets);
+}
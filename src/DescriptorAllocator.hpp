@@ -0,0 +1,44 @@
+#pragma once
+#include <VulkanBackend/VulkanBackendAPI.hpp>
+#include <vulkan/vulkan.hpp>
+#include <map>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+// Allocates descriptor sets from shared pages of pools. Pages are grouped by the descriptor counts of a single set,
+// so that layouts with the same counts share them. A page is added whenever the current one runs out.
+class DescriptorAllocator
+{
+public:
+	DescriptorAllocator() = default;
+	~DescriptorAllocator() = default;
+
+	void Init(VulkanBackend::BackendData* backendData);
+	// Destroys all pages, freeing every set allocated from them.
+	void Shutdown();
+
+	// The pool sizes are those of a single set of the layout.
+	VkDescriptorSet Allocate(VkDescriptorSetLayout setLayout, const std::vector<VkDescriptorPoolSize>& poolSizes);
+	// Keeps the set for the next allocation with the same layout. The GPU must not use it anymore.
+	void Free(VkDescriptorSetLayout setLayout, VkDescriptorSet descriptorSet);
+	// Returns the kept sets of a layout to their pools, has to be called before the layout is destroyed.
+	void ReleaseLayout(VkDescriptorSetLayout setLayout);
+
+private:
+	struct PageGroup
+	{
+		std::vector<VkDescriptorPool> pages;
+		std::vector<VkDescriptorPoolSize> poolSizes;
+		int setsPerPage = 0;
+	};
+
+	VkDescriptorPool AddPage(PageGroup& pageGroup);
+
+	VulkanBackend::BackendData* backendData = nullptr;
+	// Keyed by the type and count of each pool size.
+	std::map<std::vector<uint32_t>, PageGroup> pageGroups;
+	std::unordered_map<VkDescriptorSetLayout, std::vector<VkDescriptorSet>> freeSets;
+	std::unordered_map<VkDescriptorSet, VkDescriptorPool> setPages;
+	std::mutex mutex;
+};
@@ -1,8 +1,15 @@
 #include "DescriptorSystem.hpp"
 #include "Resources.hpp"
+#include "RendererData.hpp"
+#include <SoftwareCore/DefaultLogger.hpp>
 
-VkDescriptorSetLayout DescriptorSystem::InitSetLayout(VulkanBackend::BackendData* backendData,
-	const std::vector<UniformData>& uniformData)
+static bool IsRingUniform(const UniformData& uniformData)
+{
+	return uniformData.type == VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER && !uniformData.deviceLocal;
+}
+
+VkDescriptorSetLayout DescriptorSystem::InitSetLayout(HawkEye::HRendererData rendererData,
+	const std::vector<UniformData>& uniformData, bool useUniformRing)
 {
 	// descriptor set layout
 	std::vector<VkDescriptorSetLayoutBinding> layoutBindings(uniformData.size());
@@ -10,20 +17,24 @@ VkDescriptorSetLayout DescriptorSystem::InitSetLayout(VulkanBackend::BackendData
 	{
 		layoutBindings[b].binding = b;
 		layoutBindings[b].descriptorCount = 1;
-		layoutBindings[b].descriptorType = uniformData[b].type;
+		layoutBindings[b].descriptorType = (useUniformRing && IsRingUniform(uniformData[b])) ?
+			VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC : uniformData[b].type;
 		layoutBindings[b].stageFlags = uniformData[b].visibility;
 	}
 
-	return VulkanBackend::CreateDescriptorSetLayout(*backendData, layoutBindings);
+	return rendererData->objectCache.AcquireSetLayout(layoutBindings);
 }
 
-std::string GetFramedName(const std::string& name, int frameInFlight)
+void DescriptorSystem::DestroySetLayout(HawkEye::HRendererData rendererData, VkDescriptorSetLayout descriptorSetLayout)
 {
-	return std::to_string(frameInFlight) + '_' + name;
+	// Queued writes may target the sets about to be freed.
+	rendererData->descriptorWriter.Flush(rendererData->backendData.logicalDevice);
+	rendererData->objectCache.ReleaseSetLayout(descriptorSetLayout);
 }
 
 void DescriptorSystem::Init(VulkanBackend::BackendData* backendData, HawkEye::HRendererData rendererData,
-	const std::vector<UniformData>& uniformData, int framesInFlightCount, VkDescriptorSetLayout descriptorSetLayout)
+	const std::vector<UniformData>& uniformData, int framesInFlightCount, VkDescriptorSetLayout descriptorSetLayout,
+	UniformRing* uniformRing)
 {
 	descriptorSets.resize(framesInFlightCount);
 	if (uniformData.empty())
@@ -33,22 +44,45 @@ void DescriptorSystem::Init(VulkanBackend::BackendData* backendData, HawkEye::HR
 
 	this->backendData = backendData;
 	this->rendererData = rendererData;
+	this->framesInFlightCount = framesInFlightCount;
+	this->uniformRing = uniformRing;
+	this->descriptorSetLayout = descriptorSetLayout;
+
+	preallocatedBuffers.assign(uniformData.size() * framesInFlightCount, nullptr);
+	ringOffsets.assign(uniformData.size(), -1);
+	ringSizes.assign(uniformData.size(), 0);
+	dynamicOffsetCount = 0;
+	resourceBindings.clear();
+	for (int u = 0; u < uniformData.size(); ++u)
+	{
+		resourceBindings[uniformData[u].name] = u;
+	}
 
 	// descriptor pool sizes
-	std::vector<VkDescriptorPoolSize> poolSizes(4);
+	std::vector<VkDescriptorPoolSize> poolSizes(5);
 	poolSizes[0].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
 	poolSizes[1].type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
 	poolSizes[2].type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
 	poolSizes[3].type = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+	poolSizes[4].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
 
 	int cumulativeSize = 0;
 	for (int u = 0; u < uniformData.size(); ++u)
 	{
-		if (uniformData[u].type == VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER)
+		if (uniformRing && IsRingUniform(uniformData[u]))
+		{
+			// A single ring region per uniform, the frame slice is selected by the dynamic offset.
+			ringOffsets[u] = uniformRing->Reserve(uniformData[u].size);
+			ringSizes[u] = uniformData[u].size;
+			++dynamicOffsetCount;
+
+			++poolSizes[4].descriptorCount;
+		}
+		else if (uniformData[u].type == VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER)
 		{
 			for (int f = 0; f < framesInFlightCount; ++f)
 			{
-				preallocatedBuffers[GetFramedName(uniformData[u].name, f)] = HawkEye::UploadBuffer(rendererData,
+				preallocatedBuffers[u * framesInFlightCount + f] = HawkEye::UploadBuffer(rendererData,
 					nullptr, uniformData[u].size, HawkEye::BufferUsage::Uniform,
 					uniformData[u].deviceLocal ? HawkEye::BufferType::DeviceLocal : HawkEye::BufferType::Mapped);
 			}
@@ -70,6 +104,7 @@ void DescriptorSystem::Init(VulkanBackend::BackendData* backendData, HawkEye::HR
 		cumulativeSize += uniformData[u].size;
 	}
 
+	// Sizes of a single set.
 	std::vector<VkDescriptorPoolSize> filteredPoolSizes;
 	for (int s = 0; s < poolSizes.size(); ++s)
 	{
@@ -79,13 +114,10 @@ void DescriptorSystem::Init(VulkanBackend::BackendData* backendData, HawkEye::HR
 		}
 	}
 
-	// descriptor pool
-	descriptorPool = VulkanBackend::CreateDescriptorPool(*backendData, filteredPoolSizes, framesInFlightCount);
-
 	// descriptor sets
 	for (int f = 0; f < framesInFlightCount; ++f)
 	{
-		descriptorSets[f] = VulkanBackend::AllocateDescriptorSet(*backendData, descriptorPool, descriptorSetLayout);
+		descriptorSets[f] = rendererData->descriptorAllocator.Allocate(descriptorSetLayout, filteredPoolSizes);
 	}
 
 	// write
@@ -93,8 +125,7 @@ void DescriptorSystem::Init(VulkanBackend::BackendData* backendData, HawkEye::HR
 	cumulativeSize = 0;
 	while (k < uniformData.size())
 	{
-		resourceBindings[uniformData[k].name] = k;
-		if (uniformData[k].type != VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER)
+		if (uniformData[k].type != VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER || ringOffsets[k] >= 0)
 		{
 			++k;
 			continue;
@@ -109,11 +140,12 @@ void DescriptorSystem::Init(VulkanBackend::BackendData* backendData, HawkEye::HR
 			int u = k;
 			for (; u < uniformData.size() &&
 				uniformData[u].visibility == uniformData[k].visibility &&
-				uniformData[u].type == uniformData[k].type;
+				uniformData[u].type == uniformData[k].type &&
+				ringOffsets[u] < 0;
 				++u)
 			{
 				VkDescriptorBufferInfo bufferInfo{};
-				bufferInfo.buffer = preallocatedBuffers.at(GetFramedName(uniformData[u].name, f))->buffer.buffer;
+				bufferInfo.buffer = preallocatedBuffers[u * framesInFlightCount + f]->buffer.buffer;
 				bufferInfo.offset = 0;
 				bufferInfo.range = (VkDeviceSize)uniformData[u].size;
 
@@ -121,16 +153,8 @@ void DescriptorSystem::Init(VulkanBackend::BackendData* backendData, HawkEye::HR
 				cumulativeSize += uniformData[u].size;
 			}
 
-			VkWriteDescriptorSet descriptorWrite{};
-			descriptorWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-			descriptorWrite.dstBinding = k;
-			descriptorWrite.dstSet = descriptorSets[f];
-			descriptorWrite.dstArrayElement = 0;
-			descriptorWrite.descriptorType = uniformData[k].type;
-			descriptorWrite.descriptorCount = (uint32_t)bufferInfos.size();
-			descriptorWrite.pBufferInfo = bufferInfos.data();
-
-			vkUpdateDescriptorSets(backendData->logicalDevice, 1, &descriptorWrite, 0, nullptr);
+			rendererData->descriptorWriter.WriteBuffers(descriptorSets[f], k, uniformData[k].type,
+				bufferInfos.data(), (int)bufferInfos.size());
 
 			bufferInfosSize = (int)bufferInfos.size();
 		}
@@ -138,17 +162,51 @@ void DescriptorSystem::Init(VulkanBackend::BackendData* backendData, HawkEye::HR
 	}
 }
 
+void DescriptorSystem::WriteRingDescriptors()
+{
+	if (dynamicOffsetCount == 0)
+	{
+		return;
+	}
+
+	for (int u = 0; u < ringOffsets.size(); ++u)
+	{
+		if (ringOffsets[u] < 0)
+		{
+			continue;
+		}
+
+		VkDescriptorBufferInfo bufferInfo{};
+		bufferInfo.buffer = uniformRing->GetBuffer();
+		bufferInfo.offset = (VkDeviceSize)ringOffsets[u];
+		bufferInfo.range = (VkDeviceSize)ringSizes[u];
+
+		for (int f = 0; f < framesInFlightCount; ++f)
+		{
+			rendererData->descriptorWriter.WriteBuffer(descriptorSets[f], u, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, bufferInfo);
+		}
+	}
+}
+
 void DescriptorSystem::Shutdown()
 {
-	if (descriptorPool != VK_NULL_HANDLE)
+	for (int f = 0; f < descriptorSets.size(); ++f)
 	{
-		VulkanBackend::DestroyDescriptorPool(*backendData, descriptorPool);
+		if (descriptorSets[f] != VK_NULL_HANDLE)
+		{
+			rendererData->descriptorAllocator.Free(descriptorSetLayout, descriptorSets[f]);
+		}
 	}
+	descriptorSets.clear();
 
 	for (auto& preallocatedBuffer : preallocatedBuffers)
 	{
-		HawkEye::DeleteBuffer(rendererData, preallocatedBuffer.second);
+		if (preallocatedBuffer)
+		{
+			HawkEye::DeleteBuffer(rendererData, preallocatedBuffer);
+		}
 	}
+	preallocatedBuffers.clear();
 }
 
 VkDescriptorSet DescriptorSystem::GetSet(int frameInFlight) const
@@ -156,73 +214,120 @@ VkDescriptorSet DescriptorSystem::GetSet(int frameInFlight) const
 	return descriptorSets[frameInFlight];
 }
 
+int DescriptorSystem::GetDynamicOffsetCount() const
+{
+	return dynamicOffsetCount;
+}
+
+int DescriptorSystem::GetBinding(const std::string& name) const
+{
+	auto binding = resourceBindings.find(name);
+	if (binding == resourceBindings.end())
+	{
+		return -1;
+	}
+	return binding->second;
+}
+
 void DescriptorSystem::UpdatePreallocated(const std::string& name, int frameInFlight, void* data, int dataSize)
 {
-	// TODO: Check existence?
-	HawkEye::UpdateBuffer(rendererData, preallocatedBuffers[GetFramedName(name, frameInFlight)], data, dataSize);
+	const int binding = GetBinding(name);
+	if (binding < 0)
+	{
+		CoreLogError(DefaultLogger, "Descriptor update: No resource named \'%s\' - skipping.", name.c_str());
+		return;
+	}
+	UpdatePreallocated(binding, frameInFlight, data, dataSize);
 }
 
 void DescriptorSystem::UpdateBuffer(const std::string& name, int frameInFlight, HawkEye::HBuffer buffer)
 {
-	// TODO: Check existence?
-	HawkEye::WaitForUpload(rendererData, buffer);
+	const int binding = GetBinding(name);
+	if (binding < 0)
+	{
+		CoreLogError(DefaultLogger, "Descriptor update: No resource named \'%s\' - skipping.", name.c_str());
+		return;
+	}
+	UpdateBuffer(binding, frameInFlight, buffer);
+}
+
+void DescriptorSystem::UpdateTexture(const std::string& name, int frameInFlight, HawkEye::HTexture texture)
+{
+	const int binding = GetBinding(name);
+	if (binding < 0)
+	{
+		CoreLogError(DefaultLogger, "Descriptor update: No resource named \'%s\' - skipping.", name.c_str());
+		return;
+	}
+	UpdateTexture(binding, frameInFlight, texture);
+}
+
+void DescriptorSystem::UpdateStorageImage(const std::string& name, int frameInFlight, VkImageView imageView)
+{
+	const int binding = GetBinding(name);
+	if (binding < 0)
+	{
+		CoreLogError(DefaultLogger, "Descriptor update: No resource named \'%s\' - skipping.", name.c_str());
+		return;
+	}
+	UpdateStorageImage(binding, frameInFlight, imageView);
+}
+
+void DescriptorSystem::UpdatePreallocated(int binding, int frameInFlight, void* data, int dataSize,
+	std::vector<UniformCopy>* uniformCopies)
+{
+	if (ringOffsets[binding] >= 0)
+	{
+		memcpy(uniformRing->GetFrameData(frameInFlight) + ringOffsets[binding], data, dataSize);
+		return;
+	}
+	HawkEye::HBuffer buffer = preallocatedBuffers[binding * framesInFlightCount + frameInFlight];
+	if (uniformCopies && !buffer->mappedBuffer)
+	{
+		uniformCopies->push_back({ buffer->buffer.buffer, (VkDeviceSize)buffer->offset, data, dataSize });
+		return;
+	}
+	HawkEye::UpdateBuffer(rendererData, buffer, data, dataSize);
+}
+
+void DescriptorSystem::UpdateBuffer(int binding, int frameInFlight, HawkEye::HBuffer buffer)
+{
+	ResourceUtils::WaitForRecording(rendererData, buffer->uploadValue);
 
 	VkDescriptorBufferInfo bufferInfo{};
 	bufferInfo.buffer = buffer->buffer.buffer;
-	bufferInfo.offset = 0;
+	bufferInfo.offset = buffer->offset;
 	bufferInfo.range = buffer->dataSize;
 
-	VkWriteDescriptorSet descriptorWrite{};
-	descriptorWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-	descriptorWrite.dstSet = descriptorSets[frameInFlight];
-	descriptorWrite.dstBinding = resourceBindings[name];
-	descriptorWrite.dstArrayElement = 0;
-	descriptorWrite.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
-	descriptorWrite.descriptorCount = 1;
-	descriptorWrite.pBufferInfo = &bufferInfo;
-
-	vkUpdateDescriptorSets(backendData->logicalDevice, 1, &descriptorWrite, 0, nullptr);
+	rendererData->descriptorWriter.WriteBuffer(descriptorSets[frameInFlight], binding, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, bufferInfo);
 }
 
-void DescriptorSystem::UpdateTexture(const std::string& name, int frameInFlight, HawkEye::HTexture texture)
+bool DescriptorSystem::UpdateTexture(int binding, int frameInFlight, HawkEye::HTexture texture)
 {
-	// TODO: Check existence?
-	if (texture->uploadFence != VK_NULL_HANDLE)
+	const bool uploaded = HawkEye::UploadFinished(rendererData, texture);
+	if (!uploaded)
 	{
-		HawkEye::WaitForUpload(rendererData, texture);
+		texture = rendererData->placeholderTexture;
 	}
 
+	// Not the texture's current layout: uploads from a transfer family are acquired (and get their mips) in the prologue
+	// of the frame, after the descriptor updates, but before any draw samples them. The layout also changes on the
+	// render thread.
 	VkDescriptorImageInfo imageInfo{};
-	imageInfo.imageLayout = texture->imageLayout;
+	imageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
 	imageInfo.imageView = texture->imageView;
 	imageInfo.sampler = texture->sampler;
 
-	VkWriteDescriptorSet descriptorWrite{};
-	descriptorWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-	descriptorWrite.dstSet = descriptorSets[frameInFlight];
-	descriptorWrite.dstBinding = resourceBindings[name];
-	descriptorWrite.dstArrayElement = 0;
-	descriptorWrite.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-	descriptorWrite.descriptorCount = 1;
-	descriptorWrite.pImageInfo = &imageInfo;
-
-	vkUpdateDescriptorSets(backendData->logicalDevice, 1, &descriptorWrite, 0, nullptr);
+	rendererData->descriptorWriter.WriteImage(descriptorSets[frameInFlight], binding, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+		imageInfo);
+	return uploaded;
 }
 
-void DescriptorSystem::UpdateStorageImage(const std::string& name, int frameInFlight, VkImageView imageView)
+void DescriptorSystem::UpdateStorageImage(int binding, int frameInFlight, VkImageView imageView)
 {
 	VkDescriptorImageInfo imageInfo{};
 	imageInfo.imageView = imageView;
 	imageInfo.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
 
-	VkWriteDescriptorSet descriptorWrite{};
-	descriptorWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-	descriptorWrite.dstSet = descriptorSets[frameInFlight];
-	descriptorWrite.dstBinding = resourceBindings[name];
-	descriptorWrite.dstArrayElement = 0;
-	descriptorWrite.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
-	descriptorWrite.descriptorCount = 1;
-	descriptorWrite.pImageInfo = &imageInfo;
-
-	vkUpdateDescriptorSets(backendData->logicalDevice, 1, &descriptorWrite, 0, nullptr);
+	rendererData->descriptorWriter.WriteImage(descriptorSets[frameInFlight], binding, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, imageInfo);
 }
@@ -1,32 +1,73 @@
 #pragma once
 #include "YAMLConfiguration.hpp"
+#include "UniformRing.hpp"
 #include <vulkan/vulkan.hpp>
 
+// Update of a device-local uniform buffer, recorded at the start of the frame instead of being uploaded.
+struct UniformCopy
+{
+	VkBuffer buffer;
+	VkDeviceSize offset;
+	const void* data;
+	int dataSize;
+};
+
+// Descriptor writes are queued in the renderer's descriptor writer, which the pipeline flushes before recording a frame.
 class DescriptorSystem
 {
 public:
 	DescriptorSystem() = default;
 	~DescriptorSystem() = default;
 
-	static VkDescriptorSetLayout InitSetLayout(VulkanBackend::BackendData* backendData,
-		const std::vector<UniformData>& uniformData);
+	// With a uniform ring, host-visible uniform buffers become dynamic uniform buffers placed in the ring.
+	// Identical layouts are shared through the renderer's object cache, and so are their recycled sets.
+	static VkDescriptorSetLayout InitSetLayout(HawkEye::HRendererData rendererData,
+		const std::vector<UniformData>& uniformData, bool useUniformRing = false);
+	// Releases the reference taken by InitSetLayout. With the last one, the sets the allocator keeps for it go first.
+	static void DestroySetLayout(HawkEye::HRendererData rendererData, VkDescriptorSetLayout descriptorSetLayout);
 
 	void Init(VulkanBackend::BackendData* backendData, HawkEye::HRendererData rendererData,
-		const std::vector<UniformData>& uniformData, int framesInFlightCount, VkDescriptorSetLayout descriptorSetLayout);
+		const std::vector<UniformData>& uniformData, int framesInFlightCount, VkDescriptorSetLayout descriptorSetLayout,
+		UniformRing* uniformRing = nullptr);
+	// Writes the ring descriptors, once the ring has been initialized.
+	void WriteRingDescriptors();
+	// Returns the sets to the renderer's descriptor allocator, the GPU must not use them anymore.
 	void Shutdown();
 
 	VkDescriptorSet GetSet(int frameInFlight) const;
+	// The same ring frame offset has to be passed for each of these when binding the set.
+	int GetDynamicOffsetCount() const;
+
+	// Returns -1 if there is no uniform of that name.
+	int GetBinding(const std::string& name) const;
 
 	void UpdatePreallocated(const std::string& name, int frameInFlight, void* data, int dataSize);
 	void UpdateBuffer(const std::string& name, int frameInFlight, HawkEye::HBuffer buffer);
 	void UpdateTexture(const std::string& name, int frameInFlight, HawkEye::HTexture texture);
 	void UpdateStorageImage(const std::string& name, int frameInFlight, VkImageView imageView);
 
+	// Binding-based variants, skipping the name lookup.
+	// With a copy list, device-local uniforms are only collected and have to be recorded by the caller.
+	void UpdatePreallocated(int binding, int frameInFlight, void* data, int dataSize,
+		std::vector<UniformCopy>* uniformCopies = nullptr);
+	// Frames wait for buffer uploads on the GPU, so buffers are written right away.
+	void UpdateBuffer(int binding, int frameInFlight, HawkEye::HBuffer buffer);
+	// Textures still being uploaded are not waited for, the renderer's placeholder is written and false returned.
+	bool UpdateTexture(int binding, int frameInFlight, HawkEye::HTexture texture);
+	void UpdateStorageImage(int binding, int frameInFlight, VkImageView imageView);
+
 private:
 	VulkanBackend::BackendData* backendData;
 	HawkEye::HRendererData rendererData;
-	VkDescriptorPool descriptorPool = VK_NULL_HANDLE;
+	VkDescriptorSetLayout descriptorSetLayout = VK_NULL_HANDLE;
 	std::vector<VkDescriptorSet> descriptorSets;
-	std::map<std::string, HawkEye::HBuffer> preallocatedBuffers;
+	int framesInFlightCount = 0;
+	// Indexed by binding * framesInFlightCount + frameInFlight (null for non-uniform-buffer bindings).
+	std::vector<HawkEye::HBuffer> preallocatedBuffers;
 	std::map<std::string, int> resourceBindings;
+	UniformRing* uniformRing = nullptr;
+	// Offsets into the ring's frame slices (-1 for bindings outside the ring) and the sizes of the ring bindings.
+	std::vector<int> ringOffsets;
+	std::vector<int> ringSizes;
+	int dynamicOffsetCount = 0;
 };
@@ -0,0 +1,73 @@
+#include "DescriptorWriter.hpp"
+
+static bool IsImageDescriptor(VkDescriptorType type)
+{
+	return type == VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER || type == VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE ||
+		type == VK_DESCRIPTOR_TYPE_STORAGE_IMAGE || type == VK_DESCRIPTOR_TYPE_SAMPLER ||
+		type == VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT;
+}
+
+void DescriptorWriter::AddWrite(VkDescriptorSet descriptorSet, int binding, int arrayElement, VkDescriptorType type, int count,
+	int infoIndex)
+{
+	VkWriteDescriptorSet descriptorWrite{};
+	descriptorWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+	descriptorWrite.dstSet = descriptorSet;
+	descriptorWrite.dstBinding = (uint32_t)binding;
+	descriptorWrite.dstArrayElement = (uint32_t)arrayElement;
+	descriptorWrite.descriptorType = type;
+	descriptorWrite.descriptorCount = (uint32_t)count;
+	writes.push_back(descriptorWrite);
+	infoIndices.push_back(infoIndex);
+}
+
+void DescriptorWriter::WriteBuffer(VkDescriptorSet descriptorSet, int binding, VkDescriptorType type,
+	const VkDescriptorBufferInfo& bufferInfo, int arrayElement)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	AddWrite(descriptorSet, binding, arrayElement, type, 1, (int)bufferInfos.size());
+	bufferInfos.push_back(bufferInfo);
+}
+
+void DescriptorWriter::WriteBuffers(VkDescriptorSet descriptorSet, int binding, VkDescriptorType type,
+	const VkDescriptorBufferInfo* bufferInfos, int count)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	AddWrite(descriptorSet, binding, 0, type, count, (int)this->bufferInfos.size());
+	this->bufferInfos.insert(this->bufferInfos.end(), bufferInfos, bufferInfos + count);
+}
+
+void DescriptorWriter::WriteImage(VkDescriptorSet descriptorSet, int binding, VkDescriptorType type,
+	const VkDescriptorImageInfo& imageInfo, int arrayElement)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	AddWrite(descriptorSet, binding, arrayElement, type, 1, (int)imageInfos.size());
+	imageInfos.push_back(imageInfo);
+}
+
+void DescriptorWriter::Flush(VkDevice device)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	if (writes.empty())
+	{
+		return;
+	}
+
+	for (int w = 0; w < writes.size(); ++w)
+	{
+		if (IsImageDescriptor(writes[w].descriptorType))
+		{
+			writes[w].pImageInfo = &imageInfos[infoIndices[w]];
+		}
+		else
+		{
+			writes[w].pBufferInfo = &bufferInfos[infoIndices[w]];
+		}
+	}
+	vkUpdateDescriptorSets(device, (uint32_t)writes.size(), writes.data(), 0, nullptr);
+
+	writes.clear();
+	infoIndices.clear();
+	bufferInfos.clear();
+	imageInfos.clear();
+}
@@ -0,0 +1,36 @@
+#pragma once
+#include <vulkan/vulkan.hpp>
+#include <mutex>
+#include <vector>
+
+// Collects descriptor writes and issues them in a single vkUpdateDescriptorSets call.
+// The infos are copied, so they do not have to outlive the call. Writes to the same descriptor keep their order.
+class DescriptorWriter
+{
+public:
+	DescriptorWriter() = default;
+	~DescriptorWriter() = default;
+
+	void WriteBuffer(VkDescriptorSet descriptorSet, int binding, VkDescriptorType type, const VkDescriptorBufferInfo& bufferInfo,
+		int arrayElement = 0);
+	// Consecutive bindings of the same type.
+	void WriteBuffers(VkDescriptorSet descriptorSet, int binding, VkDescriptorType type,
+		const VkDescriptorBufferInfo* bufferInfos, int count);
+	void WriteImage(VkDescriptorSet descriptorSet, int binding, VkDescriptorType type, const VkDescriptorImageInfo& imageInfo,
+		int arrayElement = 0);
+
+	// Has to be called before command buffers using the written sets are submitted.
+	void Flush(VkDevice device);
+
+private:
+	void AddWrite(VkDescriptorSet descriptorSet, int binding, int arrayElement, VkDescriptorType type, int count,
+		int infoIndex);
+
+	std::vector<VkWriteDescriptorSet> writes;
+	// Index of each write's first info, the pointers are only set when flushing as the storage may move.
+	std::vector<int> infoIndices;
+	// Kept between flushes, so that steady-state writing does not allocate.
+	std::vector<VkDescriptorBufferInfo> bufferInfos;
+	std::vector<VkDescriptorImageInfo> imageInfos;
+	std::mutex mutex;
+};
@@ -101,8 +101,9 @@ void DescriptorUtils::UpdateSets(HawkEye::HRendererData rendererData, const Vulk
 				HawkEye::HTexture texture = *(HawkEye::HTexture*)((int*)data + (cumulativeSize >> 2));
 				HawkEye::WaitForUpload(rendererData, texture);
 
+				// Textures are sampled only after their acquisition, even if it is still pending now.
 				VkDescriptorImageInfo imageInfo{};
-				imageInfo.imageLayout = texture->imageLayout;
+				imageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
 				imageInfo.imageView = texture->imageView;
 				imageInfo.sampler = texture->sampler;
 
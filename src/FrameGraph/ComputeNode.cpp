@@ -93,29 +93,32 @@ void ComputeNode::Configure(const YAML::Node& nodeConfiguration,
 
 	// descriptors
 	const int descriptorSetLayoutCount = 2;
-	std::vector<UniformData> uniformData;
-	ConfigureUniforms(nodeConfiguration["uniforms"], uniformData);
+	uniformData.clear();
+	pushConstantData.clear();
+	ConfigureUniforms(nodeConfiguration["uniforms"], uniformData, &pushConstantData);
+	ConfigurePushConstants();
 	ConfigureUniforms(nodeConfiguration["material"], materialData);
 
-	uniformDescriptorSetLayout = DescriptorSystem::InitSetLayout(backendData, uniformData);
+	uniformDescriptorSetLayout = DescriptorSystem::InitSetLayout(rendererData, uniformData, true);
 	uniformDescriptorSystem.Init(backendData, rendererData, uniformData, framesInFlightCount,
-		uniformDescriptorSetLayout);
+		uniformDescriptorSetLayout, commonFrameData.uniformRing);
 
-	//materialDescriptorSetLayout = DescriptorSystem::InitSetLayout(backendData, materialData);
+	//materialDescriptorSetLayout = DescriptorSystem::InitSetLayout(rendererData, materialData);
 
 	// TODO: Model uniform set.
 
-	std::vector<UniformData> targetUniforms;
+	targetUniforms.clear();
 	targetUniforms.push_back({ "target image", 8, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, VK_SHADER_STAGE_COMPUTE_BIT });
 
 	if (nodeInputCharacteristics.size() > 0 && !reuseColorTarget)
 	{
 		targetUniforms.push_back({ "source image", 8, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_COMPUTE_BIT });
 	}
-	targetDescriptorSystemLayout = DescriptorSystem::InitSetLayout(backendData, targetUniforms);
-	targetDescriptorSystem.Init(backendData, rendererData, targetUniforms, useSwapchain ? framesInFlightCount : 1, targetDescriptorSystemLayout);
+	targetDescriptorSystemLayout = DescriptorSystem::InitSetLayout(rendererData, targetUniforms);
+	targetSetCount = useSwapchain ? commonFrameData.swapchainImageCount : 1;
+	targetDescriptorSystem.Init(backendData, rendererData, targetUniforms, targetSetCount, targetDescriptorSystemLayout);
 	
-	for (int i = 0; i < (useSwapchain ? framesInFlightCount : 1); ++i)
+	for (int i = 0; i < targetSetCount; ++i)
 	{
 		VkImageView imageView = useSwapchain ? commonFrameData.swapchainImageViews[i] : nodeOutputs.colorTarget->imageView;
 		targetDescriptorSystem.UpdateStorageImage("target image", i, imageView);
@@ -123,7 +126,7 @@ void ComputeNode::Configure(const YAML::Node& nodeConfiguration,
 		if (nodeInputCharacteristics.size() > 0 && !reuseColorTarget)
 		{
 			HawkEye::HTexture_t sourceImage;
-			sourceImage.uploadFence = VK_NULL_HANDLE;
+			sourceImage.uploadValue = 0;
 			sourceImage.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
 			sourceImage.imageView = nodeInputs[0]->colorTarget->imageView;
 			sourceImage.sampler = commonFrameData.targetSampler;
@@ -142,6 +145,9 @@ void ComputeNode::Configure(const YAML::Node& nodeConfiguration,
 	pipelineLayoutCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
 	pipelineLayoutCreateInfo.setLayoutCount = (uint32_t)passSetLayouts.size();
 	pipelineLayoutCreateInfo.pSetLayouts = passSetLayouts.data();
+	std::vector<VkPushConstantRange> pushConstantRanges = GetPushConstantRanges();
+	pipelineLayoutCreateInfo.pushConstantRangeCount = (uint32_t)pushConstantRanges.size();
+	pipelineLayoutCreateInfo.pPushConstantRanges = pushConstantRanges.data();
 	VulkanCheck(vkCreatePipelineLayout(backendData->logicalDevice, &pipelineLayoutCreateInfo, nullptr, &pipelineLayout));
 
 	VkPipelineShaderStageCreateInfo shaderStage{};
@@ -176,10 +182,6 @@ void ComputeNode::Shutdown(const CommonFrameData& commonFrameData)
 	}
 	shaderModules.clear();
 
-	VulkanBackend::DestroyDescriptorSetLayout(backendData, targetDescriptorSystemLayout);
-	//VulkanBackend::DestroyDescriptorSetLayout(backendData, materialDescriptorSetLayout);
-	VulkanBackend::DestroyDescriptorSetLayout(backendData, uniformDescriptorSetLayout);
-
 	if (nodeOutputs.colorTarget)
 	{
 		FramebufferUtils::DestroyTarget(backendData, *nodeOutputs.colorTarget.get());
@@ -195,14 +197,15 @@ void ComputeNode::Shutdown(const CommonFrameData& commonFrameData)
 
 	targetDescriptorSystem.Shutdown();
 	uniformDescriptorSystem.Shutdown();
+	ShutdownMaterials();
 
-	for (int m = 0; m < materialDescriptorSystems.size(); ++m)
-	{
-		materialDescriptorSystems[m]->Shutdown();
-	}
+	// The layouts go last, the allocator releases the sets kept for them.
+	DescriptorSystem::DestroySetLayout(rendererData, targetDescriptorSystemLayout);
+	//DescriptorSystem::DestroySetLayout(rendererData, materialDescriptorSetLayout);
+	DescriptorSystem::DestroySetLayout(rendererData, uniformDescriptorSetLayout);
 }
 
-bool ComputeNode::Record(VkCommandBuffer commandBuffer, int frameInFlight, const CommonFrameData& commonFrameData,
+bool ComputeNode::Record(VkCommandBuffer commandBuffer, int frameInFlight, int imageIndex, const CommonFrameData& commonFrameData,
 	bool startRenderPass, bool endRenderPass)
 {
 	if (!configured)
@@ -216,26 +219,38 @@ bool ComputeNode::Record(VkCommandBuffer commandBuffer, int frameInFlight, const
 	//	return false;
 	//}
 
-	VkImage imageReference = useSwapchain ? commonFrameData.swapchainImages[frameInFlight] : nodeOutputs.colorTarget->image.image;
+	ExecuteCommands(commandBuffer, frameInFlight, imageIndex);
+
+	return true;
+}
+
+void ComputeNode::RecordCommands(VkCommandBuffer commandBuffer, int chunk, int frameInFlight, int imageIndex,
+	const CommonFrameData& commonFrameData, bool endRenderPass)
+{
+	VkImage imageReference = useSwapchain ? commonFrameData.swapchainImages[imageIndex] : nodeOutputs.colorTarget->image.image;
 
 	VulkanBackend::TransitionImageLayout(commandBuffer, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_GENERAL,
 		imageReference, 1, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
 		VK_IMAGE_ASPECT_COLOR_BIT, 0, 0);
 
 	vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline);
+	RecordPushConstants(commandBuffer, frameInFlight);
 
 	std::vector<VkDescriptorSet> descriptorSets;
 	descriptorSets.reserve(4);
-	int setIndex = useSwapchain ? frameInFlight : 0;
+	int setIndex = useSwapchain ? imageIndex : 0;
 	descriptorSets.push_back(targetDescriptorSystem.GetSet(setIndex));
+	std::vector<uint32_t> dynamicOffsets;
 	if (uniformDescriptorSystem.GetSet(frameInFlight) != VK_NULL_HANDLE)
 	{
 		descriptorSets.push_back(uniformDescriptorSystem.GetSet(frameInFlight));
+		dynamicOffsets.resize(uniformDescriptorSystem.GetDynamicOffsetCount(),
+			commonFrameData.uniformRing->GetFrameOffset(frameInFlight));
 	}
 	if (descriptorSets.size() > 0)
 	{
 		vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipelineLayout, 0,
-			(uint32_t)descriptorSets.size(), descriptorSets.data(), 0, nullptr);
+			(uint32_t)descriptorSets.size(), descriptorSets.data(), (uint32_t)dynamicOffsets.size(), dynamicOffsets.data());
 	}
 
 	// TODO: Works in multiples of 16, make sure that exactly the entire picture is rendered onto the screen.
@@ -254,8 +269,6 @@ bool ComputeNode::Record(VkCommandBuffer commandBuffer, int frameInFlight, const
 			imageReference, 1, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
 			VK_IMAGE_ASPECT_COLOR_BIT, 0, 0);
 	}
-
-	return true;
 }
 
 void ComputeNode::Resize(const CommonFrameData& commonFrameData, const std::vector<NodeOutputs*>& nodeInputs)
@@ -284,7 +297,17 @@ void ComputeNode::Resize(const CommonFrameData& commonFrameData, const std::vect
 		CreateSampleTarget(commonFrameData, nodeInputs);
 	}
 
-	for (int i = 0; i < (useSwapchain ? framesInFlightCount : 1); ++i)
+	// The swapchain may have been recreated with a different number of images.
+	if (useSwapchain && targetSetCount != commonFrameData.swapchainImageCount)
+	{
+		targetDescriptorSystem.Shutdown();
+		targetDescriptorSystem = DescriptorSystem();
+		targetSetCount = commonFrameData.swapchainImageCount;
+		targetDescriptorSystem.Init(commonFrameData.backendData, rendererData, targetUniforms, targetSetCount,
+			targetDescriptorSystemLayout);
+	}
+
+	for (int i = 0; i < targetSetCount; ++i)
 	{
 		VkImageView imageView = useSwapchain ? commonFrameData.swapchainImageViews[i] : nodeOutputs.colorTarget->imageView;
 		targetDescriptorSystem.UpdateStorageImage("target image", i, imageView);
@@ -292,7 +315,7 @@ void ComputeNode::Resize(const CommonFrameData& commonFrameData, const std::vect
 		if (nodeInputCharacteristics.size() > 0 && !reuseColorTarget)
 		{
 			HawkEye::HTexture_t sourceImage;
-			sourceImage.uploadFence = VK_NULL_HANDLE;
+			sourceImage.uploadValue = 0;
 			sourceImage.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
 			sourceImage.imageView = nodeInputs[0]->colorTarget->imageView;
 			sourceImage.sampler = commonFrameData.targetSampler;
@@ -13,7 +13,7 @@ public:
 		const CommonFrameData& commonFrameData, VkRenderPass renderPassReference, bool useSwapchain) override;
 	void Shutdown(const CommonFrameData& commonFrameData) override;
 	// TODO: Change for layer and common information.
-	bool Record(VkCommandBuffer commandBuffer, int frameInFlight, const CommonFrameData& commonFrameData,
+	bool Record(VkCommandBuffer commandBuffer, int frameInFlight, int imageIndex, const CommonFrameData& commonFrameData,
 		bool startRenderPass, bool endRenderPass) override;
 	void Resize(const CommonFrameData& commonFrameData, const std::vector<NodeOutputs*>& nodeInputs) override;
 
@@ -21,8 +21,14 @@ public:
 	void CreateDepthTarget(const CommonFrameData& commonFrameData, const std::vector<NodeOutputs*>& nodeInputs);
 	void CreateSampleTarget(const CommonFrameData& commonFrameData, const std::vector<NodeOutputs*>& nodeInputs);
 
+protected:
+	void RecordCommands(VkCommandBuffer commandBuffer, int chunk, int frameInFlight, int imageIndex,
+		const CommonFrameData& commonFrameData, bool endRenderPass) override;
+
 private:
 	DescriptorSystem targetDescriptorSystem;
 	VkDescriptorSetLayout targetDescriptorSystemLayout;
+	std::vector<UniformData> targetUniforms;
+	int targetSetCount = 1;
 };
 
@@ -1,6 +1,7 @@
 #include "FrameGraph.hpp"
 #include "RasterizeNode.hpp"
 #include "ComputeNode.hpp"
+#include "../ThreadPool.hpp"
 #include <SoftwareCore/DefaultLogger.hpp>
 #include <VulkanBackend/ErrorCheck.hpp>
 
@@ -52,87 +53,99 @@ void FrameGraph::Configure(const YAML::Node& graphConfiguration, const CommonFra
 	RecursivelyConfigure(finalNode, nullptr, graphConfiguration, commonFrameData, nullptr);
 
 	PruneGraph();
+
+	recordSteps.clear();
+	RecursivelyOrder(finalNode, nullptr);
+
+	for (auto&& node : nodes)
+	{
+		node.second->AllocateCommandBuffers(commonFrameData);
+	}
 }
 
 void FrameGraph::Shutdown(const CommonFrameData& commonFrameData)
 {
 	for (auto&& renderPass : renderPasses)
 	{
-		VulkanBackend::DestroyRenderPass(*backendData, renderPass);
+		commonFrameData.rendererData->objectCache.ReleaseRenderPass(renderPass);
 	}
 
 	for (auto&& node : nodes)
 	{
+		node.second->FreeCommandBuffers(commonFrameData);
 		node.second->Shutdown(commonFrameData);
 	}
 }
 
-void FrameGraph::Record(VkCommandBuffer commandBuffer, int frameInFlight, const CommonFrameData& commonFrameData)
+void FrameGraph::Record(VkCommandBuffer commandBuffer, int frameInFlight, int imageIndex, const CommonFrameData& commonFrameData)
 {
 	VkCommandBufferBeginInfo commandBufferBeginInfo{};
 	commandBufferBeginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+	// Only dirty nodes are re-recorded, all of them before the primary command buffer executes them.
+	for (int s = 0; s < recordSteps.size(); ++s)
+	{
+		recordSteps[s].node->RecordCommandBuffers(frameInFlight, imageIndex, commonFrameData, recordSteps[s].endRenderPass);
+	}
+	if (commonFrameData.threadPool)
+	{
+		commonFrameData.threadPool->Wait();
+	}
+
 	vkBeginCommandBuffer(commandBuffer, &commandBufferBeginInfo);
-	
-	VkViewport viewport;
-	viewport.x = 0;
-	viewport.y = 0;
-	viewport.width = (float)commonFrameData.surfaceData->width;
-	viewport.height = (float)commonFrameData.surfaceData->height;
-	viewport.minDepth = 0.f;
-	viewport.maxDepth = 1.f;
-	vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
-
-	VkRect2D scissor;
-	scissor.offset = { 0, 0 };
-	scissor.extent = VkExtent2D{ (uint32_t)commonFrameData.surfaceData->width, (uint32_t)commonFrameData.surfaceData->height };
-	vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
-
-	RecursivelyRecord(commandBuffer, frameInFlight, commonFrameData, finalNode, nullptr);
+	for (int s = 0; s < recordSteps.size(); ++s)
+	{
+		recordSteps[s].node->Record(commandBuffer, frameInFlight, imageIndex, commonFrameData,
+			recordSteps[s].startRenderPass, recordSteps[s].endRenderPass);
+	}
 	vkEndCommandBuffer(commandBuffer);
 }
 
-void FrameGraph::Resize(const CommonFrameData& commonFrameData)
+bool FrameGraph::NeedsRecording(int frameInFlight, int imageIndex) const
 {
-	RecursivelyResize(finalNode, commonFrameData);
+	for (auto& node : nodes)
+	{
+		if (node.second->NeedsRecording(frameInFlight, imageIndex))
+		{
+			return true;
+		}
+	}
+	return false;
 }
 
-void FrameGraph::UpdatePreallocatedUniformData(const std::string& nodeName, const std::string& name, int frameInFlight,
-	void* data, int dataSize)
+void FrameGraph::MarkCommandBuffersDirty()
 {
-	auto node = nodes.find(nodeName);
-	if (node == nodes.end())
+	for (auto& node : nodes)
 	{
-		CoreLogError(DefaultLogger, "Uniform update: No node \'%s\' is configured in the frame graph (could have been pruned).",
-			nodeName.c_str());
-		return;
+		node.second->MarkCommandBuffersDirty();
 	}
-	nodes[nodeName]->UpdatePreallocatedUniformData(name, frameInFlight, data, dataSize);
 }
 
-void FrameGraph::UpdateTexture(const std::string& nodeName, const std::string& name, int frameInFlight,
-	HawkEye::HTexture texture)
+void FrameGraph::ApplyPendingDescriptorUpdates(int frameInFlight)
 {
-	auto node = nodes.find(nodeName);
-	if (node == nodes.end())
+	for (auto& node : nodes)
 	{
-		CoreLogError(DefaultLogger, "Texture update: No node \'%s\' is configured in the framegraph (could have been pruned).",
-			nodeName.c_str());
-		return;
+		node.second->ApplyPendingDescriptorUpdates(frameInFlight);
 	}
-	nodes[nodeName]->UpdateTexture(name, frameInFlight, texture);
 }
 
-void FrameGraph::UpdateStorageBuffer(const std::string& nodeName, const std::string& name, int frameInFlight,
-	HawkEye::HBuffer storageBuffer)
+void FrameGraph::CollectRetiredMaterials()
 {
-	auto node = nodes.find(nodeName);
-	if (node == nodes.end())
+	for (auto& node : nodes)
 	{
-		CoreLogError(DefaultLogger, "Buffer update: No node \'%s\' is configured in the frame graph (could have been pruned).",
-			nodeName.c_str());
-		return;
+		node.second->CollectRetiredMaterials(false);
+	}
+}
+
+void FrameGraph::Resize(const CommonFrameData& commonFrameData)
+{
+	RecursivelyResize(finalNode, commonFrameData);
+
+	// Targets (and possibly the swapchain image count) changed, so all nodes are recorded again.
+	for (auto&& node : nodes)
+	{
+		node.second->FreeCommandBuffers(commonFrameData);
+		node.second->AllocateCommandBuffers(commonFrameData);
 	}
-	nodes[nodeName]->UpdateStorageBuffer(name, frameInFlight, storageBuffer);
 }
 
 HawkEye::HMaterial FrameGraph::CreateMaterial(const std::string& nodeName, void* data, int dataSize)
@@ -147,6 +160,18 @@ HawkEye::HMaterial FrameGraph::CreateMaterial(const std::string& nodeName, void*
 	return nodes[nodeName]->CreateMaterial(data, dataSize);
 }
 
+void FrameGraph::DeleteMaterial(const std::string& nodeName, HawkEye::HMaterial material)
+{
+	auto node = nodes.find(nodeName);
+	if (node == nodes.end())
+	{
+		CoreLogError(DefaultLogger, "Material deletion: No node \'%s\' is configured in the frame graph (could have been pruned).",
+			nodeName.c_str());
+		return;
+	}
+	node->second->DeleteMaterial(material);
+}
+
 void FrameGraph::UseBuffers(const std::string& nodeName, HawkEye::Pipeline::DrawBuffer* drawBuffers, int bufferCount)
 {
 	auto node = nodes.find(nodeName);
@@ -159,7 +184,15 @@ void FrameGraph::UseBuffers(const std::string& nodeName, HawkEye::Pipeline::Draw
 	nodes[nodeName]->UseBuffers(drawBuffers, bufferCount);
 }
 
-VkAttachmentDescription GetAttachmentDescription(const CommonFrameData& commonFrameData,
+void FrameGraph::GetNodes(std::vector<FrameGraphNode*>& configuredNodes) const
+{
+	for (auto& node : nodes)
+	{
+		configuredNodes.push_back(node.second.get());
+	}
+}
+
+static VkAttachmentDescription GetAttachmentDescription(const CommonFrameData& commonFrameData,
 	const InputImageCharacteristics* const inputCharacteristics,
 	const OutputImageCharacteristics* const outputCharacteristics,
 	bool first, bool last, bool depthStencil)
@@ -401,7 +434,8 @@ VkRenderPass FrameGraph::RecursivelyConfigure(FrameGraphNode* node, FrameGraphNo
 			renderPassInfo.dependencyCount = dependencyCount;
 			renderPassInfo.pDependencies = dependencies;
 
-			VulkanCheck(vkCreateRenderPass(backendData->logicalDevice, &renderPassInfo, nullptr, &renderPass));
+			// Chains with the same attachments share the render pass, across pipelines as well.
+			renderPass = commonFrameData.rendererData->objectCache.AcquireRenderPass(renderPassInfo);
 
 			renderPasses.push_back(renderPass);
 		}
@@ -424,8 +458,7 @@ struct OutputReference
 	const OutputTargetCharacteristics& reference;
 };
 
-const OutputTargetCharacteristics& FrameGraph::RecursivelyRecord(VkCommandBuffer commandBuffer, int frameInFlight,
-	const CommonFrameData& commonFrameData, FrameGraphNode* node, FrameGraphNode* nextNode)
+void FrameGraph::RecursivelyOrder(FrameGraphNode* node, FrameGraphNode* nextNode)
 {
 	// Get all previous nodes.
 	const auto& inputCharacteristics = node->GetInputCharacteristics();
@@ -448,13 +481,11 @@ const OutputTargetCharacteristics& FrameGraph::RecursivelyRecord(VkCommandBuffer
 		}
 	}
 
-	// Use input nodes' outputs to configure this node.
+	// Input nodes are recorded first.
 	bool allDependenciesCompute = true;
-	std::vector<OutputReference> outputCharacteristics;
 	for (const auto& dependency : dependencies)
 	{
-		outputCharacteristics.push_back(
-			{ RecursivelyRecord(commandBuffer, frameInFlight, commonFrameData, nodes[dependency].get(), node) });
+		RecursivelyOrder(nodes[dependency].get(), node);
 		if (nodes[dependency]->GetType() == FrameGraphNodeType::Rasterized)
 		{
 			allDependenciesCompute = false;
@@ -466,9 +497,15 @@ const OutputTargetCharacteristics& FrameGraph::RecursivelyRecord(VkCommandBuffer
 	const bool startPass = dependencies.empty() || allDependenciesCompute;
 	const bool endPass = !nextNode || nextNode->GetType() == FrameGraphNodeType::Computed;
 
-	bool containsData = node->Record(commandBuffer, frameInFlight, commonFrameData, startPass, endPass);
-
-	return node->GetOutputCharacteristics();
+	// Nodes shared by several inputs are only recorded once.
+	for (int s = 0; s < recordSteps.size(); ++s)
+	{
+		if (recordSteps[s].node == node)
+		{
+			return;
+		}
+	}
+	recordSteps.push_back({ node, startPass, endPass });
 }
 
 void FrameGraph::RecursivelyResize(FrameGraphNode* node, const CommonFrameData& commonFrameData)
@@ -13,28 +13,43 @@ public:
 	void Configure(const YAML::Node& graphConfiguration, const CommonFrameData& commonFrameData);
 	void Shutdown(const CommonFrameData& commonFrameData);
 
-	void Record(VkCommandBuffer commandBuffer, int frameInFlight, const CommonFrameData& commonFrameData);
+	void Record(VkCommandBuffer commandBuffer, int frameInFlight, int imageIndex, const CommonFrameData& commonFrameData);
+	// True if any node's secondary command buffer for the frame and image is dirty.
+	bool NeedsRecording(int frameInFlight, int imageIndex) const;
+	void MarkCommandBuffersDirty();
+	// Binds the resources whose uploads completed to the frame's descriptor sets (the frame has to be finished).
+	void ApplyPendingDescriptorUpdates(int frameInFlight);
+	// Recycles the descriptor sets of deleted materials that no submitted frame uses anymore.
+	void CollectRetiredMaterials();
 
 	void Resize(const CommonFrameData& commonFrameData);
-	
-	void UpdatePreallocatedUniformData(const std::string& nodeName, const std::string& name, int frameInFlight, void* data, int dataSize);
-	void UpdateTexture(const std::string& nodeName, const std::string& name, int frameInFlight, HawkEye::HTexture texture);
-	void UpdateStorageBuffer(const std::string& nodeName, const std::string& name, int frameInFlight, HawkEye::HBuffer storageBuffer);
 
 	HawkEye::HMaterial CreateMaterial(const std::string& nodeName, void* data, int dataSize);
+	void DeleteMaterial(const std::string& nodeName, HawkEye::HMaterial material);
 
 	void UseBuffers(const std::string& nodeName, HawkEye::Pipeline::DrawBuffer* drawBuffers, int bufferCount);
 
+	// All nodes left after pruning (i.e., configured).
+	void GetNodes(std::vector<FrameGraphNode*>& configuredNodes) const;
+
 private:
 	VkRenderPass RecursivelyConfigure(FrameGraphNode* node, FrameGraphNode* nextNode, const YAML::Node& graphConfiguration,
 		const CommonFrameData& commonFrameData, const std::vector<InputTargetCharacteristics>* nextInputCharacteristics);
-	const OutputTargetCharacteristics& RecursivelyRecord(VkCommandBuffer commandBuffer, int frameInFlight,
-		const CommonFrameData& commonFrameData, FrameGraphNode* node, FrameGraphNode* nextNode);
+	// Fills recordSteps in dependency order.
+	void RecursivelyOrder(FrameGraphNode* node, FrameGraphNode* nextNode);
 	void RecursivelyResize(FrameGraphNode* node, const CommonFrameData& commonFrameData);
 	// Deletes all nodes that have not been configured (not relevant to rendering).
 	void PruneGraph();
 
+	struct RecordStep
+	{
+		FrameGraphNode* node;
+		bool startRenderPass;
+		bool endRenderPass;
+	};
+
 	std::map<std::string, std::unique_ptr<FrameGraphNode>> nodes;
+	std::vector<RecordStep> recordSteps;
 	FrameGraphNode* finalNode;
 	std::vector<VkRenderPass> renderPasses;
 	VulkanBackend::BackendData* backendData;
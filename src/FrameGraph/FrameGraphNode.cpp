@@ -1,5 +1,14 @@
 #include "FrameGraphNode.hpp"
 #include <SoftwareCore/DefaultLogger.hpp>
+#include "../ThreadPool.hpp"
+#include "../RendererData.hpp"
+#include "../Resources.hpp"
+#include <VulkanBackend/ErrorCheck.hpp>
+#include <algorithm>
+
+// Table index and material index.
+static const int materialPushConstantSize = 8;
+static const int initialMaterialCapacity = 256;
 
 FrameGraphNode::FrameGraphNode(const std::string& name, int framesInFlightCount, FrameGraphNodeType type, bool isFinal)
 	: name(name), framesInFlightCount(framesInFlightCount), type(type), isFinal(isFinal) {}
@@ -39,34 +48,232 @@ void FrameGraphNode::SetIsFinalBlock(bool isFinalBlock)
 	this->isFinalBlock = isFinalBlock;
 }
 
-void FrameGraphNode::UpdatePreallocatedUniformData(const std::string& name, int frameInFlight, void* data, int dataSize)
+void FrameGraphNode::AllocateCommandBuffers(const CommonFrameData& commonFrameData)
+{
+	commandBufferImageCount = commonFrameData.swapchainImageCount;
+	commandBufferChunkCount = GetRecordingChunkCount(commonFrameData);
+	const int commandBuffersPerChunk = framesInFlightCount * commandBufferImageCount;
+
+	commandBuffers.resize(commandBuffersPerChunk * commandBufferChunkCount);
+	commandPools.resize(commandBufferChunkCount);
+	std::vector<VkCommandBuffer> chunkCommandBuffers(commandBuffersPerChunk);
+	for (int c = 0; c < commandBufferChunkCount; ++c)
+	{
+		commandPools[c] = VulkanBackend::CreateCommandPool(*commonFrameData.backendData,
+			commonFrameData.backendData->generalFamilyIndex, VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT);
+
+		VkCommandBufferAllocateInfo commandBufferAllocateInfo{};
+		commandBufferAllocateInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+		commandBufferAllocateInfo.commandPool = commandPools[c];
+		commandBufferAllocateInfo.level = VK_COMMAND_BUFFER_LEVEL_SECONDARY;
+		commandBufferAllocateInfo.commandBufferCount = (uint32_t)commandBuffersPerChunk;
+		VulkanCheck(vkAllocateCommandBuffers(commonFrameData.backendData->logicalDevice, &commandBufferAllocateInfo,
+			chunkCommandBuffers.data()));
+
+		for (int b = 0; b < commandBuffersPerChunk; ++b)
+		{
+			commandBuffers[b * commandBufferChunkCount + c].commandBuffer = chunkCommandBuffers[b];
+			commandBuffers[b * commandBufferChunkCount + c].dirty = true;
+		}
+	}
+}
+
+void FrameGraphNode::FreeCommandBuffers(const CommonFrameData& commonFrameData)
+{
+	// Destroying the pools frees their command buffers.
+	for (int c = 0; c < commandPools.size(); ++c)
+	{
+		VulkanBackend::DestroyCommandPool(*commonFrameData.backendData, commandPools[c]);
+	}
+	commandPools.clear();
+	commandBuffers.clear();
+}
+
+void FrameGraphNode::MarkCommandBuffersDirty()
+{
+	for (int c = 0; c < commandBuffers.size(); ++c)
+	{
+		commandBuffers[c].dirty = true;
+	}
+}
+
+bool FrameGraphNode::NeedsRecording(int frameInFlight, int imageIndex) const
+{
+	const int firstChunk = (frameInFlight * commandBufferImageCount + imageIndex) * commandBufferChunkCount;
+	for (int c = 0; c < commandBufferChunkCount; ++c)
+	{
+		if (commandBuffers[firstChunk + c].dirty)
+		{
+			return true;
+		}
+	}
+	return false;
+}
+
+void FrameGraphNode::RecordCommandBuffers(int frameInFlight, int imageIndex, const CommonFrameData& commonFrameData,
+	bool endRenderPass)
+{
+	const int firstChunk = (frameInFlight * commandBufferImageCount + imageIndex) * commandBufferChunkCount;
+	for (int c = 0; c < commandBufferChunkCount; ++c)
+	{
+		CommandBufferData& commandBufferData = commandBuffers[firstChunk + c];
+		if (!commandBufferData.dirty)
+		{
+			continue;
+		}
+		commandBufferData.dirty = false;
+
+		auto record = [this, &commandBufferData, &commonFrameData, c, frameInFlight, imageIndex, endRenderPass]()
+		{
+			VulkanBackend::ResetCommandBuffer(commandBufferData.commandBuffer);
+
+			// The render pass may have been begun by a previous node, so the framebuffer is left unspecified.
+			const bool insideRenderPass = type == FrameGraphNodeType::Rasterized;
+			VkCommandBufferInheritanceInfo commandBufferInheritanceInfo{};
+			commandBufferInheritanceInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
+			commandBufferInheritanceInfo.renderPass = insideRenderPass ? renderPassReference : VK_NULL_HANDLE;
+			commandBufferInheritanceInfo.subpass = 0;
+
+			VkCommandBufferBeginInfo commandBufferBeginInfo{};
+			commandBufferBeginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+			commandBufferBeginInfo.flags = insideRenderPass ? VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT : 0;
+			commandBufferBeginInfo.pInheritanceInfo = &commandBufferInheritanceInfo;
+			vkBeginCommandBuffer(commandBufferData.commandBuffer, &commandBufferBeginInfo);
+
+			RecordCommands(commandBufferData.commandBuffer, c, frameInFlight, imageIndex, commonFrameData, endRenderPass);
+
+			vkEndCommandBuffer(commandBufferData.commandBuffer);
+		};
+
+		if (commonFrameData.threadPool)
+		{
+			commonFrameData.threadPool->Submit(record);
+		}
+		else
+		{
+			record();
+		}
+	}
+}
+
+int FrameGraphNode::GetRecordingChunkCount(const CommonFrameData& commonFrameData) const
+{
+	return 1;
+}
+
+void FrameGraphNode::ExecuteCommands(VkCommandBuffer commandBuffer, int frameInFlight, int imageIndex)
+{
+	const int firstChunk = (frameInFlight * commandBufferImageCount + imageIndex) * commandBufferChunkCount;
+	std::vector<VkCommandBuffer> chunkCommandBuffers(commandBufferChunkCount);
+	for (int c = 0; c < commandBufferChunkCount; ++c)
+	{
+		chunkCommandBuffers[c] = commandBuffers[firstChunk + c].commandBuffer;
+	}
+	vkCmdExecuteCommands(commandBuffer, (uint32_t)chunkCommandBuffers.size(), chunkCommandBuffers.data());
+}
+
+void FrameGraphNode::UpdatePreallocatedUniformData(int binding, int frameInFlight, void* data, int dataSize,
+	std::vector<UniformCopy>& uniformCopies)
 {
 	if (!configured)
 	{
-		CoreLogError(DefaultLogger, "Uniform update: No uniform \'%s\' configured for node \'%s\'", name.c_str(), this->name.c_str());
+		CoreLogError(DefaultLogger, "Uniform update: No uniforms configured for node \'%s\'", name.c_str());
 		return;
 	}
-	uniformDescriptorSystem.UpdatePreallocated(name, frameInFlight, data, dataSize);
+	uniformDescriptorSystem.UpdatePreallocated(binding, frameInFlight, data, dataSize, &uniformCopies);
 }
 
-void FrameGraphNode::UpdateTexture(const std::string& name, int frameInFlight, HawkEye::HTexture texture)
+void FrameGraphNode::UpdateTexture(int binding, int frameInFlight, HawkEye::HTexture texture)
 {
 	if (!configured)
 	{
-		CoreLogError(DefaultLogger, "Uniform update: No texture uniform \'%s\' configured for node \'%s\'", name.c_str(), this->name.c_str());
+		CoreLogError(DefaultLogger, "Uniform update: No texture uniforms configured for node \'%s\'", name.c_str());
 		return;
 	}
-	uniformDescriptorSystem.UpdateTexture(name, frameInFlight, texture);
+	UpdateDescriptorTexture(&uniformDescriptorSystem, binding, frameInFlight, texture);
 }
 
-void FrameGraphNode::UpdateStorageBuffer(const std::string& name, int frameInFlight, HawkEye::HBuffer storageBuffer)
+void FrameGraphNode::UpdateStorageBuffer(int binding, int frameInFlight, HawkEye::HBuffer storageBuffer)
 {
 	if (!configured)
 	{
-		CoreLogError(DefaultLogger, "Uniform update: No buffer uniform \'%s\' configured for node \'%s\'", name.c_str(), this->name.c_str());
+		CoreLogError(DefaultLogger, "Uniform update: No buffer uniforms configured for node \'%s\'", name.c_str());
 		return;
 	}
-	uniformDescriptorSystem.UpdateBuffer(name, frameInFlight, storageBuffer);
+	uniformDescriptorSystem.UpdateBuffer(binding, frameInFlight, storageBuffer);
+}
+
+void FrameGraphNode::ApplyPendingDescriptorUpdates(int frameInFlight)
+{
+	for (int p = (int)pendingDescriptorUpdates.size() - 1; p >= 0; --p)
+	{
+		const PendingDescriptorUpdate& update = pendingDescriptorUpdates[p];
+		if (update.frameInFlight != frameInFlight)
+		{
+			continue;
+		}
+
+		// Other frames' sets may still be in use, this one's frame has finished.
+		if (HawkEye::UploadFinished(rendererData, update.texture) &&
+			update.descriptorSystem->UpdateTexture(update.binding, frameInFlight, update.texture))
+		{
+			pendingDescriptorUpdates[p] = pendingDescriptorUpdates.back();
+			pendingDescriptorUpdates.pop_back();
+		}
+	}
+}
+
+void FrameGraphNode::UpdateDescriptorTexture(DescriptorSystem* descriptorSystem, int binding, int frameInFlight,
+	HawkEye::HTexture texture)
+{
+	const bool written = descriptorSystem->UpdateTexture(binding, frameInFlight, texture);
+	SetPendingDescriptorUpdate(descriptorSystem, binding, frameInFlight, written ? nullptr : texture);
+}
+
+void FrameGraphNode::SetPendingDescriptorUpdate(DescriptorSystem* descriptorSystem, int binding, int frameInFlight,
+	HawkEye::HTexture texture)
+{
+	// A resource bound later wins over one still waiting for its upload.
+	for (int p = 0; p < pendingDescriptorUpdates.size(); ++p)
+	{
+		const PendingDescriptorUpdate& update = pendingDescriptorUpdates[p];
+		if (update.descriptorSystem == descriptorSystem && update.binding == binding && update.frameInFlight == frameInFlight)
+		{
+			pendingDescriptorUpdates[p] = pendingDescriptorUpdates.back();
+			pendingDescriptorUpdates.pop_back();
+			break;
+		}
+	}
+
+	if (texture)
+	{
+		pendingDescriptorUpdates.push_back({ descriptorSystem, binding, frameInFlight, texture });
+	}
+}
+
+void FrameGraphNode::DropPendingDescriptorUpdates(DescriptorSystem* descriptorSystem)
+{
+	for (int p = (int)pendingDescriptorUpdates.size() - 1; p >= 0; --p)
+	{
+		if (pendingDescriptorUpdates[p].descriptorSystem == descriptorSystem)
+		{
+			pendingDescriptorUpdates[p] = pendingDescriptorUpdates.back();
+			pendingDescriptorUpdates.pop_back();
+		}
+	}
+}
+
+void FrameGraphNode::UpdatePushConstant(int index, int frameInFlight, void* data, int dataSize)
+{
+	const PushConstantData& pushConstant = pushConstantData[index];
+	memcpy(pushConstantValues.data() + frameInFlight * pushConstantSize + pushConstant.offset, data,
+		dataSize < pushConstant.size ? dataSize : pushConstant.size);
+
+	const int frameCommandBufferCount = commandBufferImageCount * commandBufferChunkCount;
+	for (int c = 0; c < frameCommandBufferCount; ++c)
+	{
+		commandBuffers[frameInFlight * frameCommandBufferCount + c].dirty = true;
+	}
 }
 
 NodeOutputs* FrameGraphNode::GetOutputs()
@@ -84,6 +291,70 @@ const OutputTargetCharacteristics& FrameGraphNode::GetOutputCharacteristics()
 	return nodeOutputCharacteristics;
 }
 
+const std::vector<UniformData>& FrameGraphNode::GetUniforms() const
+{
+	return uniformData;
+}
+
+const std::vector<PushConstantData>& FrameGraphNode::GetPushConstants() const
+{
+	return pushConstantData;
+}
+
+void FrameGraphNode::WriteRingDescriptors()
+{
+	uniformDescriptorSystem.WriteRingDescriptors();
+}
+
+void FrameGraphNode::ConfigurePushConstants()
+{
+	VkPhysicalDeviceProperties physicalDeviceProperties;
+	vkGetPhysicalDeviceProperties(backendData->physicalDevice, &physicalDeviceProperties);
+	const int maxPushConstantsSize = (int)physicalDeviceProperties.limits.maxPushConstantsSize -
+		(bindless ? materialPushConstantSize : 0);
+
+	pushConstantSize = 0;
+	pushConstantStages = 0;
+	for (int p = 0; p < pushConstantData.size(); ++p)
+	{
+		if (pushConstantData[p].offset + pushConstantData[p].size > maxPushConstantsSize)
+		{
+			CoreLogError(DefaultLogger, "Node \'%s\': Push constants exceed the device limit of %d bytes - skipping \'%s\' and the following ones.",
+				name.c_str(), maxPushConstantsSize, pushConstantData[p].name.c_str());
+			pushConstantData.resize(p);
+			break;
+		}
+		pushConstantSize = pushConstantData[p].offset + pushConstantData[p].size;
+		pushConstantStages |= pushConstantData[p].visibility;
+	}
+	if (bindless)
+	{
+		pushConstantStages |= VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT;
+	}
+
+	pushConstantValues.assign(pushConstantSize * framesInFlightCount, 0);
+}
+
+std::vector<VkPushConstantRange> FrameGraphNode::GetPushConstantRanges() const
+{
+	std::vector<VkPushConstantRange> pushConstantRanges;
+	const int rangeSize = pushConstantSize + (bindless ? materialPushConstantSize : 0);
+	if (rangeSize > 0)
+	{
+		pushConstantRanges.push_back({ pushConstantStages, 0, (uint32_t)rangeSize });
+	}
+	return pushConstantRanges;
+}
+
+void FrameGraphNode::RecordPushConstants(VkCommandBuffer commandBuffer, int frameInFlight) const
+{
+	if (pushConstantSize > 0)
+	{
+		vkCmdPushConstants(commandBuffer, pipelineLayout, pushConstantStages, 0, (uint32_t)pushConstantSize,
+			pushConstantValues.data() + frameInFlight * pushConstantSize);
+	}
+}
+
 HawkEye::HMaterial FrameGraphNode::CreateMaterial(void* data, int dataSize)
 {
 	// TODO: Checks (e.g., dataSize)
@@ -92,9 +363,13 @@ HawkEye::HMaterial FrameGraphNode::CreateMaterial(void* data, int dataSize)
 		CoreLogError(DefaultLogger, "Material creation: Only allowed for rasterized nodes (node \'%s\').", name);
 		return -1;
 	}
+	if (bindless)
+	{
+		return CreateBindlessMaterial(data, dataSize);
+	}
 
-	int materialIndex = (int)materialDescriptorSystems.size();
-	materialDescriptorSystems.push_back(std::make_unique<DescriptorSystem>());
+	const int materialIndex = AcquireMaterialIndex();
+	materialDescriptorSystems[materialIndex] = std::make_unique<DescriptorSystem>();
 	materialDescriptorSystems[materialIndex]->Init(backendData, rendererData, materialData, framesInFlightCount,
 		materialDescriptorSetLayout);
 
@@ -106,28 +381,202 @@ HawkEye::HMaterial FrameGraphNode::CreateMaterial(void* data, int dataSize)
 			void* currentData = (void*)((int*)data + offset);
 			if (materialData[u].type == VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER)
 			{
-				materialDescriptorSystems[materialIndex]->UpdatePreallocated(materialData[u].name, f,
+				materialDescriptorSystems[materialIndex]->UpdatePreallocated(u, f,
 					currentData, materialData[u].size);
 			}
 			else if (materialData[u].type == VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER)
 			{
-				materialDescriptorSystems[materialIndex]->UpdateTexture(materialData[u].name, f,
+				UpdateDescriptorTexture(materialDescriptorSystems[materialIndex].get(), u, f,
 					(HawkEye::HTexture)currentData);
 			}
 			else if (materialData[u].type == VK_DESCRIPTOR_TYPE_STORAGE_BUFFER)
 			{
-				materialDescriptorSystems[materialIndex]->UpdateBuffer(materialData[u].name, f,
+				materialDescriptorSystems[materialIndex]->UpdateBuffer(u, f,
 					(HawkEye::HBuffer)currentData);
 			}
 		}
 		offset += materialData[u].size;
 	}
 
-	drawBuffers.emplace_back();
+	MarkCommandBuffersDirty();
 	
 	return (HawkEye::HMaterial)materialIndex;
 }
 
+void FrameGraphNode::DeleteMaterial(HawkEye::HMaterial material)
+{
+	if (material < 0 || material >= liveMaterials.size() || !liveMaterials[material])
+	{
+		CoreLogError(DefaultLogger, "Material deletion: Node \'%s\' has no material %d - skipping.", name.c_str(), material);
+		return;
+	}
+
+	// Command buffers recorded from now on no longer use the material.
+	if (materialDescriptorSystems[material])
+	{
+		DropPendingDescriptorUpdates(materialDescriptorSystems[material].get());
+		retiredMaterials.push_back({ rendererData->graphicsTimeline.GetSubmittedValue(),
+			std::move(materialDescriptorSystems[material]) });
+	}
+	drawBuffers[material].clear();
+	liveMaterials[material] = false;
+	freeMaterialIndices.push_back(material);
+	MarkCommandBuffersDirty();
+}
+
+int FrameGraphNode::AcquireMaterialIndex()
+{
+	int materialIndex;
+	if (!freeMaterialIndices.empty())
+	{
+		materialIndex = freeMaterialIndices.back();
+		freeMaterialIndices.pop_back();
+	}
+	else
+	{
+		materialIndex = (int)drawBuffers.size();
+		drawBuffers.emplace_back();
+		materialDescriptorSystems.emplace_back();
+		liveMaterials.push_back(false);
+	}
+	liveMaterials[materialIndex] = true;
+	return materialIndex;
+}
+
+void FrameGraphNode::CollectRetiredMaterials(bool waitForAll)
+{
+	for (int r = (int)retiredMaterials.size() - 1; r >= 0; --r)
+	{
+		if (waitForAll)
+		{
+			rendererData->graphicsTimeline.Wait(retiredMaterials[r].graphicsValue);
+		}
+		else if (!rendererData->graphicsTimeline.Reached(retiredMaterials[r].graphicsValue))
+		{
+			continue;
+		}
+
+		retiredMaterials[r].descriptorSystem->Shutdown();
+		retiredMaterials[r] = std::move(retiredMaterials.back());
+		retiredMaterials.pop_back();
+	}
+}
+
+void FrameGraphNode::ShutdownMaterials()
+{
+	CollectRetiredMaterials(true);
+	for (int m = 0; m < materialDescriptorSystems.size(); ++m)
+	{
+		if (materialDescriptorSystems[m])
+		{
+			materialDescriptorSystems[m]->Shutdown();
+		}
+	}
+	materialDescriptorSystems.clear();
+	pendingDescriptorUpdates.clear();
+	liveMaterials.clear();
+	freeMaterialIndices.clear();
+	DeleteMaterialTable();
+}
+
+HawkEye::HMaterial FrameGraphNode::CreateBindlessMaterial(void* data, int dataSize)
+{
+	int expectedSize = 0;
+	for (int u = 0; u < materialData.size(); ++u)
+	{
+		expectedSize += materialData[u].size;
+	}
+	if (dataSize < expectedSize)
+	{
+		CoreLogError(DefaultLogger, "Material creation: Expected %d bytes of material data for node \'%s\'.", expectedSize, name.c_str());
+		return -1;
+	}
+
+	const int materialIndex = AcquireMaterialIndex();
+	if (materialIndex == materialCapacity)
+	{
+		GrowMaterialTable();
+	}
+
+	uint8_t* entry = materialTableData.data() + (size_t)materialIndex * materialStride;
+	const uint8_t* source = (const uint8_t*)data;
+	int entryOffset = 0;
+	for (int u = 0; u < materialData.size(); ++u)
+	{
+		if (materialData[u].type == VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER)
+		{
+			memcpy(entry + entryOffset, source, materialData[u].size);
+			entryOffset += (materialData[u].size + 3) / 4 * 4;
+		}
+		else
+		{
+			int32_t index = -1;
+			if (materialData[u].type == VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER)
+			{
+				HawkEye::HTexture texture;
+				memcpy(&texture, source, sizeof(texture));
+				index = ResourceUtils::GetBindlessIndex(rendererData, texture);
+			}
+			else if (materialData[u].type == VK_DESCRIPTOR_TYPE_STORAGE_BUFFER)
+			{
+				HawkEye::HBuffer buffer;
+				memcpy(&buffer, source, sizeof(buffer));
+				index = ResourceUtils::GetBindlessIndex(rendererData, buffer);
+			}
+			memcpy(entry + entryOffset, &index, sizeof(index));
+			entryOffset += sizeof(index);
+		}
+		source += materialData[u].size;
+	}
+	HawkEye::UpdateBuffer(rendererData, materialTable, materialIndex * materialStride, entry, materialStride);
+
+	MarkCommandBuffersDirty();
+
+	return (HawkEye::HMaterial)materialIndex;
+}
+
+void FrameGraphNode::GrowMaterialTable()
+{
+	if (materialStride == 0)
+	{
+		for (int u = 0; u < materialData.size(); ++u)
+		{
+			materialStride += materialData[u].type == VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER ? (materialData[u].size + 3) / 4 * 4 : 4;
+		}
+		materialStride = std::max((materialStride + 15) / 16 * 16, 16);
+	}
+
+	materialCapacity = std::max(materialCapacity * 2, initialMaterialCapacity);
+	materialTableData.resize((size_t)materialCapacity * materialStride);
+	HawkEye::HBuffer grownTable = HawkEye::UploadBuffer(rendererData, materialTableData.data(), (int)materialTableData.size(),
+		HawkEye::BufferUsage::Storage, HawkEye::BufferType::DeviceLocal);
+
+	if (materialTable)
+	{
+		rendererData->graphicsTimeline.Wait(rendererData->graphicsTimeline.GetSubmittedValue());
+		DeleteMaterialTable();
+	}
+	materialTable = grownTable;
+	materialTableIndex = ResourceUtils::GetBindlessIndex(rendererData, materialTable);
+	MarkCommandBuffersDirty();
+}
+
+void FrameGraphNode::RecordMaterialPushConstant(VkCommandBuffer commandBuffer, int material) const
+{
+	const int32_t indices[2] = { materialTableIndex, material };
+	vkCmdPushConstants(commandBuffer, pipelineLayout, pushConstantStages, (uint32_t)pushConstantSize,
+		materialPushConstantSize, indices);
+}
+
+void FrameGraphNode::DeleteMaterialTable()
+{
+	if (materialTable)
+	{
+		HawkEye::DeleteBuffer(rendererData, materialTable);
+		materialTableIndex = -1;
+	}
+}
+
 void FrameGraphNode::UseBuffers(HawkEye::Pipeline::DrawBuffer* drawBuffers, int bufferCount)
 {
 	for (int m = 0; m < this->drawBuffers.size(); ++m)
@@ -136,6 +585,25 @@ void FrameGraphNode::UseBuffers(HawkEye::Pipeline::DrawBuffer* drawBuffers, int
 	}
 	for (int b = 0; b < bufferCount; ++b)
 	{
-		this->drawBuffers[(int)drawBuffers[b].material].push_back(drawBuffers[b]);
+		const int material = (int)drawBuffers[b].material;
+		if (material < 0 || material >= liveMaterials.size() || !liveMaterials[material])
+		{
+			CoreLogError(DefaultLogger, "Buffer usage: Node \'%s\' has no material %d - skipping the draw.", name.c_str(), material);
+			continue;
+		}
+
+		// Recording reads the buffer handles and offsets, which asynchronous uploads only set once recorded.
+		const HawkEye::HBuffer buffers[3] = { drawBuffers[b].vertexBuffer, drawBuffers[b].indexBuffer, drawBuffers[b].instanceBuffer };
+		for (int i = 0; i < 3; ++i)
+		{
+			if (buffers[i])
+			{
+				ResourceUtils::WaitForRecording(rendererData, buffers[i]->uploadValue);
+			}
+		}
+		this->drawBuffers[material].push_back(drawBuffers[b]);
 	}
+
+	// Only this node's draws changed, the other nodes keep their recorded commands.
+	MarkCommandBuffersDirty();
 }
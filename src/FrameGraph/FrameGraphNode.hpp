@@ -25,26 +25,81 @@ public:
 
 	virtual void Shutdown(const CommonFrameData& commonFrameData) = 0;
 
-	virtual bool Record(VkCommandBuffer commandBuffer, int frameInFlight, const CommonFrameData& commonFrameData,
+	// Executes the node's cached secondary command buffers from the primary one.
+	virtual bool Record(VkCommandBuffer commandBuffer, int frameInFlight, int imageIndex, const CommonFrameData& commonFrameData,
 		bool startRenderPass, bool endRenderPass) = 0;
 
 	virtual void Resize(const CommonFrameData& commonFrameData, const std::vector<NodeOutputs*>& nodeInputs) = 0;
 
-	void UpdatePreallocatedUniformData(const std::string& name, int frameInFlight, void* data, int dataSize);
-	void UpdateTexture(const std::string& name, int frameInFlight, HawkEye::HTexture texture);
-	void UpdateStorageBuffer(const std::string& name, int frameInFlight, HawkEye::HBuffer storageBuffer);
+	// One secondary command buffer per frame in flight, swapchain image and recording chunk.
+	// Every chunk has its own command pool so that chunks can be recorded on different threads.
+	void AllocateCommandBuffers(const CommonFrameData& commonFrameData);
+	void FreeCommandBuffers(const CommonFrameData& commonFrameData);
+	void MarkCommandBuffersDirty();
+	// Re-records the dirty chunks, on the thread pool if there is one (the caller waits for it).
+	void RecordCommandBuffers(int frameInFlight, int imageIndex, const CommonFrameData& commonFrameData, bool endRenderPass);
+	// Primary command buffers executing a re-recorded secondary one have to be recorded again as well.
+	bool NeedsRecording(int frameInFlight, int imageIndex) const;
+
+	// Bindings are indices into GetUniforms().
+	// Device-local uniforms are collected into the copy list, the data has to live until the copies are recorded.
+	void UpdatePreallocatedUniformData(int binding, int frameInFlight, void* data, int dataSize,
+		std::vector<UniformCopy>& uniformCopies);
+	// Textures still being uploaded are bound once a later frame finds their upload completed, a placeholder until then.
+	void UpdateTexture(int binding, int frameInFlight, HawkEye::HTexture texture);
+	void UpdateStorageBuffer(int binding, int frameInFlight, HawkEye::HBuffer storageBuffer);
+	// Writes the descriptors of the frame whose textures have completed their uploads since they were bound.
+	void ApplyPendingDescriptorUpdates(int frameInFlight);
+	// Shuts down the descriptor systems of deleted materials the GPU is done with.
+	void CollectRetiredMaterials(bool waitForAll);
+	// Marks only this node's command buffers of the frame for re-recording.
+	void UpdatePushConstant(int index, int frameInFlight, void* data, int dataSize);
 
 	NodeOutputs* GetOutputs();
 
 	const std::vector<InputTargetCharacteristics>& GetInputCharacteristics() const;
 	const OutputTargetCharacteristics& GetOutputCharacteristics();
+	const std::vector<UniformData>& GetUniforms() const;
+	const std::vector<PushConstantData>& GetPushConstants() const;
+	void WriteRingDescriptors();
 
+	// Bindless nodes write the material into their material table instead of creating descriptor sets.
 	HawkEye::HMaterial CreateMaterial(void* data, int dataSize);
 	// TODO: Update material?
+	// The material's index is reused by later materials. Its descriptor sets are recycled once the submitted frames finish.
+	void DeleteMaterial(HawkEye::HMaterial material);
 
 	void UseBuffers(HawkEye::Pipeline::DrawBuffer* drawBuffers, int bufferCount);
 
 protected:
+	virtual int GetRecordingChunkCount(const CommonFrameData& commonFrameData) const;
+	virtual void RecordCommands(VkCommandBuffer commandBuffer, int chunk, int frameInFlight, int imageIndex,
+		const CommonFrameData& commonFrameData, bool endRenderPass) = 0;
+	void ExecuteCommands(VkCommandBuffer commandBuffer, int frameInFlight, int imageIndex);
+
+	// Drops the push constants that do not fit the device limit and allocates their per-frame values.
+	void ConfigurePushConstants();
+	// Vulkan forbids ranges sharing a stage, so all push constants form a single range.
+	std::vector<VkPushConstantRange> GetPushConstantRanges() const;
+	void RecordPushConstants(VkCommandBuffer commandBuffer, int frameInFlight) const;
+
+	// Remembers the texture of a descriptor that got the placeholder (replacing the one bound before).
+	void UpdateDescriptorTexture(DescriptorSystem* descriptorSystem, int binding, int frameInFlight, HawkEye::HTexture texture);
+	void SetPendingDescriptorUpdate(DescriptorSystem* descriptorSystem, int binding, int frameInFlight, HawkEye::HTexture texture);
+	void DropPendingDescriptorUpdates(DescriptorSystem* descriptorSystem);
+
+	// Reuses the index of a deleted material if there is one.
+	int AcquireMaterialIndex();
+	void ShutdownMaterials();
+
+	// Material table entries hold the uniform data (4-byte aligned) and bindless indices in place of textures
+	// and storage buffers, in configuration order. The table's and the material's indices follow the push constants.
+	HawkEye::HMaterial CreateBindlessMaterial(void* data, int dataSize);
+	// Waits for the submitted frames, as their command buffers reference the previous table.
+	void GrowMaterialTable();
+	void RecordMaterialPushConstant(VkCommandBuffer commandBuffer, int material) const;
+	void DeleteMaterialTable();
+
 	std::string name;
 	FrameGraphNodeType type;
 	bool configured = false;
@@ -69,10 +124,48 @@ protected:
 	VkDescriptorSetLayout uniformDescriptorSetLayout;
 	VkDescriptorSetLayout materialDescriptorSetLayout;
 	DescriptorSystem uniformDescriptorSystem;
+	std::vector<UniformData> uniformData;
+	std::vector<PushConstantData> pushConstantData;
+	// Per frame in flight, pushConstantSize bytes each.
+	std::vector<uint8_t> pushConstantValues;
+	int pushConstantSize = 0;
+	VkShaderStageFlags pushConstantStages = 0;
 	std::vector<UniformData> materialData;
+	// Null for deleted and bindless materials.
 	std::vector<std::unique_ptr<DescriptorSystem>> materialDescriptorSystems;
+	std::vector<bool> liveMaterials;
+	std::vector<int> freeMaterialIndices;
+	struct RetiredMaterial
+	{
+		// Graphics timeline value of the last frame that may use the material.
+		uint64_t graphicsValue;
+		std::unique_ptr<DescriptorSystem> descriptorSystem;
+	};
+	std::vector<RetiredMaterial> retiredMaterials;
+	// Descriptors holding a placeholder, applied when their frame in flight is drawn next after the upload completed.
+	struct PendingDescriptorUpdate
+	{
+		DescriptorSystem* descriptorSystem;
+		int binding;
+		int frameInFlight;
+		HawkEye::HTexture texture;
+	};
+	std::vector<PendingDescriptorUpdate> pendingDescriptorUpdates;
+	// Set 0 is the renderer's bindless set, materials live in a storage buffer.
+	bool bindless = false;
+	HawkEye::HBuffer materialTable = nullptr;
+	int materialTableIndex = -1;
+	// Host copy of the table, re-uploaded whole when it grows.
+	std::vector<uint8_t> materialTableData;
+	int materialStride = 0;
+	int materialCapacity = 0;
 	std::vector<InputTargetCharacteristics> nodeInputCharacteristics;
 	NodeOutputs nodeOutputs;
 	OutputTargetCharacteristics nodeOutputCharacteristics;
 	std::vector<VkShaderModule> shaderModules;
+	// Indexed by (frameInFlight * commandBufferImageCount + imageIndex) * commandBufferChunkCount + chunk.
+	std::vector<CommandBufferData> commandBuffers;
+	std::vector<VkCommandPool> commandPools;
+	int commandBufferImageCount = 0;
+	int commandBufferChunkCount = 1;
 };
@@ -24,21 +24,27 @@ struct CommandBufferData
 	VkCommandBuffer commandBuffer;
 };
 
+class UniformRing;
+class ThreadPool;
+
 struct CommonFrameData
 {
 	HawkEye::HRendererData rendererData = nullptr;
 	VulkanBackend::BackendData* backendData = nullptr;
 	std::unique_ptr<VulkanBackend::SurfaceData> surfaceData = nullptr;
-	int framesInFlightCount;
+	int framesInFlightCount = 0;
+	int swapchainImageCount = 0;
 	VkSwapchainKHR swapchain = VK_NULL_HANDLE;
 	std::vector<VkImage> swapchainImages;
 	std::vector<VkImageView> swapchainImageViews;
 	VkPipelineCache pipelineCache = VK_NULL_HANDLE;
+	UniformRing* uniformRing = nullptr;
+	// Records node command buffers in parallel if set.
+	ThreadPool* threadPool = nullptr;
 
 	VkSampler targetSampler;
 
 	VkCommandPool commandPool;
-	std::vector<CommandBufferData> commandBuffers;
 
 	VkQueue graphicsQueue = VK_NULL_HANDLE;
 	VkQueue computeQueue = VK_NULL_HANDLE;
@@ -2,9 +2,45 @@
 #include "../Resources.hpp"
 #include "../Descriptors.hpp"
 #include "../Pipeline.hpp"
+#include "../ThreadPool.hpp"
+#include "../RendererData.hpp"
 #include <SoftwareCore/DefaultLogger.hpp>
 #include <VulkanBackend/ErrorCheck.hpp>
 #include <VulkanShaderCompiler/VulkanShaderCompilerAPI.hpp>
+#include <algorithm>
+
+struct BoundBuffer
+{
+	VkBuffer buffer = VK_NULL_HANDLE;
+	VkDeviceSize offset = 0;
+};
+
+// Keeps the bound buffer if the new one lies in the same arena at a whole number of elements past the bound offset.
+// Returns the element offset to draw with.
+static uint32_t BindVertexBuffer(VkCommandBuffer commandBuffer, uint32_t binding, HawkEye::HBuffer buffer, int stride,
+	BoundBuffer& boundBuffer)
+{
+	const VkDeviceSize offset = buffer->offset;
+	if (buffer->buffer.buffer != boundBuffer.buffer || offset < boundBuffer.offset || (offset - boundBuffer.offset) % stride != 0)
+	{
+		vkCmdBindVertexBuffers(commandBuffer, binding, 1, &buffer->buffer.buffer, &offset);
+		boundBuffer.buffer = buffer->buffer.buffer;
+		boundBuffer.offset = offset;
+	}
+	return (uint32_t)((offset - boundBuffer.offset) / stride);
+}
+
+static uint32_t BindIndexBuffer(VkCommandBuffer commandBuffer, HawkEye::HBuffer buffer, BoundBuffer& boundBuffer)
+{
+	const VkDeviceSize offset = buffer->offset;
+	if (buffer->buffer.buffer != boundBuffer.buffer || offset < boundBuffer.offset || (offset - boundBuffer.offset) % 4 != 0)
+	{
+		vkCmdBindIndexBuffer(commandBuffer, buffer->buffer.buffer, offset, VK_INDEX_TYPE_UINT32);
+		boundBuffer.buffer = buffer->buffer.buffer;
+		boundBuffer.offset = offset;
+	}
+	return (uint32_t)((offset - boundBuffer.offset) / 4);
+}
 
 RasterizeNode::RasterizeNode(const std::string& name, int framesInFlightCount, bool isFinal)
 	: FrameGraphNode(name, framesInFlightCount, FrameGraphNodeType::Rasterized, isFinal)
@@ -92,35 +128,47 @@ void RasterizeNode::Configure(const YAML::Node& nodeConfiguration,
 
 	// framebuffer
 	FrameGraphNode::renderPassReference = renderPassReference;
-	framebuffers.resize(framesInFlightCount);
 	CreateFramebuffers(commonFrameData);
 
 	// descriptors
 	const int descriptorSetLayoutCount = 2;
-	std::vector<UniformData> uniformData;
-	ConfigureUniforms(nodeConfiguration["uniforms"], uniformData);
+	uniformData.clear();
+	pushConstantData.clear();
+	bindless = nodeConfiguration["bindless"] && nodeConfiguration["bindless"].as<bool>();
+	if (bindless && !rendererData->bindlessSet.IsAvailable())
+	{
+		CoreLogError(DefaultLogger, "Node \'%s\': Descriptor indexing is not available - using material descriptor sets.", name.c_str());
+		bindless = false;
+	}
+	ConfigureUniforms(nodeConfiguration["uniforms"], uniformData, &pushConstantData);
+	ConfigurePushConstants();
 	ConfigureUniforms(nodeConfiguration["material"], materialData);
 
-	uniformDescriptorSetLayout = DescriptorSystem::InitSetLayout(backendData, uniformData);
+	uniformDescriptorSetLayout = DescriptorSystem::InitSetLayout(rendererData, uniformData, true);
 	uniformDescriptorSystem.Init(backendData, rendererData, uniformData, framesInFlightCount,
-		uniformDescriptorSetLayout);
+		uniformDescriptorSetLayout, commonFrameData.uniformRing);
 
-	materialDescriptorSetLayout = DescriptorSystem::InitSetLayout(backendData, materialData);
+	materialDescriptorSetLayout = bindless ? rendererData->bindlessSet.GetSetLayout() :
+		DescriptorSystem::InitSetLayout(rendererData, materialData);
 
 	// TODO: Model uniform set.
 	// TODO: Attachment descriptor - I/O.
 
 	// pipeline
+	// Set 0 holds the material (or the bindless set), set 1 the node uniforms.
 	std::vector<VkDescriptorSetLayout> passSetLayouts
 	{
-		uniformDescriptorSetLayout,
-		materialDescriptorSetLayout
+		materialDescriptorSetLayout,
+		uniformDescriptorSetLayout
 	};
 
 	VkPipelineLayoutCreateInfo pipelineLayoutCreateInfo{};
 	pipelineLayoutCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
 	pipelineLayoutCreateInfo.setLayoutCount = (uint32_t)passSetLayouts.size();
 	pipelineLayoutCreateInfo.pSetLayouts = passSetLayouts.data();
+	std::vector<VkPushConstantRange> pushConstantRanges = GetPushConstantRanges();
+	pipelineLayoutCreateInfo.pushConstantRangeCount = (uint32_t)pushConstantRanges.size();
+	pipelineLayoutCreateInfo.pPushConstantRanges = pushConstantRanges.data();
 	VulkanCheck(vkCreatePipelineLayout(backendData->logicalDevice, &pipelineLayoutCreateInfo, nullptr, &pipelineLayout));
 
 	// TODO: Sample count.
@@ -211,9 +259,6 @@ void RasterizeNode::Shutdown(const CommonFrameData& commonFrameData)
 	}
 	shaderModules.clear();
 
-	VulkanBackend::DestroyDescriptorSetLayout(backendData, materialDescriptorSetLayout);
-	VulkanBackend::DestroyDescriptorSetLayout(backendData, uniformDescriptorSetLayout);
-
 	if (nodeOutputs.colorTarget)
 	{
 		FramebufferUtils::DestroyTarget(backendData, *nodeOutputs.colorTarget.get());
@@ -228,14 +273,17 @@ void RasterizeNode::Shutdown(const CommonFrameData& commonFrameData)
 	}
 
 	uniformDescriptorSystem.Shutdown();
+	ShutdownMaterials();
 
-	for (int m = 0; m < materialDescriptorSystems.size(); ++m)
+	// The layouts go last, the allocator releases the sets kept for them.
+	if (!bindless)
 	{
-		materialDescriptorSystems[m]->Shutdown();
+		DescriptorSystem::DestroySetLayout(rendererData, materialDescriptorSetLayout);
 	}
+	DescriptorSystem::DestroySetLayout(rendererData, uniformDescriptorSetLayout);
 }
 
-bool RasterizeNode::Record(VkCommandBuffer commandBuffer, int frameInFlight, const CommonFrameData& commonFrameData,
+bool RasterizeNode::Record(VkCommandBuffer commandBuffer, int frameInFlight, int imageIndex, const CommonFrameData& commonFrameData,
 	bool startRenderPass, bool endRenderPass)
 {
 	if (!configured)
@@ -244,7 +292,7 @@ bool RasterizeNode::Record(VkCommandBuffer commandBuffer, int frameInFlight, con
 		return false;
 	}
 
-	if (materialDescriptorSystems.empty())
+	if (drawBuffers.empty())
 	{
 		return false;
 	}
@@ -264,58 +312,122 @@ bool RasterizeNode::Record(VkCommandBuffer commandBuffer, int frameInFlight, con
 		renderPassBeginInfo.renderArea.extent.height = commonFrameData.surfaceData->height;
 		renderPassBeginInfo.clearValueCount = clearValueCount - (nodeOutputs.depthTarget ? 0 : 1);
 		renderPassBeginInfo.pClearValues = clearValues;
-		renderPassBeginInfo.framebuffer = framebuffers[frameInFlight];
+		renderPassBeginInfo.framebuffer = framebuffers[imageIndex];
+
+		vkCmdBeginRenderPass(commandBuffer, &renderPassBeginInfo, VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS);
+	}
+
+	ExecuteCommands(commandBuffer, frameInFlight, imageIndex);
 
-		vkCmdBeginRenderPass(commandBuffer, &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
+	if (endRenderPass)
+	{
+		vkCmdEndRenderPass(commandBuffer);
 	}
 
+	return true;
+}
+
+int RasterizeNode::GetRecordingChunkCount(const CommonFrameData& commonFrameData) const
+{
+	return commonFrameData.threadPool ? commonFrameData.threadPool->GetThreadCount() : 1;
+}
+
+void RasterizeNode::RecordCommands(VkCommandBuffer commandBuffer, int chunk, int frameInFlight, int imageIndex,
+	const CommonFrameData& commonFrameData, bool endRenderPass)
+{
+	// Dynamic state is not inherited from the primary command buffer.
+	VkViewport viewport;
+	viewport.x = 0;
+	viewport.y = 0;
+	viewport.width = (float)commonFrameData.surfaceData->width;
+	viewport.height = (float)commonFrameData.surfaceData->height;
+	viewport.minDepth = 0.f;
+	viewport.maxDepth = 1.f;
+	vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+
+	VkRect2D scissor;
+	scissor.offset = { 0, 0 };
+	scissor.extent = VkExtent2D{ (uint32_t)commonFrameData.surfaceData->width, (uint32_t)commonFrameData.surfaceData->height };
+	vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+
 	vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
+	RecordPushConstants(commandBuffer, frameInFlight);
 
-	for (int m = 0; m < materialDescriptorSystems.size(); ++m)
+	// The uniform set is shared by all materials.
+	VkDescriptorSet uniformSet = uniformDescriptorSystem.GetSet(frameInFlight);
+	if (uniformSet != VK_NULL_HANDLE)
 	{
-		const auto& drawBuffer = drawBuffers[m];
+		std::vector<uint32_t> dynamicOffsets(uniformDescriptorSystem.GetDynamicOffsetCount(),
+			commonFrameData.uniformRing->GetFrameOffset(frameInFlight));
+		vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 1,
+			1, &uniformSet, (uint32_t)dynamicOffsets.size(), dynamicOffsets.data());
+	}
+	// Materials only differ in the pushed index then.
+	if (bindless)
+	{
+		VkDescriptorSet bindlessSet = rendererData->bindlessSet.GetSet();
+		vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0,
+			1, &bindlessSet, 0, nullptr);
+	}
 
-		std::vector<VkDescriptorSet> descriptorSets;
-		descriptorSets.reserve(4);
-		if (materialDescriptorSystems[m]->GetSet(frameInFlight) != VK_NULL_HANDLE)
+	// Every chunk records an even share of the draw list (in material order).
+	int drawCount = 0;
+	for (int m = 0; m < drawBuffers.size(); ++m)
+	{
+		drawCount += (int)drawBuffers[m].size();
+	}
+	const int firstDraw = drawCount * chunk / commandBufferChunkCount;
+	const int lastDraw = drawCount * (chunk + 1) / commandBufferChunkCount;
+
+	// Draws sharing an arena keep its bindings and address their data by offsets.
+	BoundBuffer boundVertexBuffer;
+	BoundBuffer boundInstanceBuffer;
+	BoundBuffer boundIndexBuffer;
+
+	int materialFirstDraw = 0;
+	for (int m = 0; m < drawBuffers.size(); ++m)
+	{
+		const auto& drawBuffer = drawBuffers[m];
+		const int firstBuffer = std::max(firstDraw - materialFirstDraw, 0);
+		const int lastBuffer = std::min(lastDraw - materialFirstDraw, (int)drawBuffer.size());
+		materialFirstDraw += (int)drawBuffer.size();
+		if (firstBuffer >= lastBuffer)
 		{
-			descriptorSets.push_back(materialDescriptorSystems[m]->GetSet(frameInFlight));
+			continue;
 		}
-		if (uniformDescriptorSystem.GetSet(frameInFlight) != VK_NULL_HANDLE)
+
+		if (bindless)
 		{
-			descriptorSets.push_back(uniformDescriptorSystem.GetSet(frameInFlight));
+			RecordMaterialPushConstant(commandBuffer, m);
 		}
-
-		if (descriptorSets.size() > 0)
+		else
 		{
-			vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0,
-				(uint32_t)descriptorSets.size(), descriptorSets.data(), 0, nullptr);
+			VkDescriptorSet materialSet = materialDescriptorSystems[m]->GetSet(frameInFlight);
+			if (materialSet != VK_NULL_HANDLE)
+			{
+				vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0,
+					1, &materialSet, 0, nullptr);
+			}
 		}
 
-		// TODO: Instances.
-		for (int b = 0; b < drawBuffer.size(); ++b)
+		for (int b = firstBuffer; b < lastBuffer; ++b)
 		{
-			static VkDeviceSize offset = 0;
-			vkCmdBindVertexBuffers(commandBuffer, 0, 1, &drawBuffer[b].vertexBuffer->buffer.buffer, &offset);
-			vkCmdBindVertexBuffers(commandBuffer, 1, 1, &drawBuffer[b].instanceBuffer->buffer.buffer, &offset);
+			const uint32_t firstVertex = BindVertexBuffer(commandBuffer, 0, drawBuffer[b].vertexBuffer, vertexSize, boundVertexBuffer);
+			// Instance data is one model matrix per instance.
+			const uint32_t firstInstance = BindVertexBuffer(commandBuffer, 1, drawBuffer[b].instanceBuffer, 64, boundInstanceBuffer);
+			const uint32_t instanceCount = drawBuffer[b].instanceBuffer->dataSize / 64;
 			if (drawBuffer[b].indexBuffer)
 			{
-				vkCmdBindIndexBuffer(commandBuffer, drawBuffer[b].indexBuffer->buffer.buffer, offset, VK_INDEX_TYPE_UINT32);
-				vkCmdDrawIndexed(commandBuffer, drawBuffer[b].indexBuffer->dataSize / 4, drawBuffer[b].instanceBuffer->dataSize, 0, 0, 0);
+				const uint32_t firstIndex = BindIndexBuffer(commandBuffer, drawBuffer[b].indexBuffer, boundIndexBuffer);
+				vkCmdDrawIndexed(commandBuffer, drawBuffer[b].indexBuffer->dataSize / 4, instanceCount, firstIndex,
+					(int32_t)firstVertex, firstInstance);
 			}
 			else
 			{
-				vkCmdDraw(commandBuffer, drawBuffer[b].vertexBuffer->dataSize / vertexSize, drawBuffer[b].instanceBuffer->dataSize, 0, 0);
+				vkCmdDraw(commandBuffer, drawBuffer[b].vertexBuffer->dataSize / vertexSize, instanceCount, firstVertex, firstInstance);
 			}
 		}
 	}
-
-	if (endRenderPass)
-	{
-		vkCmdEndRenderPass(commandBuffer);
-	}
-
-	return true;
 }
 
 void RasterizeNode::Resize(const CommonFrameData& commonFrameData, const std::vector<NodeOutputs*>& nodeInputs)
@@ -408,7 +520,9 @@ void RasterizeNode::CreateSampleTarget(const CommonFrameData& commonFrameData, c
 
 void RasterizeNode::CreateFramebuffers(const CommonFrameData& commonFrameData)
 {
-	for (int f = 0; f < framesInFlightCount; ++f)
+	// Framebuffers are selected by the acquired swapchain image, not by the frame in flight.
+	framebuffers.resize(commonFrameData.swapchainImageCount);
+	for (int f = 0; f < framebuffers.size(); ++f)
 	{
 		std::vector<VkImageView> attachments;
 		if (useSwapchain)
@@ -13,7 +13,7 @@ public:
 		const CommonFrameData& commonFrameData, VkRenderPass renderPassReference, bool useSwapchain) override;
 	void Shutdown(const CommonFrameData& commonFrameData) override;
 	// TODO: Change for layer and common information.
-	bool Record(VkCommandBuffer commandBuffer, int frameInFlight, const CommonFrameData& commonFrameData,
+	bool Record(VkCommandBuffer commandBuffer, int frameInFlight, int imageIndex, const CommonFrameData& commonFrameData,
 		bool startRenderPass, bool endRenderPass) override;
 	void Resize(const CommonFrameData& commonFrameData, const std::vector<NodeOutputs*>& nodeInputs) override;
 
@@ -23,6 +23,12 @@ public:
 
 	void CreateFramebuffers(const CommonFrameData& commonFrameData);
 
+protected:
+	// Draw lists are split into one chunk per recording thread.
+	int GetRecordingChunkCount(const CommonFrameData& commonFrameData) const override;
+	void RecordCommands(VkCommandBuffer commandBuffer, int chunk, int frameInFlight, int imageIndex,
+		const CommonFrameData& commonFrameData, bool endRenderPass) override;
+
 private:
 	int vertexSize = 0;
 };
@@ -1,15 +1,90 @@
 #include "HawkEye/HawkEyeAPI.hpp"
+#include "RendererData.hpp"
+#include "Resources.hpp"
 #include <VulkanBackend/VulkanBackendAPI.hpp>
+#include <SoftwareCore/DefaultLogger.hpp>
+#include <algorithm>
+#include <stdexcept>
+#include <thread>
 
-static VulkanBackend::BackendData backendData{};
+static HawkEye::HRendererData_t rendererData{};
 
-HawkEye::HRendererData HawkEye::Initialize(const char* backendConfigFile)
+// Large enough for typical level loads to stream without waiting for the ring to drain.
+static const size_t defaultStagingCapacity = 64 * 1024 * 1024;
+// Recording is cheap compared to the memcpy into staging, so a couple of workers keep up with file loading.
+static const int defaultUploadThreadCount = 2;
+// Clamped to the device limits. Descriptor indexing only pays for the slots that are written.
+static const int bindlessTextureCapacity = 65536;
+static const int bindlessBufferCapacity = 65536;
+
+HawkEye::HRendererData HawkEye::Initialize(const char* backendConfigFile, const DeviceFeatures& enabledFeatures)
 {
-    backendData = VulkanBackend::Initialize(backendConfigFile);
-    return (HawkEye::HRendererData)&backendData;
+    rendererData.backendData = VulkanBackend::Initialize(backendConfigFile);
+
+    // All queue synchronization and resource lifetimes are tracked on timelines.
+    VkPhysicalDeviceTimelineSemaphoreFeatures timelineFeatures{};
+    timelineFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_TIMELINE_SEMAPHORE_FEATURES;
+    VkPhysicalDeviceFeatures2 features{};
+    features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+    features.pNext = &timelineFeatures;
+    vkGetPhysicalDeviceFeatures2(rendererData.backendData.physicalDevice, &features);
+    if (!enabledFeatures.timelineSemaphore || !timelineFeatures.timelineSemaphore)
+    {
+        VulkanBackend::Shutdown(rendererData.backendData);
+        CoreLogFatal(DefaultLogger, "Initialization: Timeline semaphores are not enabled in the backend configuration.");
+        throw std::runtime_error("Initialization: Timeline semaphores are not enabled in the backend configuration.");
+    }
+
+    rendererData.graphicsTimeline.Init(&rendererData.backendData, rendererData.backendData.generalQueues[0]);
+    // Uploads stay off the graphics queue, preferably on a dedicated transfer family.
+    if (!rendererData.backendData.transferQueues.empty())
+    {
+        rendererData.uploadFamilyIndex = rendererData.backendData.transferFamilyIndex;
+        rendererData.uploadTimeline.Init(&rendererData.backendData, rendererData.backendData.transferQueues[0]);
+    }
+    else
+    {
+        rendererData.uploadFamilyIndex = rendererData.backendData.generalFamilyIndex;
+        rendererData.uploadTimeline.Init(&rendererData.backendData, rendererData.backendData.generalQueues[1]);
+    }
+    rendererData.uploadManager.Init(&rendererData.backendData, &rendererData.uploadTimeline, rendererData.uploadFamilyIndex,
+        defaultStagingCapacity);
+    rendererData.uploadThreadPool.Init(defaultUploadThreadCount);
+    rendererData.textureThreadPool.Init(std::max((int)std::thread::hardware_concurrency(), 1));
+    rendererData.descriptorAllocator.Init(&rendererData.backendData);
+    rendererData.objectCache.Init(&rendererData.backendData, &rendererData.descriptorAllocator);
+    if (enabledFeatures.descriptorIndexing)
+    {
+        rendererData.bindlessSet.Init(&rendererData, bindlessTextureCapacity, bindlessBufferCapacity);
+    }
+
+    // The placeholder is bound without checking its upload, so it is waited for right away.
+    uint8_t placeholderPixel[4] = { 0, 0, 0, 0 };
+    rendererData.placeholderTexture = UploadTexture(&rendererData, placeholderPixel, sizeof(placeholderPixel), 1, 1,
+        TextureFormat::RGBA, ColorCompression::None, TextureCompression::None, false);
+    FlushUploads(&rendererData);
+    WaitForUpload(&rendererData, rendererData.placeholderTexture);
+    return &rendererData;
 }
 
 void HawkEye::Shutdown()
 {
-    VulkanBackend::Shutdown(backendData);
+    // Asynchronous uploads still being recorded would otherwise touch a destroyed upload manager.
+    rendererData.uploadThreadPool.Wait();
+    rendererData.uploadThreadPool.Shutdown();
+    rendererData.textureThreadPool.Shutdown();
+
+    vkDeviceWaitIdle(rendererData.backendData.logicalDevice);
+    ResourceUtils::CollectDeferredDeletions(&rendererData, true);
+    DeleteTexture(&rendererData, rendererData.placeholderTexture);
+
+    rendererData.uploadManager.Shutdown();
+    rendererData.descriptorWriter.Flush(rendererData.backendData.logicalDevice);
+    rendererData.bindlessSet.Shutdown();
+    rendererData.objectCache.Shutdown();
+    rendererData.descriptorAllocator.Shutdown();
+
+    rendererData.uploadTimeline.Shutdown();
+    rendererData.graphicsTimeline.Shutdown();
+    VulkanBackend::Shutdown(rendererData.backendData);
 }
@@ -0,0 +1,59 @@
+#include "LinearArena.hpp"
+#include <SoftwareCore/DefaultLogger.hpp>
+
+void LinearArena::Init(size_t capacity)
+{
+	memory.reset(capacity > 0 ? new uint8_t[capacity] : nullptr);
+	this->capacity = capacity;
+	offset = 0;
+	persistentOffset = 0;
+	++allocationCount;
+}
+
+void LinearArena::Shutdown()
+{
+	memory.reset();
+	capacity = 0;
+	offset = 0;
+	persistentOffset = 0;
+}
+
+void* LinearArena::Allocate(size_t size, size_t alignment)
+{
+	const uintptr_t base = (uintptr_t)memory.get();
+	const uintptr_t alignedAddress = (base + offset + alignment - 1) & ~(uintptr_t)(alignment - 1);
+	const size_t alignedOffset = (size_t)(alignedAddress - base);
+	if (alignedOffset + size > capacity)
+	{
+		CoreLogError(DefaultLogger, "Linear arena: Out of memory (%d of %d bytes used).", (int)offset, (int)capacity);
+		return nullptr;
+	}
+
+	offset = alignedOffset + size;
+	return memory.get() + alignedOffset;
+}
+
+void LinearArena::MarkPersistent()
+{
+	persistentOffset = offset;
+}
+
+void LinearArena::Reset()
+{
+	offset = persistentOffset;
+}
+
+size_t LinearArena::GetCapacity() const
+{
+	return capacity;
+}
+
+size_t LinearArena::GetUsedSize() const
+{
+	return offset;
+}
+
+uint64_t LinearArena::GetAllocationCount() const
+{
+	return allocationCount;
+}
@@ -0,0 +1,33 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+// Bump allocator over a single heap block. Allocations made before MarkPersistent() survive Reset(),
+// everything allocated after it is released at once by Reset().
+class LinearArena
+{
+public:
+	LinearArena() = default;
+	~LinearArena() = default;
+
+	void Init(size_t capacity);
+	void Shutdown();
+
+	// Returns nullptr if the arena is exhausted.
+	void* Allocate(size_t size, size_t alignment = alignof(std::max_align_t));
+	void MarkPersistent();
+	void Reset();
+
+	size_t GetCapacity() const;
+	size_t GetUsedSize() const;
+	// Heap allocations made by the arena (one per Init).
+	uint64_t GetAllocationCount() const;
+
+private:
+	std::unique_ptr<uint8_t[]> memory;
+	size_t capacity = 0;
+	size_t offset = 0;
+	size_t persistentOffset = 0;
+	uint64_t allocationCount = 0;
+};
@@ -0,0 +1,124 @@
+#include "MappedFile.hpp"
+#ifdef _WIN32
+#define NOMINMAX
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+MappedFile::~MappedFile()
+{
+	Close();
+}
+
+#ifdef _WIN32
+bool MappedFile::Open(const char* path)
+{
+	Close();
+
+	HANDLE file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+	if (file == INVALID_HANDLE_VALUE)
+	{
+		return false;
+	}
+	fileHandle = file;
+
+	LARGE_INTEGER fileSize;
+	if (!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart == 0)
+	{
+		Close();
+		return false;
+	}
+
+	mappingHandle = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	if (!mappingHandle)
+	{
+		Close();
+		return false;
+	}
+
+	data = (const uint8_t*)MapViewOfFile(mappingHandle, FILE_MAP_READ, 0, 0, 0);
+	if (!data)
+	{
+		Close();
+		return false;
+	}
+	size = (size_t)fileSize.QuadPart;
+	return true;
+}
+
+void MappedFile::Close()
+{
+	if (data)
+	{
+		UnmapViewOfFile(data);
+		data = nullptr;
+	}
+	if (mappingHandle)
+	{
+		CloseHandle(mappingHandle);
+		mappingHandle = nullptr;
+	}
+	if (fileHandle)
+	{
+		CloseHandle(fileHandle);
+		fileHandle = nullptr;
+	}
+	size = 0;
+}
+#else
+bool MappedFile::Open(const char* path)
+{
+	Close();
+
+	const int fileDescriptor = open(path, O_RDONLY);
+	if (fileDescriptor < 0)
+	{
+		return false;
+	}
+
+	struct stat fileStatus;
+	if (fstat(fileDescriptor, &fileStatus) != 0 || fileStatus.st_size == 0)
+	{
+		close(fileDescriptor);
+		return false;
+	}
+
+	// The mapping stays valid after the descriptor is closed.
+	void* mapping = mmap(nullptr, (size_t)fileStatus.st_size, PROT_READ, MAP_PRIVATE, fileDescriptor, 0);
+	close(fileDescriptor);
+	if (mapping == MAP_FAILED)
+	{
+		return false;
+	}
+	madvise(mapping, (size_t)fileStatus.st_size, MADV_SEQUENTIAL);
+
+	data = (const uint8_t*)mapping;
+	size = (size_t)fileStatus.st_size;
+	return true;
+}
+
+void MappedFile::Close()
+{
+	if (data)
+	{
+		munmap((void*)data, size);
+		data = nullptr;
+	}
+	size = 0;
+}
+#endif
+
+const uint8_t* MappedFile::GetData() const
+{
+	return data;
+}
+
+size_t MappedFile::GetSize() const
+{
+	return size;
+}
@@ -0,0 +1,229 @@
+#include "ObjectCache.hpp"
+#include "DescriptorAllocator.hpp"
+#include <VulkanBackend/ErrorCheck.hpp>
+#include <cstring>
+
+static uint32_t FloatBits(float value)
+{
+	uint32_t bits;
+	memcpy(&bits, &value, sizeof(bits));
+	return bits;
+}
+
+static void AppendAttachmentReferences(std::vector<uint32_t>& signature, const VkAttachmentReference* references, uint32_t count)
+{
+	signature.push_back(references ? count : 0);
+	for (uint32_t r = 0; references && r < count; ++r)
+	{
+		signature.push_back(references[r].attachment);
+		signature.push_back((uint32_t)references[r].layout);
+	}
+}
+
+size_t ObjectCache::SignatureHash::operator()(const Signature& signature) const
+{
+	// FNV-1a over the words.
+	uint64_t hash = 14695981039346656037ull;
+	for (uint32_t word : signature)
+	{
+		hash ^= word;
+		hash *= 1099511628211ull;
+	}
+	return (size_t)hash;
+}
+
+void ObjectCache::Init(VulkanBackend::BackendData* backendData, DescriptorAllocator* descriptorAllocator)
+{
+	this->backendData = backendData;
+	this->descriptorAllocator = descriptorAllocator;
+}
+
+void ObjectCache::Shutdown()
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	for (auto& setLayout : setLayouts.entries)
+	{
+		descriptorAllocator->ReleaseLayout(setLayout.second.object);
+		VulkanBackend::DestroyDescriptorSetLayout(*backendData, setLayout.second.object);
+	}
+	for (auto& renderPass : renderPasses.entries)
+	{
+		VulkanBackend::DestroyRenderPass(*backendData, renderPass.second.object);
+	}
+	for (auto& sampler : samplers.entries)
+	{
+		VulkanBackend::DestroyImageSampler(*backendData, sampler.second.object);
+	}
+	setLayouts.entries.clear();
+	setLayouts.signatures.clear();
+	renderPasses.entries.clear();
+	renderPasses.signatures.clear();
+	samplers.entries.clear();
+	samplers.signatures.clear();
+}
+
+template<typename T>
+T ObjectCache::Find(ObjectTable<T>& table, const Signature& signature)
+{
+	auto entry = table.entries.find(signature);
+	if (entry == table.entries.end())
+	{
+		return VK_NULL_HANDLE;
+	}
+	++entry->second.referenceCount;
+	return entry->second.object;
+}
+
+template<typename T>
+void ObjectCache::Insert(ObjectTable<T>& table, const Signature& signature, T object)
+{
+	table.entries[signature] = { object, 1 };
+	table.signatures[object] = signature;
+}
+
+template<typename T>
+bool ObjectCache::Release(ObjectTable<T>& table, T object)
+{
+	auto signature = table.signatures.find(object);
+	if (signature == table.signatures.end())
+	{
+		return false;
+	}
+
+	auto entry = table.entries.find(signature->second);
+	if (--entry->second.referenceCount > 0)
+	{
+		return false;
+	}
+	table.entries.erase(entry);
+	table.signatures.erase(signature);
+	return true;
+}
+
+VkDescriptorSetLayout ObjectCache::AcquireSetLayout(const std::vector<VkDescriptorSetLayoutBinding>& layoutBindings)
+{
+	Signature signature;
+	for (int b = 0; b < layoutBindings.size(); ++b)
+	{
+		signature.push_back(layoutBindings[b].binding);
+		signature.push_back((uint32_t)layoutBindings[b].descriptorType);
+		signature.push_back(layoutBindings[b].descriptorCount);
+		signature.push_back(layoutBindings[b].stageFlags);
+	}
+
+	std::lock_guard<std::mutex> lock(mutex);
+	VkDescriptorSetLayout setLayout = Find(setLayouts, signature);
+	if (setLayout == VK_NULL_HANDLE)
+	{
+		setLayout = VulkanBackend::CreateDescriptorSetLayout(*backendData, layoutBindings);
+		Insert(setLayouts, signature, setLayout);
+	}
+	return setLayout;
+}
+
+void ObjectCache::ReleaseSetLayout(VkDescriptorSetLayout setLayout)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	if (Release(setLayouts, setLayout))
+	{
+		// A later layout may get the same handle, so the allocator must not keep sets under it.
+		descriptorAllocator->ReleaseLayout(setLayout);
+		VulkanBackend::DestroyDescriptorSetLayout(*backendData, setLayout);
+	}
+}
+
+VkRenderPass ObjectCache::AcquireRenderPass(const VkRenderPassCreateInfo& renderPassInfo)
+{
+	Signature signature;
+	signature.push_back(renderPassInfo.flags);
+	signature.push_back(renderPassInfo.attachmentCount);
+	for (uint32_t a = 0; a < renderPassInfo.attachmentCount; ++a)
+	{
+		const VkAttachmentDescription& attachment = renderPassInfo.pAttachments[a];
+		signature.push_back(attachment.flags);
+		signature.push_back((uint32_t)attachment.format);
+		signature.push_back((uint32_t)attachment.samples);
+		signature.push_back((uint32_t)attachment.loadOp);
+		signature.push_back((uint32_t)attachment.storeOp);
+		signature.push_back((uint32_t)attachment.stencilLoadOp);
+		signature.push_back((uint32_t)attachment.stencilStoreOp);
+		signature.push_back((uint32_t)attachment.initialLayout);
+		signature.push_back((uint32_t)attachment.finalLayout);
+	}
+	signature.push_back(renderPassInfo.subpassCount);
+	for (uint32_t s = 0; s < renderPassInfo.subpassCount; ++s)
+	{
+		const VkSubpassDescription& subpass = renderPassInfo.pSubpasses[s];
+		signature.push_back(subpass.flags);
+		signature.push_back((uint32_t)subpass.pipelineBindPoint);
+		AppendAttachmentReferences(signature, subpass.pInputAttachments, subpass.inputAttachmentCount);
+		AppendAttachmentReferences(signature, subpass.pColorAttachments, subpass.colorAttachmentCount);
+		// Resolve attachments are optional, but have the color attachments' count if present.
+		AppendAttachmentReferences(signature, subpass.pResolveAttachments, subpass.colorAttachmentCount);
+		AppendAttachmentReferences(signature, subpass.pDepthStencilAttachment, 1);
+		signature.push_back(subpass.preserveAttachmentCount);
+		signature.insert(signature.end(), subpass.pPreserveAttachments,
+			subpass.pPreserveAttachments + subpass.preserveAttachmentCount);
+	}
+	signature.push_back(renderPassInfo.dependencyCount);
+	for (uint32_t d = 0; d < renderPassInfo.dependencyCount; ++d)
+	{
+		const VkSubpassDependency& dependency = renderPassInfo.pDependencies[d];
+		signature.push_back(dependency.srcSubpass);
+		signature.push_back(dependency.dstSubpass);
+		signature.push_back(dependency.srcStageMask);
+		signature.push_back(dependency.dstStageMask);
+		signature.push_back(dependency.srcAccessMask);
+		signature.push_back(dependency.dstAccessMask);
+		signature.push_back(dependency.dependencyFlags);
+	}
+
+	std::lock_guard<std::mutex> lock(mutex);
+	VkRenderPass renderPass = Find(renderPasses, signature);
+	if (renderPass == VK_NULL_HANDLE)
+	{
+		VulkanCheck(vkCreateRenderPass(backendData->logicalDevice, &renderPassInfo, nullptr, &renderPass));
+		Insert(renderPasses, signature, renderPass);
+	}
+	return renderPass;
+}
+
+void ObjectCache::ReleaseRenderPass(VkRenderPass renderPass)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	if (Release(renderPasses, renderPass))
+	{
+		VulkanBackend::DestroyRenderPass(*backendData, renderPass);
+	}
+}
+
+VkSampler ObjectCache::AcquireSampler(VkFilter minFilter, VkFilter magFilter, VkBorderColor borderColor,
+	VkSamplerAddressMode addressModeU, VkSamplerAddressMode addressModeV, VkSamplerAddressMode addressModeW,
+	float minLod, float maxLod)
+{
+	const Signature signature =
+	{
+		(uint32_t)minFilter, (uint32_t)magFilter, (uint32_t)borderColor,
+		(uint32_t)addressModeU, (uint32_t)addressModeV, (uint32_t)addressModeW,
+		FloatBits(minLod), FloatBits(maxLod)
+	};
+
+	std::lock_guard<std::mutex> lock(mutex);
+	VkSampler sampler = Find(samplers, signature);
+	if (sampler == VK_NULL_HANDLE)
+	{
+		sampler = VulkanBackend::CreateImageSampler(*backendData, minFilter, magFilter, borderColor,
+			addressModeU, addressModeV, addressModeW, minLod, maxLod);
+		Insert(samplers, signature, sampler);
+	}
+	return sampler;
+}
+
+void ObjectCache::ReleaseSampler(VkSampler sampler)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	if (Release(samplers, sampler))
+	{
+		VulkanBackend::DestroyImageSampler(*backendData, sampler);
+	}
+}
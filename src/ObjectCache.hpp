@@ -0,0 +1,71 @@
+#pragma once
+#include <VulkanBackend/VulkanBackendAPI.hpp>
+#include <vulkan/vulkan.hpp>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+class DescriptorAllocator;
+
+// Descriptor set layouts, render passes and samplers shared by all nodes and pipelines of the renderer.
+// Objects are looked up by their content and destroyed when the last reference is released.
+class ObjectCache
+{
+public:
+	ObjectCache() = default;
+	~ObjectCache() = default;
+
+	// The sets the descriptor allocator keeps for a layout are freed right before the layout is destroyed.
+	void Init(VulkanBackend::BackendData* backendData, DescriptorAllocator* descriptorAllocator);
+	// Destroys the objects that are still referenced.
+	void Shutdown();
+
+	// Every acquisition has to be matched by a release of the returned object.
+	VkDescriptorSetLayout AcquireSetLayout(const std::vector<VkDescriptorSetLayoutBinding>& layoutBindings);
+	void ReleaseSetLayout(VkDescriptorSetLayout setLayout);
+	// The create info may not have a pNext chain.
+	VkRenderPass AcquireRenderPass(const VkRenderPassCreateInfo& renderPassInfo);
+	void ReleaseRenderPass(VkRenderPass renderPass);
+	// Same parameters as VulkanBackend::CreateImageSampler.
+	VkSampler AcquireSampler(VkFilter minFilter, VkFilter magFilter, VkBorderColor borderColor,
+		VkSamplerAddressMode addressModeU, VkSamplerAddressMode addressModeV, VkSamplerAddressMode addressModeW,
+		float minLod, float maxLod);
+	void ReleaseSampler(VkSampler sampler);
+
+private:
+	// Create info flattened into words, compared as a whole so that hash collisions cannot mix objects up.
+	typedef std::vector<uint32_t> Signature;
+	struct SignatureHash
+	{
+		size_t operator()(const Signature& signature) const;
+	};
+
+	template<typename T>
+	struct ObjectTable
+	{
+		struct Entry
+		{
+			T object;
+			int referenceCount;
+		};
+		std::unordered_map<Signature, Entry, SignatureHash> entries;
+		// The signature of each object, to find its entry on release.
+		std::unordered_map<T, Signature> signatures;
+	};
+
+	// Adds a reference to the cached object, returns VK_NULL_HANDLE if there is none.
+	template<typename T>
+	T Find(ObjectTable<T>& table, const Signature& signature);
+	template<typename T>
+	void Insert(ObjectTable<T>& table, const Signature& signature, T object);
+	// Returns true if the last reference was released, the caller destroys the object then.
+	template<typename T>
+	bool Release(ObjectTable<T>& table, T object);
+
+	VulkanBackend::BackendData* backendData = nullptr;
+	DescriptorAllocator* descriptorAllocator = nullptr;
+	ObjectTable<VkDescriptorSetLayout> setLayouts;
+	ObjectTable<VkRenderPass> renderPasses;
+	ObjectTable<VkSampler> samplers;
+	std::mutex mutex;
+};
@@ -1,5 +1,6 @@
 #include "Pipeline.hpp"
 #include "Resources.hpp"
+#include "RendererData.hpp"
 #include "Descriptors.hpp"
 #include "Commands.hpp"
 #include "Framebuffer.hpp"
@@ -8,6 +9,7 @@
 #include <VulkanShaderCompiler/VulkanShaderCompilerAPI.hpp>
 #include <SoftwareCore/Filesystem.hpp>
 #include <yaml-cpp/yaml.h>
+#include <algorithm>
 #include <memory>
 #include <chrono>
 
@@ -24,12 +26,172 @@ bool HawkEye::Pipeline::Configured() const
 	return p_->configured;
 }
 
+const int defaultFramesInFlightCount = 2;
+
+static void AllocateFrameCommandBuffers(const CommonFrameData& commonFrameData, FrameData& frameData)
+{
+	std::vector<VkCommandBuffer> commandBuffers(commonFrameData.swapchainImageCount);
+
+	VulkanBackend::AllocateCommandBuffers(*commonFrameData.backendData, commonFrameData.commandPool, commandBuffers.data(),
+		(uint32_t)commandBuffers.size());
+
+	frameData.commandBuffers.resize(commandBuffers.size());
+	for (int c = 0; c < commandBuffers.size(); ++c)
+	{
+		frameData.commandBuffers[c].commandBuffer = commandBuffers[c];
+		frameData.commandBuffers[c].dirty = true;
+	}
+
+	frameData.prologueCommandBuffer = VulkanBackend::AllocateCommandBuffer(*commonFrameData.backendData,
+		commonFrameData.commandPool);
+}
+
+static void FreeFrameCommandBuffers(const CommonFrameData& commonFrameData, FrameData& frameData)
+{
+	for (int c = 0; c < frameData.commandBuffers.size(); ++c)
+	{
+		VulkanBackend::FreeCommandBuffer(*commonFrameData.backendData, commonFrameData.commandPool,
+			frameData.commandBuffers[c].commandBuffer);
+	}
+	frameData.commandBuffers.clear();
+
+	VulkanBackend::FreeCommandBuffer(*commonFrameData.backendData, commonFrameData.commandPool, frameData.prologueCommandBuffer);
+	frameData.prologueCommandBuffer = VK_NULL_HANDLE;
+}
+
+static void CreateRenderFinishedSemaphores(const CommonFrameData& commonFrameData, std::vector<VkSemaphore>& semaphores)
+{
+	semaphores.resize(commonFrameData.swapchainImageCount);
+	for (int i = 0; i < semaphores.size(); ++i)
+	{
+		semaphores[i] = VulkanBackend::CreateSemaphore(*commonFrameData.backendData);
+	}
+}
+
+static void DestroyRenderFinishedSemaphores(const CommonFrameData& commonFrameData, std::vector<VkSemaphore>& semaphores)
+{
+	for (int i = 0; i < semaphores.size(); ++i)
+	{
+		VulkanBackend::DestroySemaphore(*commonFrameData.backendData, semaphores[i]);
+	}
+	semaphores.clear();
+}
+
+static void MarkCommandBuffersDirty(std::vector<FrameData>& frames)
+{
+	for (int f = 0; f < frames.size(); ++f)
+	{
+		for (int c = 0; c < frames[f].commandBuffers.size(); ++c)
+		{
+			frames[f].commandBuffers[c].dirty = true;
+		}
+	}
+}
+
+static void ConfigureUniformKeys(HawkEye::Pipeline::Private* p)
+{
+	std::vector<FrameGraphNode*> nodes;
+	p->frameGraph.GetNodes(nodes);
+
+	p->uniformKeys.clear();
+	p->uniformKeyIndices.clear();
+	for (int n = 0; n < nodes.size(); ++n)
+	{
+		const std::vector<UniformData>& uniforms = nodes[n]->GetUniforms();
+		for (int u = 0; u < uniforms.size(); ++u)
+		{
+			p->uniformKeyIndices[nodes[n]->GetName()][uniforms[u].name] = (int)p->uniformKeys.size();
+			p->uniformKeys.push_back({ nodes[n]->GetName(), uniforms[u].name, nodes[n], u, uniforms[u].type, uniforms[u].size, false });
+		}
+		const std::vector<PushConstantData>& pushConstants = nodes[n]->GetPushConstants();
+		for (int c = 0; c < pushConstants.size(); ++c)
+		{
+			p->uniformKeyIndices[nodes[n]->GetName()][pushConstants[c].name] = (int)p->uniformKeys.size();
+			p->uniformKeys.push_back({ nodes[n]->GetName(), pushConstants[c].name, nodes[n], c, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
+				pushConstants[c].size, true });
+		}
+	}
+
+	// Every key is queued at most once per frame, so neither the queues nor the scratch copies can overflow.
+	const int keyCount = (int)p->uniformKeys.size();
+	size_t uniformDataSize = 0;
+	for (int k = 0; k < keyCount; ++k)
+	{
+		uniformDataSize += p->uniformKeys[k].size + alignof(std::max_align_t);
+	}
+	const size_t arenaCapacity = keyCount * sizeof(PendingUniform) + alignof(PendingUniform) + 2 * uniformDataSize;
+
+	p->uniformUpdateQueues.clear();
+	for (int f = 0; f < p->commonFrameData.framesInFlightCount; ++f)
+	{
+		FrameData& frameData = p->frames[f];
+		frameData.updateArena.Init(arenaCapacity);
+		frameData.pendingUniforms = (PendingUniform*)frameData.updateArena.Allocate(keyCount * sizeof(PendingUniform),
+			alignof(PendingUniform));
+		for (int k = 0; k < keyCount; ++k)
+		{
+			PendingUniform* pendingUniform = new (&frameData.pendingUniforms[k]) PendingUniform;
+			if (p->uniformKeys[k].type == VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER)
+			{
+				pendingUniform->data = (uint8_t*)frameData.updateArena.Allocate(p->uniformKeys[k].size);
+			}
+		}
+		frameData.updateArena.MarkPersistent();
+		// Every uniform is copied at most once per frame.
+		frameData.uniformCopies.reserve(keyCount);
+
+		// A key is queued at most once while pending, but it can be queued again while its previous cell is still
+		// being consumed, so it may hold two cells.
+		p->uniformUpdateQueues.push_back(std::make_unique<UpdateQueue<int>>());
+		p->uniformUpdateQueues[f]->Init(2 * keyCount);
+	}
+}
+
+static bool CheckUniformHandle(HawkEye::Pipeline::Private* p, HawkEye::HUniform uniform, VkDescriptorType type)
+{
+	if (uniform < 0 || uniform >= p->uniformKeys.size())
+	{
+		CoreLogError(DefaultLogger, "Uniform update: Invalid uniform handle %d.", uniform);
+		return false;
+	}
+	if (p->uniformKeys[uniform].type != type)
+	{
+		CoreLogError(DefaultLogger, "Uniform update: Uniform \'%s\' of node \'%s\' is of a different type.",
+			p->uniformKeys[uniform].name.c_str(), p->uniformKeys[uniform].nodeName.c_str());
+		return false;
+	}
+	return true;
+}
+
+template<typename Write>
+static void WritePendingUniform(HawkEye::Pipeline::Private* p, int frameInFlight, int key, Write&& write)
+{
+	PendingUniform& pendingUniform = p->frames[frameInFlight].pendingUniforms[key];
+	while (pendingUniform.lock.test_and_set(std::memory_order_acquire)) {}
+
+	write(pendingUniform);
+	const bool alreadyPending = pendingUniform.pending;
+	pendingUniform.pending = true;
+
+	pendingUniform.lock.clear(std::memory_order_release);
+
+	if (!alreadyPending && !p->uniformUpdateQueues[frameInFlight]->Push([key](int& queuedKey) { queuedKey = key; }))
+	{
+		// A key left pending without being queued would never be updated again.
+		while (pendingUniform.lock.test_and_set(std::memory_order_acquire)) {}
+		pendingUniform.pending = false;
+		pendingUniform.lock.clear(std::memory_order_release);
+		CoreLogError(DefaultLogger, "Uniform update: Update queue of uniform \'%s\' is full - skipping.",
+			p->uniformKeys[key].name.c_str());
+	}
+}
+
 void HawkEye::Pipeline::Configure(HRendererData rendererData, const char* configFile, int width, int height,
 	void* windowHandle, void* windowConnection)
 {
 	YAML::Node configData = YAML::LoadFile(configFile);
 
-	p_->commonFrameData.backendData = (VulkanBackend::BackendData*)rendererData;
+	p_->commonFrameData.backendData = &rendererData->backendData;
 	const VulkanBackend::BackendData& backendData = *p_->commonFrameData.backendData;
 	p_->commonFrameData.rendererData = rendererData;
 
@@ -38,6 +200,39 @@ void HawkEye::Pipeline::Configure(HRendererData rendererData, const char* config
 	surfaceData.width = width;
 	surfaceData.height = height;
 
+	p_->commonFrameData.framesInFlightCount = defaultFramesInFlightCount;
+	if (configData["frames-in-flight"])
+	{
+		int framesInFlightCount = configData["frames-in-flight"].as<int>();
+		if (framesInFlightCount < 1)
+		{
+			CoreLogError(DefaultLogger, "Configuration: \'frames-in-flight\' must be at least 1 - defaulting to %d.",
+				defaultFramesInFlightCount);
+		}
+		else
+		{
+			p_->commonFrameData.framesInFlightCount = framesInFlightCount;
+		}
+	}
+
+	// Node command buffers are recorded on the calling thread unless recording threads are requested.
+	p_->commonFrameData.threadPool = nullptr;
+	if (configData["recording-threads"])
+	{
+		int recordingThreadCount = configData["recording-threads"].as<int>();
+		if (recordingThreadCount < 0)
+		{
+			CoreLogError(DefaultLogger, "Configuration: \'recording-threads\' must not be negative - recording serially.");
+		}
+		else if (recordingThreadCount > 0)
+		{
+			p_->recordingThreadPool.Init(recordingThreadCount);
+			p_->commonFrameData.threadPool = &p_->recordingThreadPool;
+		}
+	}
+
+	p_->commonFrameData.swapchainImageCount = 1;
+
 	if (windowHandle)
 	{
 		VulkanBackend::CreateSurface(backendData, surfaceData, windowHandle, windowConnection);
@@ -47,7 +242,6 @@ void HawkEye::Pipeline::Configure(HRendererData rendererData, const char* config
 		VulkanBackend::GetSurfaceExtent(backendData, surfaceData);
 		VulkanBackend::GetPresentMode(backendData, surfaceData);
 		VulkanBackend::GetSwapchainImageCount(surfaceData);
-		p_->commonFrameData.framesInFlightCount = surfaceData.swapchainImageCount;
 
 		VulkanBackend::FilterPresentQueues(backendData, surfaceData);
 
@@ -59,20 +253,22 @@ void HawkEye::Pipeline::Configure(HRendererData rendererData, const char* config
 			VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_STORAGE_BIT);
 
 		VulkanBackend::GetSwapchainImages(backendData, p_->commonFrameData.swapchain, p_->commonFrameData.swapchainImages);
+		// The driver may create more images than requested.
+		p_->commonFrameData.swapchainImageCount = (int)p_->commonFrameData.swapchainImages.size();
 
-		p_->commonFrameData.swapchainImageViews.resize(p_->commonFrameData.framesInFlightCount);
+		p_->commonFrameData.swapchainImageViews.resize(p_->commonFrameData.swapchainImageCount);
 		VkImageSubresourceRange subresourceRange{};
 		subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
 		subresourceRange.levelCount = 1;
 		subresourceRange.layerCount = 1;
-		for (int i = 0; i < p_->commonFrameData.framesInFlightCount; ++i)
+		for (int i = 0; i < p_->commonFrameData.swapchainImageCount; ++i)
 		{
 			p_->commonFrameData.swapchainImageViews[i] = VulkanBackend::CreateImageView2D(backendData, p_->commonFrameData.swapchainImages[i],
 				surfaceData.surfaceFormat.format, subresourceRange);
 		}
 	}
 
-	p_->commonFrameData.targetSampler = VulkanBackend::CreateImageSampler(backendData, VK_FILTER_LINEAR, VK_FILTER_LINEAR,
+	p_->commonFrameData.targetSampler = rendererData->objectCache.AcquireSampler(VK_FILTER_LINEAR, VK_FILTER_LINEAR,
 		VK_BORDER_COLOR_INT_TRANSPARENT_BLACK, VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE, VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE,
 		VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE, 0.f, 1);
 
@@ -81,32 +277,32 @@ void HawkEye::Pipeline::Configure(HRendererData rendererData, const char* config
 
 	p_->commonFrameData.graphicsQueue = backendData.generalQueues[0];
 
-	p_->graphicsSemaphore = VulkanBackend::CreateSemaphore(backendData);
-	p_->presentSemaphore = VulkanBackend::CreateSemaphore(backendData);
-	for (int v = 0; v < p_->commonFrameData.framesInFlightCount; ++v)
-	{
-		p_->frameFences.push_back(VulkanBackend::CreateFence(backendData, VK_FENCE_CREATE_SIGNALED_BIT));
-	}
-
 	p_->commonFrameData.commandPool = VulkanBackend::CreateCommandPool(backendData, backendData.generalFamilyIndex,
 		VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT);
 
-	std::vector<VkCommandBuffer> commandBuffers(p_->commonFrameData.framesInFlightCount);
-
-	VulkanBackend::AllocateCommandBuffers(backendData, p_->commonFrameData.commandPool, commandBuffers.data(),
-		(uint32_t)p_->commonFrameData.framesInFlightCount);
-
-	p_->commonFrameData.commandBuffers.resize(p_->commonFrameData.framesInFlightCount);
-	for (int c = 0; c < p_->commonFrameData.framesInFlightCount; ++c)
+	p_->frames.resize(p_->commonFrameData.framesInFlightCount);
+	for (int f = 0; f < p_->commonFrameData.framesInFlightCount; ++f)
 	{
-		p_->commonFrameData.commandBuffers[c].commandBuffer = commandBuffers[c];
+		p_->frames[f].imageAcquiredSemaphore = VulkanBackend::CreateSemaphore(backendData);
+		p_->frames[f].submitValue = 0;
+		AllocateFrameCommandBuffers(p_->commonFrameData, p_->frames[f]);
 	}
+	CreateRenderFinishedSemaphores(p_->commonFrameData, p_->renderFinishedSemaphores);
+	p_->currentFrameInFlight = 0;
 
+	// Nodes reserve their host-visible uniforms in the ring while being configured.
+	p_->commonFrameData.uniformRing = &p_->uniformRing;
 	p_->frameGraph.Configure(configData["nodes"], p_->commonFrameData);
 
-	p_->textureUpdateData.resize(p_->commonFrameData.framesInFlightCount);
-	p_->bufferUpdateData.resize(p_->commonFrameData.framesInFlightCount);
-	p_->preallocatedUpdateData.resize(p_->commonFrameData.framesInFlightCount);
+	p_->uniformRing.Init(p_->commonFrameData.backendData, p_->commonFrameData.framesInFlightCount);
+	std::vector<FrameGraphNode*> nodes;
+	p_->frameGraph.GetNodes(nodes);
+	for (int n = 0; n < nodes.size(); ++n)
+	{
+		nodes[n]->WriteRingDescriptors();
+	}
+
+	ConfigureUniformKeys(p_);
 
 	p_->configured = true;
 
@@ -123,14 +319,16 @@ void HawkEye::Pipeline::Shutdown()
 
 		// TODO: Detach the frame graph from the pipeline.
 		p_->frameGraph.Shutdown(p_->commonFrameData);
+		p_->uniformRing.Shutdown();
+		p_->recordingThreadPool.Shutdown();
 
 		VulkanBackend::DestroyPipelineCache(backendData, p_->commonFrameData.pipelineCache);
 
-		VulkanBackend::DestroyImageSampler(backendData, p_->commonFrameData.targetSampler);
+		p_->commonFrameData.rendererData->objectCache.ReleaseSampler(p_->commonFrameData.targetSampler);
 
 		if (p_->commonFrameData.swapchain)
 		{
-			for (int i = 0; i < p_->commonFrameData.framesInFlightCount; ++i)
+			for (int i = 0; i < p_->commonFrameData.swapchainImageViews.size(); ++i)
 			{
 				VulkanBackend::DestroyImageView(backendData, p_->commonFrameData.swapchainImageViews[i]);
 			}
@@ -140,30 +338,22 @@ void HawkEye::Pipeline::Shutdown()
 			VulkanBackend::DestroySurface(backendData, p_->commonFrameData.surfaceData->surface);
 		}
 
-		VulkanBackend::DestroySemaphore(backendData, p_->graphicsSemaphore);
-		VulkanBackend::DestroySemaphore(backendData, p_->presentSemaphore);
-		for (int f = 0; f < p_->frameFences.size(); ++f)
+		for (int f = 0; f < p_->frames.size(); ++f)
 		{
-			VulkanBackend::DestroyFence(backendData, p_->frameFences[f]);
+			VulkanBackend::DestroySemaphore(backendData, p_->frames[f].imageAcquiredSemaphore);
+			FreeFrameCommandBuffers(p_->commonFrameData, p_->frames[f]);
 		}
+		p_->frames.clear();
+		DestroyRenderFinishedSemaphores(p_->commonFrameData, p_->renderFinishedSemaphores);
 
-		for (int c = 0; c < p_->commonFrameData.framesInFlightCount; ++c)
-		{
-			VulkanBackend::FreeCommandBuffer(backendData, p_->commonFrameData.commandPool,
-				p_->commonFrameData.commandBuffers[c].commandBuffer);
-		}
 		VulkanBackend::DestroyCommandPool(backendData, p_->commonFrameData.commandPool);
 	}
 }
 
 void HawkEye::Pipeline::UseBuffers(const std::string& nodeName, DrawBuffer* drawBuffers, int bufferCount)
 {
+	// The node marks its own command buffers dirty, the primary ones follow in DrawFrame.
 	p_->frameGraph.UseBuffers(nodeName, drawBuffers, bufferCount);
-
-	for (int c = 0; c < p_->commonFrameData.framesInFlightCount; ++c)
-	{
-		p_->commonFrameData.commandBuffers[c].dirty = true;
-	}
 }
 
 void HawkEye::Pipeline::DrawFrame()
@@ -175,51 +365,90 @@ void HawkEye::Pipeline::DrawFrame()
 
 	const VulkanBackend::BackendData& backendData = *p_->commonFrameData.backendData;
 	VkDevice device = backendData.logicalDevice;
+	HRendererData rendererData = p_->commonFrameData.rendererData;
+
+	const int frameInFlight = p_->currentFrameInFlight;
+	FrameData& frameData = p_->frames[frameInFlight];
+
+	// Only wait for the frame that last used this ring entry, not for the one that last used the acquired image.
+	rendererData->graphicsTimeline.Wait(frameData.submitValue);
+	frameData.updateArena.Reset();
+	frameData.uniformCopies.clear();
+	ResourceUtils::CollectDeferredDeletions(rendererData, false);
 
 	uint32_t currentImageIndex = UINT32_MAX;
-	VkResult result = vkAcquireNextImageKHR(device, p_->commonFrameData.swapchain, UINT64_MAX, p_->presentSemaphore,
+	VkResult result = vkAcquireNextImageKHR(device, p_->commonFrameData.swapchain, UINT64_MAX, frameData.imageAcquiredSemaphore,
 		VK_NULL_HANDLE, &currentImageIndex);
 	
-	// Recreate the swapchain if it's no longer compatible with the surface (OUT_OF_DATE) or no longer optimal for presentation (SUBOPTIMAL)
-	if ((result == VK_ERROR_OUT_OF_DATE_KHR) || (result == VK_SUBOPTIMAL_KHR))
+	// Recreate the swapchain if it's no longer compatible with the surface (OUT_OF_DATE).
+	if (result == VK_ERROR_OUT_OF_DATE_KHR)
 	{
 		CoreLogWarn(DefaultLogger, "Pipeline: Should resize.");
 		return;
 	}
-	VulkanCheck(result);
+	// The image was acquired (and the semaphore will be signaled) even if the swapchain is SUBOPTIMAL.
+	if (result != VK_SUBOPTIMAL_KHR)
+	{
+		VulkanCheck(result);
+	}
 	if (currentImageIndex == UINT32_MAX)
 	{
 		CoreLogFatal(DefaultLogger, "Error: Lost the swapchain.");
 		throw std::runtime_error("Error: Lost the swapchain.");
 	}
 
-	vkWaitForFences(device, 1, &p_->frameFences[currentImageIndex], VK_TRUE, UINT64_MAX);
-	vkResetFences(device, 1, &p_->frameFences[currentImageIndex]);
-
-	if (p_->commonFrameData.commandBuffers[currentImageIndex].dirty)
+	// Uniforms go first, so that the descriptor writes flushed below include their updates.
+	UpdateUniforms(frameInFlight);
+	// Resources bound while they were still being uploaded replace their placeholders.
+	p_->frameGraph.ApplyPendingDescriptorUpdates(frameInFlight);
+	p_->frameGraph.CollectRetiredMaterials();
+	rendererData->bindlessSet.ApplyPendingWrites();
+	// Texture swaps, new materials and the like in a single call.
+	rendererData->descriptorWriter.Flush(device);
+
+	CommandBufferData& commandBufferData = frameData.commandBuffers[currentImageIndex];
+	if (commandBufferData.dirty || p_->frameGraph.NeedsRecording(frameInFlight, (int)currentImageIndex))
 	{
-		VulkanBackend::ResetCommandBuffer(p_->commonFrameData.commandBuffers[currentImageIndex].commandBuffer);
-		p_->commonFrameData.commandBuffers[currentImageIndex].dirty = false;
-		p_->frameGraph.Record(p_->commonFrameData.commandBuffers[currentImageIndex].commandBuffer, currentImageIndex, p_->commonFrameData);
+		VulkanBackend::ResetCommandBuffer(commandBufferData.commandBuffer);
+		commandBufferData.dirty = false;
+		p_->frameGraph.Record(commandBufferData.commandBuffer, frameInFlight, (int)currentImageIndex, p_->commonFrameData);
 	}
 
-	auto millisecondsSinceEpoch = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
-	unsigned int concatTime = (unsigned int)(millisecondsSinceEpoch);
-	
-	UpdateUniforms(currentImageIndex);
+	// Textures released by the transfer family are acquired before their first use,
+	// device-local uniforms are updated without a submit of their own.
+	VkCommandBuffer commandBuffers[] = { frameData.prologueCommandBuffer, commandBufferData.commandBuffer };
+	VulkanBackend::ResetCommandBuffer(frameData.prologueCommandBuffer);
+	VkCommandBufferBeginInfo commandBufferBeginInfo{};
+	commandBufferBeginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+	commandBufferBeginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+	VulkanCheck(vkBeginCommandBuffer(frameData.prologueCommandBuffer, &commandBufferBeginInfo));
+	const bool acquiring = ResourceUtils::RecordPendingAcquisitions(rendererData, frameData.prologueCommandBuffer);
+	const bool copying = PipelineUtils::RecordUniformCopies(frameData.prologueCommandBuffer, frameData.uniformCopies);
+	VulkanCheck(vkEndCommandBuffer(frameData.prologueCommandBuffer));
+	const bool prologue = acquiring || copying;
 
 	static VkPipelineStageFlags pipelineStageWait = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
 	VkSubmitInfo submitInfo{};
 	submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
 	submitInfo.waitSemaphoreCount = 1;
 	submitInfo.signalSemaphoreCount = 1;
-	submitInfo.commandBufferCount = 1;
+	submitInfo.commandBufferCount = prologue ? 2 : 1;
 	submitInfo.pWaitDstStageMask = &pipelineStageWait;
-	submitInfo.pWaitSemaphores = &p_->presentSemaphore;
-	submitInfo.pSignalSemaphores = &p_->graphicsSemaphore;
-	submitInfo.pCommandBuffers = &p_->commonFrameData.commandBuffers[currentImageIndex].commandBuffer;
-
-	VulkanCheck(vkQueueSubmit(p_->commonFrameData.graphicsQueue, 1, &submitInfo, p_->frameFences[currentImageIndex]));
+	submitInfo.pWaitSemaphores = &frameData.imageAcquiredSemaphore;
+	submitInfo.pSignalSemaphores = &p_->renderFinishedSemaphores[currentImageIndex];
+	submitInfo.pCommandBuffers = prologue ? commandBuffers : &commandBufferData.commandBuffer;
+
+	// Uploads are only waited for on the GPU, the CPU never blocks on them here.
+	// Frames wait for buffer uploads, textures are only bound and acquired once their upload completed,
+	// so streaming large textures does not hold back the frame. Waiting for completed values is free.
+	rendererData->uploadManager.Flush();
+	const uint64_t frameUploadValue = std::min<uint64_t>(rendererData->frameUploadValue,
+		rendererData->uploadTimeline.GetSubmittedValue());
+	TimelineWait uploadWait{ &rendererData->uploadTimeline,
+		std::max(frameUploadValue, rendererData->uploadTimeline.GetCompletedValue()), VK_PIPELINE_STAGE_ALL_COMMANDS_BIT };
+	frameData.submitValue = rendererData->graphicsTimeline.Submit(submitInfo, &uploadWait, 1);
+
+	p_->currentFrameInFlight = (frameInFlight + 1) % p_->commonFrameData.framesInFlightCount;
 
 	VkPresentInfoKHR presentInfo{};
 	presentInfo.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
@@ -227,7 +456,7 @@ void HawkEye::Pipeline::DrawFrame()
 	presentInfo.pSwapchains = &p_->commonFrameData.swapchain;
 	presentInfo.pImageIndices = &currentImageIndex;
 	presentInfo.waitSemaphoreCount = 1;
-	presentInfo.pWaitSemaphores = &p_->graphicsSemaphore;
+	presentInfo.pWaitSemaphores = &p_->renderFinishedSemaphores[currentImageIndex];
 	result = vkQueuePresentKHR(p_->commonFrameData.surfaceData->defaultPresentQueue, &presentInfo);
 	if (!((result == VK_SUCCESS) || (result == VK_SUBOPTIMAL_KHR)))
 	{
@@ -264,7 +493,7 @@ void HawkEye::Pipeline::Resize(int width, int height)
 
 	vkDeviceWaitIdle(device);
 
-	for (int i = 0; i < p_->commonFrameData.framesInFlightCount; ++i)
+	for (int i = 0; i < p_->commonFrameData.swapchainImageViews.size(); ++i)
 	{
 		VulkanBackend::DestroyImageView(backendData, p_->commonFrameData.swapchainImageViews[i]);
 	}
@@ -283,11 +512,26 @@ void HawkEye::Pipeline::Resize(int width, int height)
 		p_->commonFrameData.swapchainImages.clear();
 		VulkanBackend::GetSwapchainImages(backendData, p_->commonFrameData.swapchain, p_->commonFrameData.swapchainImages);
 
+		// The recreated swapchain does not have to contain the same number of images.
+		const int swapchainImageCount = (int)p_->commonFrameData.swapchainImages.size();
+		if (swapchainImageCount != p_->commonFrameData.swapchainImageCount)
+		{
+			p_->commonFrameData.swapchainImageCount = swapchainImageCount;
+			for (int f = 0; f < p_->frames.size(); ++f)
+			{
+				FreeFrameCommandBuffers(p_->commonFrameData, p_->frames[f]);
+				AllocateFrameCommandBuffers(p_->commonFrameData, p_->frames[f]);
+			}
+			DestroyRenderFinishedSemaphores(p_->commonFrameData, p_->renderFinishedSemaphores);
+			CreateRenderFinishedSemaphores(p_->commonFrameData, p_->renderFinishedSemaphores);
+		}
+
+		p_->commonFrameData.swapchainImageViews.resize(swapchainImageCount);
 		VkImageSubresourceRange subresourceRange{};
 		subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
 		subresourceRange.levelCount = 1;
 		subresourceRange.layerCount = 1;
-		for (int i = 0; i < p_->commonFrameData.framesInFlightCount; ++i)
+		for (int i = 0; i < swapchainImageCount; ++i)
 		{
 			p_->commonFrameData.swapchainImageViews[i] = VulkanBackend::CreateImageView2D(backendData,
 				p_->commonFrameData.swapchainImages[i], surfaceData.surfaceFormat.format, subresourceRange);
@@ -296,18 +540,13 @@ void HawkEye::Pipeline::Resize(int width, int height)
 
 	p_->frameGraph.Resize(p_->commonFrameData);
 
-	for (int c = 0; c < p_->commonFrameData.framesInFlightCount; ++c)
-	{
-		p_->commonFrameData.commandBuffers[c].dirty = true;
-	}
+	MarkCommandBuffersDirty(p_->frames);
 }
 
 void HawkEye::Pipeline::Refresh()
 {
-	for (int c = 0; c < p_->commonFrameData.framesInFlightCount; ++c)
-	{
-		p_->commonFrameData.commandBuffers[c].dirty = true;
-	}
+	p_->frameGraph.MarkCommandBuffersDirty();
+	MarkCommandBuffersDirty(p_->frames);
 }
 
 void HawkEye::Pipeline::ReleaseResources()
@@ -315,6 +554,8 @@ void HawkEye::Pipeline::ReleaseResources()
 	vkDeviceWaitIdle(p_->commonFrameData.backendData->logicalDevice);
 
 	VulkanBackend::ResetCommandPool(*p_->commonFrameData.backendData, p_->commonFrameData.commandPool);
+	p_->frameGraph.MarkCommandBuffersDirty();
+	MarkCommandBuffersDirty(p_->frames);
 }
 
 uint64_t HawkEye::Pipeline::GetPresentedFrame() const
@@ -324,7 +565,27 @@ uint64_t HawkEye::Pipeline::GetPresentedFrame() const
 
 uint64_t HawkEye::Pipeline::GetFramesInFlight() const
 {
-	return p_->frameFences.size();
+	return (uint64_t)p_->commonFrameData.framesInFlightCount;
+}
+
+uint64_t HawkEye::Pipeline::GetUpdateAllocationCount() const
+{
+	uint64_t allocationCount = 0;
+	for (int f = 0; f < p_->frames.size(); ++f)
+	{
+		allocationCount += p_->frames[f].updateArena.GetAllocationCount();
+	}
+	return allocationCount;
+}
+
+uint64_t HawkEye::Pipeline::GetUpdateCopyCount() const
+{
+	uint64_t copyCount = 0;
+	for (int f = 0; f < p_->frames.size(); ++f)
+	{
+		copyCount += p_->frames[f].updateCopyCount;
+	}
+	return copyCount;
 }
 
 uint64_t HawkEye::Pipeline::GetUUID() const
@@ -332,35 +593,92 @@ uint64_t HawkEye::Pipeline::GetUUID() const
 	return (uint64_t)this;
 }
 
+HawkEye::HUniform HawkEye::Pipeline::GetUniformHandle(const std::string& nodeName, const std::string& name) const
+{
+	auto node = p_->uniformKeyIndices.find(nodeName);
+	if (node == p_->uniformKeyIndices.end())
+	{
+		CoreLogError(DefaultLogger, "Uniform handle: No node \'%s\' is configured in the frame graph (could have been pruned).",
+			nodeName.c_str());
+		return -1;
+	}
+	auto uniform = node->second.find(name);
+	if (uniform == node->second.end())
+	{
+		CoreLogError(DefaultLogger, "Uniform handle: No uniform \'%s\' configured for node \'%s\'.", name.c_str(), nodeName.c_str());
+		return -1;
+	}
+	return uniform->second;
+}
+
 void HawkEye::Pipeline::SetUniform(const std::string& nodeName, const std::string& name, HTexture texture)
 {
-	std::shared_ptr<TextureUpdateData> textureData = std::make_shared<TextureUpdateData>(nodeName, name, texture);
+	SetUniform(GetUniformHandle(nodeName, name), texture);
+}
+
+void HawkEye::Pipeline::SetUniform(const std::string& nodeName, const std::string& name, HBuffer buffer)
+{
+	SetUniform(GetUniformHandle(nodeName, name), buffer);
+}
+
+void HawkEye::Pipeline::SetUniformImpl(const std::string& nodeName, const std::string& name, void* data, int dataSize)
+{
+	SetUniformImpl(GetUniformHandle(nodeName, name), data, dataSize);
+}
+
+void HawkEye::Pipeline::SetUniform(HUniform uniform, HTexture texture)
+{
+	if (!CheckUniformHandle(p_, uniform, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER))
+	{
+		return;
+	}
+
 	for (int f = 0; f < p_->commonFrameData.framesInFlightCount; ++f)
 	{
-		p_->textureUpdateData[f].push(textureData);
+		WritePendingUniform(p_, f, uniform, [&](PendingUniform& pendingUniform)
+		{
+			pendingUniform.texture = texture;
+		});
 	}
 }
 
-void HawkEye::Pipeline::SetUniform(const std::string& nodeName, const std::string& name, HBuffer buffer)
+void HawkEye::Pipeline::SetUniform(HUniform uniform, HBuffer buffer)
 {
-	std::shared_ptr<BufferUpdateData> bufferData = std::make_shared<BufferUpdateData>(nodeName, name, buffer);
+	if (!CheckUniformHandle(p_, uniform, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER))
+	{
+		return;
+	}
+
 	for (int f = 0; f < p_->commonFrameData.framesInFlightCount; ++f)
 	{
-		p_->bufferUpdateData[f].push(bufferData);
+		WritePendingUniform(p_, f, uniform, [&](PendingUniform& pendingUniform)
+		{
+			pendingUniform.buffer = buffer;
+		});
 	}
 }
 
-void HawkEye::Pipeline::SetUniformImpl(const std::string& nodeName, const std::string& name, void* data, int dataSize)
+void HawkEye::Pipeline::SetUniformImpl(HUniform uniform, void* data, int dataSize)
 {
-	// TODO: Make safe.
-	// TODO: Handle multiple updates of the same uniform in the same frame.
-	void* dataCopy = malloc(dataSize);
-	memcpy(dataCopy, data, dataSize);
-	std::shared_ptr<PreallocatedUpdateData> preallocatedData = std::make_shared<PreallocatedUpdateData>(
-		nodeName, name, dataCopy, dataSize);
+	if (!CheckUniformHandle(p_, uniform, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER))
+	{
+		return;
+	}
+	if (dataSize > p_->uniformKeys[uniform].size)
+	{
+		CoreLogError(DefaultLogger, "Uniform update: Data for \'%s\' is bigger than the configured uniform size.",
+			p_->uniformKeys[uniform].name.c_str());
+		return;
+	}
+
+	const uint8_t* bytes = (const uint8_t*)data;
 	for (int f = 0; f < p_->commonFrameData.framesInFlightCount; ++f)
 	{
-		p_->preallocatedUpdateData[f].push(preallocatedData);
+		WritePendingUniform(p_, f, uniform, [&](PendingUniform& pendingUniform)
+		{
+			memcpy(pendingUniform.data, bytes, dataSize);
+			pendingUniform.dataSize = dataSize;
+		});
 	}
 }
 
@@ -369,32 +687,103 @@ HawkEye::HMaterial HawkEye::Pipeline::CreateMaterialImpl(const std::string& node
 	return p_->frameGraph.CreateMaterial(nodeName, data, dataSize);
 }
 
+void HawkEye::Pipeline::DeleteMaterial(const std::string& nodeName, HMaterial material)
+{
+	p_->frameGraph.DeleteMaterial(nodeName, material);
+}
+
 void HawkEye::Pipeline::UpdateUniforms(int frameInFlight)
 {
-	while (!p_->preallocatedUpdateData[frameInFlight].empty())
+	// Only the latest value of each uniform is written, regardless of how many times it was set.
+	// The value is copied out so that producers are not blocked while the uniform is being updated.
+	// Keys queued again during the drain are left for the next frame, so each key is copied at most once per frame
+	// and the arena (sized for one copy per key) cannot run out.
+	FrameData& frameData = p_->frames[frameInFlight];
+	UpdateQueue<int>& updateQueue = *p_->uniformUpdateQueues[frameInFlight];
+	for (size_t queuedCount = updateQueue.GetSize(); queuedCount > 0 && updateQueue.Pop([&](int& key)
 	{
-		auto preallocatedData = p_->preallocatedUpdateData[frameInFlight].front();
-		p_->preallocatedUpdateData[frameInFlight].pop();
-		p_->frameGraph.UpdatePreallocatedUniformData(preallocatedData->nodeName, preallocatedData->name, frameInFlight,
-			preallocatedData->data, preallocatedData->dataSize);
-	}
+		const UniformKey& uniformKey = p_->uniformKeys[key];
+		PendingUniform& pendingUniform = frameData.pendingUniforms[key];
+		while (pendingUniform.lock.test_and_set(std::memory_order_acquire)) {}
 
-	while (!p_->bufferUpdateData[frameInFlight].empty())
-	{
-		auto bufferData = p_->bufferUpdateData[frameInFlight].front();
-		p_->bufferUpdateData[frameInFlight].pop();
-		p_->frameGraph.UpdateStorageBuffer(bufferData->nodeName, bufferData->name, frameInFlight, bufferData->buffer);
-	}
+		void* data = nullptr;
+		const int dataSize = pendingUniform.dataSize;
+		if (uniformKey.type == VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER)
+		{
+			data = frameData.updateArena.Allocate(dataSize);
+			if (data)
+			{
+				memcpy(data, pendingUniform.data, dataSize);
+				++frameData.updateCopyCount;
+			}
+		}
+		HTexture texture = pendingUniform.texture;
+		HBuffer buffer = pendingUniform.buffer;
+		pendingUniform.pending = false;
 
-	while (!p_->textureUpdateData[frameInFlight].empty())
-	{
-		auto textureData = p_->textureUpdateData[frameInFlight].front();
-		p_->textureUpdateData[frameInFlight].pop();
-		p_->frameGraph.UpdateTexture(textureData->nodeName, textureData->name, frameInFlight, textureData->texture);
-	}
+		pendingUniform.lock.clear(std::memory_order_release);
+
+		if (uniformKey.type == VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER && !data)
+		{
+			return;
+		}
+
+		switch (uniformKey.type)
+		{
+		case VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER:
+			if (uniformKey.pushConstant)
+			{
+				uniformKey.node->UpdatePushConstant(uniformKey.binding, frameInFlight, data, dataSize);
+			}
+			else
+			{
+				uniformKey.node->UpdatePreallocatedUniformData(uniformKey.binding, frameInFlight, data, dataSize,
+					frameData.uniformCopies);
+			}
+			break;
+		case VK_DESCRIPTOR_TYPE_STORAGE_BUFFER:
+			uniformKey.node->UpdateStorageBuffer(uniformKey.binding, frameInFlight, buffer);
+			break;
+		case VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER:
+			uniformKey.node->UpdateTexture(uniformKey.binding, frameInFlight, texture);
+			break;
+		default:
+			break;
+		}
+	}); --queuedCount) {}
 }
 
 VkFormat PipelineUtils::GetAttributeFormat(const VertexAttribute& vertexAttribute)
 {
 	return (VkFormat)(VK_FORMAT_R32_UINT + (vertexAttribute.byteCount / 4 - 1) * 3 + (int)vertexAttribute.type);
 }
+
+bool PipelineUtils::RecordUniformCopies(VkCommandBuffer commandBuffer, const std::vector<UniformCopy>& uniformCopies)
+{
+	if (uniformCopies.empty())
+	{
+		return false;
+	}
+
+	// The data is stored in the command buffer, which limits a single update to 65536 bytes.
+	const int maxUpdateSize = 65536;
+	for (int c = 0; c < uniformCopies.size(); ++c)
+	{
+		const UniformCopy& uniformCopy = uniformCopies[c];
+		for (int offset = 0; offset < uniformCopy.dataSize; offset += maxUpdateSize)
+		{
+			const int updateSize = std::min(uniformCopy.dataSize - offset, maxUpdateSize);
+			vkCmdUpdateBuffer(commandBuffer, uniformCopy.buffer, uniformCopy.offset + offset, (VkDeviceSize)updateSize,
+				(const uint8_t*)uniformCopy.data + offset);
+		}
+	}
+
+	VkMemoryBarrier memoryBarrier{};
+	memoryBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+	memoryBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	memoryBarrier.dstAccessMask = VK_ACCESS_UNIFORM_READ_BIT;
+	vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT,
+		VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0,
+		1, &memoryBarrier, 0, nullptr, 0, nullptr);
+	return true;
+}
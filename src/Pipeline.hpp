@@ -3,62 +3,82 @@
 #include "FrameGraph/FrameGraph.hpp"
 #include "YAMLConfiguration.hpp"
 #include "Framebuffer.hpp"
+#include "UpdateQueue.hpp"
+#include "LinearArena.hpp"
+#include "ThreadPool.hpp"
 #include <VulkanBackend/VulkanBackendAPI.hpp>
-#include <queue>
+#include <atomic>
+#include <cstdint>
+#include <map>
+#include <memory>
 
-// TODO: Thread-safe queue
-struct PreallocatedUpdateData
+// Uniform of a configured node, identified by its index in the registry.
+struct UniformKey
 {
 	std::string nodeName;
 	std::string name;
-	void* data;
-	int dataSize;
-
-	PreallocatedUpdateData(const std::string& nodeName, const std::string& name,
-		void* data, int dataSize)
-		: nodeName(nodeName), name(name), data(data), dataSize(dataSize) {}
-
-	~PreallocatedUpdateData()
-	{
-		free(data);
-	}
+	FrameGraphNode* node;
+	int binding;
+	VkDescriptorType type;
+	int size;
+	// Push constants are uniform buffer data addressed by their index in the node's push constants.
+	bool pushConstant;
 };
 
-struct TextureUpdateData
+// Latest value of a uniform for a single frame in flight. Later updates overwrite earlier ones,
+// so the key is queued at most once no matter how many times the uniform is set.
+// Lives in the frame's update arena, as does its data.
+struct PendingUniform
 {
-	std::string nodeName;
-	std::string name;
-	HawkEye::HTexture texture;
-
-	TextureUpdateData(const std::string& nodeName, const std::string& name, HawkEye::HTexture texture)
-		: nodeName(nodeName), name(name), texture(texture) {}
+	std::atomic_flag lock = ATOMIC_FLAG_INIT;
+	bool pending = false;
+	uint8_t* data = nullptr;
+	int dataSize = 0;
+	HawkEye::HTexture texture = nullptr;
+	HawkEye::HBuffer buffer = nullptr;
 };
 
-struct BufferUpdateData
+// Synchronization ring entry, indexed by the frame in flight rather than by the acquired swapchain image.
+struct FrameData
 {
-	std::string nodeName;
-	std::string name;
-	HawkEye::HBuffer buffer;
-
-	BufferUpdateData(const std::string& nodeName, const std::string& name, HawkEye::HBuffer buffer)
-		: nodeName(nodeName), name(name), buffer(buffer) {}
+	VkSemaphore imageAcquiredSemaphore = VK_NULL_HANDLE;
+	// Graphics timeline value signaled by the last submit of this entry.
+	uint64_t submitValue = 0;
+	// Pending uniforms (persistent) and the scratch copies consumed by the frame, reset once the frame finishes.
+	LinearArena updateArena;
+	PendingUniform* pendingUniforms = nullptr;
+	// Scratch copies taken from the update arena so far.
+	uint64_t updateCopyCount = 0;
+	// Recorded commands depend on both the frame's descriptor sets and the acquired image's targets.
+	std::vector<CommandBufferData> commandBuffers;
+	// Device-local uniform updates of the frame, their data lives in the update arena.
+	std::vector<UniformCopy> uniformCopies;
+	// Recorded every frame and submitted ahead of the cached commands when it is not empty: acquisitions of textures
+	// uploaded on a dedicated transfer family and the device-local uniform copies.
+	VkCommandBuffer prologueCommandBuffer = VK_NULL_HANDLE;
 };
 
 struct HawkEye::Pipeline::Private
 {
 	bool configured = false;
 	CommonFrameData commonFrameData;
-	VkSemaphore graphicsSemaphore = VK_NULL_HANDLE;
-	VkSemaphore presentSemaphore = VK_NULL_HANDLE;
-	std::vector<VkFence> frameFences;
+	std::vector<FrameData> frames;
+	// Per swapchain image, as an image is only acquired again once its previous presentation no longer waits on the semaphore.
+	std::vector<VkSemaphore> renderFinishedSemaphores;
+	int currentFrameInFlight = 0;
 	FrameGraph frameGraph;
+	UniformRing uniformRing;
+	ThreadPool recordingThreadPool;
 
-	std::vector<std::queue<std::shared_ptr<PreallocatedUpdateData>>> preallocatedUpdateData;
-	std::vector<std::queue<std::shared_ptr<TextureUpdateData>>> textureUpdateData;
-	std::vector<std::queue<std::shared_ptr<BufferUpdateData>>> bufferUpdateData;
+	std::vector<UniformKey> uniformKeys;
+	std::map<std::string, std::map<std::string, int>> uniformKeyIndices;
+	// Per frame in flight: the keys with a pending value, filled by any thread and drained by the render thread.
+	std::vector<std::unique_ptr<UpdateQueue<int>>> uniformUpdateQueues;
 };
 
 namespace PipelineUtils
 {
 	VkFormat GetAttributeFormat(const VertexAttribute& vertexAttribute);
+	// Records the copies followed by a single barrier making them visible to the shaders. Returns false if there are none.
+	bool RecordUniformCopies(VkCommandBuffer commandBuffer, const std::vector<UniformCopy>& uniformCopies);
 }
@@ -0,0 +1,66 @@
+#pragma once
+#include "HawkEye/HawkEyeAPI.hpp"
+#include "BindlessSet.hpp"
+#include "DescriptorAllocator.hpp"
+#include "DescriptorWriter.hpp"
+#include "ObjectCache.hpp"
+#include "ThreadPool.hpp"
+#include "Timeline.hpp"
+#include "UploadManager.hpp"
+#include <VulkanBackend/VulkanBackendAPI.hpp>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <vector>
+
+struct DeferredDeletion
+{
+	uint64_t uploadValue;
+	// Last frame that may use the resource.
+	uint64_t graphicsValue;
+	HawkEye::HTexture texture;
+	HawkEye::HBuffer buffer;
+};
+
+struct HawkEye::HRendererData_t
+{
+	VulkanBackend::BackendData backendData{};
+
+	// One timeline per queue the front-end submits to.
+	Timeline graphicsTimeline;
+	Timeline uploadTimeline;
+	// The only submitter to the upload timeline.
+	UploadManager uploadManager;
+	// Records asynchronous uploads; signals asyncUploadRecorded whenever one of them gets its upload value.
+	ThreadPool uploadThreadPool;
+	std::mutex asyncUploadMutex;
+	std::condition_variable asyncUploadRecorded;
+	// Splits CPU texture processing (compression, mip generation) into rows.
+	ThreadPool textureThreadPool;
+	// A dedicated transfer family if the device has one, the general family otherwise.
+	int uploadFamilyIndex = 0;
+	// Textures released by the upload family that still have to be acquired by the general family.
+	std::vector<HawkEye::HTexture> pendingAcquisitions;
+	std::mutex pendingAcquisitionMutex;
+
+	// Resources deleted while their upload was still in flight.
+	std::vector<DeferredDeletion> deferredDeletions;
+	std::mutex deferredDeletionMutex;
+
+	// Descriptor sets of all materials and nodes.
+	DescriptorAllocator descriptorAllocator;
+	// Set layouts, render passes and samplers shared by all pipelines.
+	ObjectCache objectCache;
+	// Descriptor writes of all pipelines, flushed before each frame is recorded.
+	DescriptorWriter descriptorWriter;
+	// Shared by all bindless nodes, unavailable without descriptor indexing support.
+	BindlessSet bindlessSet;
+	// Written in place of textures whose upload has not completed yet.
+	HawkEye::HTexture placeholderTexture = nullptr;
+	// Highest upload value of the buffers, which frames wait for on the GPU (textures are only used once uploaded).
+	std::atomic<uint64_t> frameUploadValue{ 0 };
+
+	// Memory held by live textures and buffers.
+	std::atomic<uint64_t> deviceLocalBytes{ 0 };
+	std::atomic<uint64_t> hostVisibleBytes{ 0 };
+};
@@ -1,20 +1,224 @@
 #include "HawkEye/HawkEyeAPI.hpp"
 #include "Resources.hpp"
+#include "RendererData.hpp"
+#include "BlockCompression.hpp"
+#include "TextureProcessing.hpp"
+#include "TextureContainer.hpp"
+#include "MappedFile.hpp"
 #include <SoftwareCore/DefaultLogger.hpp>
 #include <VulkanBackend/ErrorCheck.hpp>
 #include <VulkanBackend/VulkanBackendAPI.hpp>
 #include <vulkan/vulkan.hpp>
+#include <algorithm>
 #include <math.h>
 
-int GetMipCount(int width, int height)
+// Minimum sub-allocation granularity of buffer arenas, enough for instance data (64 byte matrices) as well as indices.
+static const int arenaAlignment = 64;
+
+static uint64_t GetAllocationSize(const VulkanBackend::BackendData& backendData, VmaAllocation allocation)
+{
+	VmaAllocationInfo allocationInfo;
+	vmaGetAllocationInfo(backendData.allocator, allocation, &allocationInfo);
+	return (uint64_t)allocationInfo.size;
+}
+
+// Either half of a queue family ownership transfer of the whole image.
+static void RecordImageOwnershipTransfer(VkCommandBuffer commandBuffer, HawkEye::HTexture texture, int srcFamilyIndex, int dstFamilyIndex,
+	VkImageLayout oldLayout, VkImageLayout newLayout, bool release)
+{
+	VkImageMemoryBarrier imageMemoryBarrier{};
+	imageMemoryBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+	imageMemoryBarrier.srcAccessMask = release ? VK_ACCESS_TRANSFER_WRITE_BIT : 0;
+	imageMemoryBarrier.dstAccessMask = release ? 0 :
+		(newLayout == VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL ? VK_ACCESS_TRANSFER_READ_BIT | VK_ACCESS_TRANSFER_WRITE_BIT :
+		VK_ACCESS_SHADER_READ_BIT);
+	imageMemoryBarrier.oldLayout = oldLayout;
+	imageMemoryBarrier.newLayout = newLayout;
+	imageMemoryBarrier.srcQueueFamilyIndex = (uint32_t)srcFamilyIndex;
+	imageMemoryBarrier.dstQueueFamilyIndex = (uint32_t)dstFamilyIndex;
+	imageMemoryBarrier.image = texture->image.image;
+	imageMemoryBarrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+	imageMemoryBarrier.subresourceRange.baseMipLevel = 0;
+	imageMemoryBarrier.subresourceRange.levelCount = texture->mipCount;
+	imageMemoryBarrier.subresourceRange.baseArrayLayer = 0;
+	imageMemoryBarrier.subresourceRange.layerCount = texture->layerCount;
+
+	const VkPipelineStageFlags srcStage = release ? VK_PIPELINE_STAGE_TRANSFER_BIT : VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
+	const VkPipelineStageFlags dstStage = release ? VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT :
+		(newLayout == VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL ? VK_PIPELINE_STAGE_TRANSFER_BIT : VK_PIPELINE_STAGE_ALL_COMMANDS_BIT);
+	vkCmdPipelineBarrier(commandBuffer, srcStage, dstStage, 0, 0, nullptr, 0, nullptr, 1, &imageMemoryBarrier);
+}
+
+// Layout transition of all levels and layers.
+static void RecordImageLayoutTransition(VkCommandBuffer commandBuffer, HawkEye::HTexture texture, VkImageLayout newLayout,
+	VkPipelineStageFlags srcStage, VkPipelineStageFlags dstStage, VkAccessFlags srcAccess, VkAccessFlags dstAccess)
+{
+	VkImageMemoryBarrier imageMemoryBarrier{};
+	imageMemoryBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+	imageMemoryBarrier.srcAccessMask = srcAccess;
+	imageMemoryBarrier.dstAccessMask = dstAccess;
+	imageMemoryBarrier.oldLayout = texture->imageLayout;
+	imageMemoryBarrier.newLayout = newLayout;
+	imageMemoryBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	imageMemoryBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	imageMemoryBarrier.image = texture->image.image;
+	imageMemoryBarrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+	imageMemoryBarrier.subresourceRange.baseMipLevel = 0;
+	imageMemoryBarrier.subresourceRange.levelCount = texture->mipCount;
+	imageMemoryBarrier.subresourceRange.baseArrayLayer = 0;
+	imageMemoryBarrier.subresourceRange.layerCount = texture->layerCount;
+	vkCmdPipelineBarrier(commandBuffer, srcStage, dstStage, 0, 0, nullptr, 0, nullptr, 1, &imageMemoryBarrier);
+	texture->imageLayout = newLayout;
+}
+
+// Textures released by the upload family wait for their acquisition, otherwise the general family owns them right away.
+static void TrackTextureOwnership(HawkEye::HRendererData rendererData, HawkEye::HTexture texture, bool transferOwnership)
+{
+	const VulkanBackend::BackendData& backendData = rendererData->backendData;
+	// Compute nodes record into the graphics command buffers as well, so the general family is the owner either way.
+	if (transferOwnership)
+	{
+		texture->currentFamilyIndex = rendererData->uploadFamilyIndex;
+		texture->firstUse = true;
+
+		std::lock_guard<std::mutex> lock(rendererData->pendingAcquisitionMutex);
+		rendererData->pendingAcquisitions.push_back(texture);
+	}
+	else
+	{
+		texture->currentFamilyIndex = backendData.generalFamilyIndex;
+		texture->firstUse = false;
+	}
+}
+
+static void GenerateTextureMips(const VulkanBackend::BackendData& backendData, VkCommandBuffer commandBuffer, HawkEye::HTexture texture)
+{
+	VulkanBackend::GenerateMips(backendData, commandBuffer, texture->image.image, texture->format, texture->width, texture->height,
+		texture->mipCount);
+	texture->imageLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+
+	VulkanBackend::TransitionImageLayout(commandBuffer, texture->imageLayout, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+		texture->image.image, texture->mipCount, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, VK_IMAGE_ASPECT_COLOR_BIT,
+		VK_ACCESS_TRANSFER_READ_BIT, 0);
+	texture->imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+}
+
+// Device-local buffers are shared by the upload and general families, so updates need no ownership transfers.
+static VulkanBackend::Buffer CreateDeviceLocalBuffer(HawkEye::HRendererData rendererData, VkBufferUsageFlags usage, int size)
+{
+	const VulkanBackend::BackendData& backendData = rendererData->backendData;
+	if (rendererData->uploadFamilyIndex == backendData.generalFamilyIndex)
+	{
+		return VulkanBackend::CreateBuffer(backendData, usage, size, VMA_MEMORY_USAGE_GPU_ONLY);
+	}
+
+	const uint32_t familyIndices[] = { (uint32_t)rendererData->uploadFamilyIndex, (uint32_t)backendData.generalFamilyIndex };
+	VkBufferCreateInfo bufferCreateInfo{};
+	bufferCreateInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+	bufferCreateInfo.size = (VkDeviceSize)size;
+	bufferCreateInfo.usage = usage;
+	bufferCreateInfo.sharingMode = VK_SHARING_MODE_CONCURRENT;
+	bufferCreateInfo.queueFamilyIndexCount = 2;
+	bufferCreateInfo.pQueueFamilyIndices = familyIndices;
+
+	VmaAllocationCreateInfo allocationCreateInfo{};
+	allocationCreateInfo.usage = VMA_MEMORY_USAGE_GPU_ONLY;
+
+	VulkanBackend::Buffer buffer{};
+	VulkanCheck(vmaCreateBuffer(backendData.allocator, &bufferCreateInfo, &allocationCreateInfo, &buffer.buffer, &buffer.allocation,
+		nullptr));
+	return buffer;
+}
+
+// Wakes up everyone waiting for an asynchronous upload to be recorded.
+static void PublishUploadValue(HawkEye::HRendererData rendererData, std::atomic<uint64_t>& uploadValue, uint64_t value)
+{
+	{
+		std::lock_guard<std::mutex> lock(rendererData->asyncUploadMutex);
+		uploadValue = value;
+	}
+	rendererData->asyncUploadRecorded.notify_all();
+}
+
+void ResourceUtils::WaitForRecording(HawkEye::HRendererData rendererData, const std::atomic<uint64_t>& uploadValue)
+{
+	if (uploadValue != ResourceUtils::recordingUploadValue)
+	{
+		return;
+	}
+
+	std::unique_lock<std::mutex> lock(rendererData->asyncUploadMutex);
+	rendererData->asyncUploadRecorded.wait(lock, [&]() { return uploadValue != ResourceUtils::recordingUploadValue; });
+}
+
+// Buffers are read by frames without an acquisition step, so frames wait for their uploads on the GPU.
+static void RequireUploadForFrames(HawkEye::HRendererData rendererData, uint64_t uploadValue)
+{
+	uint64_t frameUploadValue = rendererData->frameUploadValue;
+	while (frameUploadValue < uploadValue &&
+		!rendererData->frameUploadValue.compare_exchange_weak(frameUploadValue, uploadValue))
+	{
+	}
+}
+
+static VkBufferUsageFlags TranslateBufferUsage(HawkEye::BufferUsage usage)
+{
+	switch (usage)
+	{
+	case HawkEye::BufferUsage::Vertex:
+		return VK_BUFFER_USAGE_VERTEX_BUFFER_BIT;
+	case HawkEye::BufferUsage::Index:
+		return VK_BUFFER_USAGE_INDEX_BUFFER_BIT;
+	case HawkEye::BufferUsage::Uniform:
+		return VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT;
+	case HawkEye::BufferUsage::Storage:
+		return VK_BUFFER_USAGE_STORAGE_BUFFER_BIT;
+	default:
+		return 0;
+	}
+}
+
+static bool SupportsLinearBlit(const VulkanBackend::BackendData& backendData, VkFormat format)
+{
+	const VkFormatFeatureFlags requiredFeatures = VK_FORMAT_FEATURE_BLIT_SRC_BIT | VK_FORMAT_FEATURE_BLIT_DST_BIT |
+		VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT;
+	VkFormatProperties formatProperties;
+	vkGetPhysicalDeviceFormatProperties(backendData.physicalDevice, format, &formatProperties);
+	return (formatProperties.optimalTilingFeatures & requiredFeatures) == requiredFeatures;
+}
+
+static int GetMipCount(int width, int height)
 {
 	int largerSize = (width > height) ? width : height;
 
 	return (int)(std::floor(std::log2(largerSize))) + 1;
 }
 
-VkFormat TranslateFormat(HawkEye::TextureFormat textureFormat, HawkEye::ColorCompression colorCompression)
+static VkFormat TranslateFormat(HawkEye::TextureFormat textureFormat, HawkEye::ColorCompression colorCompression,
+	HawkEye::TextureCompression textureCompression)
 {
+	const bool srgb = colorCompression == HawkEye::ColorCompression::SRGB;
+	switch (textureCompression)
+	{
+	case HawkEye::TextureCompression::BC1:
+		if (textureFormat == HawkEye::TextureFormat::RGBA)
+		{
+			return srgb ? VK_FORMAT_BC1_RGBA_SRGB_BLOCK : VK_FORMAT_BC1_RGBA_UNORM_BLOCK;
+		}
+		return srgb ? VK_FORMAT_BC1_RGB_SRGB_BLOCK : VK_FORMAT_BC1_RGB_UNORM_BLOCK;
+	case HawkEye::TextureCompression::BC3:
+		return srgb ? VK_FORMAT_BC3_SRGB_BLOCK : VK_FORMAT_BC3_UNORM_BLOCK;
+	case HawkEye::TextureCompression::BC4:
+		// There are no sRGB variants of the single and two channel formats.
+		return VK_FORMAT_BC4_UNORM_BLOCK;
+	case HawkEye::TextureCompression::BC5:
+		return VK_FORMAT_BC5_UNORM_BLOCK;
+	case HawkEye::TextureCompression::BC7:
+		return srgb ? VK_FORMAT_BC7_SRGB_BLOCK : VK_FORMAT_BC7_UNORM_BLOCK;
+	default:
+		break;
+	}
+
 	// Beware, RGB format may not be supported on the GPU.
 	if (colorCompression == HawkEye::ColorCompression::SRGB)
 	{
@@ -47,25 +251,72 @@ VkFormat TranslateFormat(HawkEye::TextureFormat textureFormat, HawkEye::ColorCom
 	return VK_FORMAT_UNDEFINED;
 }
 
-HawkEye::HTexture HawkEye::UploadTexture(HRendererData rendererData, void* data, int dataSize, int width, int height,
-	TextureFormat format, ColorCompression colorCompression, TextureCompression textureCompression,
-	bool generateMips, TextureQueue usage)
+// Returns the upload timeline value of the copy.
+static uint64_t RecordTextureUpload(HawkEye::HRendererData rendererData, HawkEye::HTexture texture, void* data, int dataSize,
+	int width, int height, HawkEye::TextureFormat format, HawkEye::ColorCompression colorCompression,
+	HawkEye::TextureCompression textureCompression, bool generateMips, HawkEye::TextureQueue usage, HawkEye::MipFilter mipFilter)
 {
-	// NOTE: Currently includes ownership acquisition.
-	const VulkanBackend::BackendData& backendData = *(VulkanBackend::BackendData*)rendererData;
-	VkDevice device = backendData.logicalDevice;
+	const VulkanBackend::BackendData& backendData = rendererData->backendData;
+	if (generateMips && textureCompression != HawkEye::TextureCompression::None)
+	{
+		CoreLogWarn(DefaultLogger, "Texture upload: Mips of block-compressed textures cannot be generated - skipping.");
+		generateMips = false;
+	}
+	// Transfer-only families cannot blit, so the mips are generated by the general family after acquisition.
+	const bool transferOwnership = rendererData->uploadFamilyIndex != backendData.generalFamilyIndex;
+
+	// RGB formats are rarely supported, the texels are expanded to RGBA on the CPU instead.
+	std::vector<uint8_t> processedData;
+	const void* uploadData = data;
+	size_t uploadSize = dataSize;
+	if (format == HawkEye::TextureFormat::RGB && textureCompression == HawkEye::TextureCompression::None)
+	{
+		format = HawkEye::TextureFormat::RGBA;
+		processedData.resize((size_t)width * height * 4);
+		TextureProcessing::ExpandRGBToRGBA((const uint8_t*)data, width, height, processedData.data(),
+			rendererData->textureThreadPool);
+		uploadData = processedData.data();
+		uploadSize = processedData.size();
+	}
+
+	VkFormat imageFormat = TranslateFormat(format, colorCompression, textureCompression);
+
+	if (generateMips && mipFilter == HawkEye::MipFilter::GpuBlit && !SupportsLinearBlit(backendData, imageFormat))
+	{
+		CoreLogWarn(DefaultLogger, "Texture upload: Mips of formats without linear blits need a CPU mip filter - skipping.");
+		generateMips = false;
+	}
 	const int mipCount = generateMips ? GetMipCount(width, height) : 1;
 
-	HTexture texture = new HTexture_t;
-	VkFormat imageFormat = TranslateFormat(format, colorCompression);
+	// CPU filtered mip chains are uploaded in the same copy as the base level.
+	const bool cpuMips = generateMips && mipFilter != HawkEye::MipFilter::GpuBlit;
+	const bool gpuMips = generateMips && !cpuMips;
+	std::vector<size_t> levelOffsets{ 0, uploadSize };
+	if (cpuMips)
+	{
+		const int channelCount = (int)format + 1;
+		levelOffsets = TextureProcessing::GetMipLevelOffsets(width, height, mipCount, channelCount);
+		std::vector<uint8_t> mipChain(levelOffsets.back());
+		memcpy(mipChain.data(), uploadData, uploadSize);
+		TextureProcessing::GenerateMipChain(mipChain.data(), levelOffsets, width, height, mipCount, channelCount,
+			colorCompression == HawkEye::ColorCompression::SRGB, mipFilter, rendererData->textureThreadPool);
+		processedData = std::move(mipChain);
+		uploadData = processedData.data();
+		uploadSize = processedData.size();
+	}
 
+	texture->width = width;
+	texture->height = height;
+	texture->format = imageFormat;
 	texture->mipCount = mipCount;
 	texture->currentUsage = usage;
 
 	VkImageUsageFlags imageUsage = VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT |
-		(generateMips ? VK_IMAGE_USAGE_TRANSFER_SRC_BIT : 0);
+		(gpuMips ? VK_IMAGE_USAGE_TRANSFER_SRC_BIT : 0);
 	texture->image = VulkanBackend::CreateImage2D(backendData, width, height, 1, mipCount,
 		imageUsage, imageFormat, VMA_MEMORY_USAGE_GPU_ONLY);
+	texture->allocationSize = GetAllocationSize(backendData, texture->image.allocation);
+	rendererData->deviceLocalBytes += texture->allocationSize;
 
 	VkImageSubresourceRange subresourceRange{};
 	subresourceRange.baseMipLevel = 0;
@@ -75,141 +326,487 @@ HawkEye::HTexture HawkEye::UploadTexture(HRendererData rendererData, void* data,
 	subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
 	texture->imageView = VulkanBackend::CreateImageView2D(backendData, texture->image.image, imageFormat, subresourceRange);
 
-	texture->sampler = VulkanBackend::CreateImageSampler(backendData, VK_FILTER_LINEAR, VK_FILTER_LINEAR, VK_BORDER_COLOR_INT_TRANSPARENT_BLACK,
+	// Textures with the same mip count share their sampler.
+	texture->sampler = rendererData->objectCache.AcquireSampler(VK_FILTER_LINEAR, VK_FILTER_LINEAR, VK_BORDER_COLOR_INT_TRANSPARENT_BLACK,
 		VK_SAMPLER_ADDRESS_MODE_REPEAT, VK_SAMPLER_ADDRESS_MODE_REPEAT, VK_SAMPLER_ADDRESS_MODE_REPEAT, 0.f, (float)mipCount);
 
-	// Create staging command buffer.
-	texture->stagingBuffer = VulkanBackend::CreateBuffer(backendData, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-		dataSize, VMA_MEMORY_USAGE_CPU_ONLY);
-
-	// Copy data to staging buffer.
+	// Recorded into the upload manager's current batch, submitted together with the other uploads.
+	const uint64_t uploadValue = rendererData->uploadManager.Upload(uploadData, uploadSize,
+		[&](VkCommandBuffer commandBuffer, VkBuffer stagingBuffer, VkDeviceSize stagingOffset)
 	{
-		void* stagingBufferData;
-		VulkanCheck(vmaMapMemory(backendData.allocator, texture->stagingBuffer.allocation, &stagingBufferData));
-		memcpy(stagingBufferData, data, dataSize);
-		vmaUnmapMemory(backendData.allocator, texture->stagingBuffer.allocation);
-	}
+		// Transition layout to dst optimal.
+		VulkanBackend::TransitionImageLayout(commandBuffer, texture->imageLayout, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+			texture->image.image, mipCount, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_IMAGE_ASPECT_COLOR_BIT,
+			0, VK_ACCESS_TRANSFER_WRITE_BIT);
+		texture->imageLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
 
-	texture->uploadFence = VulkanBackend::CreateFence(backendData);
+		// Copy from staging buffer to GPU, one region per level uploaded.
+		const int copiedLevelCount = (int)levelOffsets.size() - 1;
+		std::vector<VkBufferImageCopy> bufferImageCopies(copiedLevelCount);
+		for (int m = 0; m < copiedLevelCount; ++m)
+		{
+			VkBufferImageCopy& bufferImageCopy = bufferImageCopies[m];
+			bufferImageCopy = {};
+			bufferImageCopy.bufferOffset = stagingOffset + levelOffsets[m];
+			bufferImageCopy.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+			bufferImageCopy.imageSubresource.mipLevel = m;
+			bufferImageCopy.imageSubresource.baseArrayLayer = 0;
+			bufferImageCopy.imageSubresource.layerCount = 1;
+			bufferImageCopy.imageExtent = { (uint32_t)std::max(width >> m, 1), (uint32_t)std::max(height >> m, 1), 1 };
+		}
+		vkCmdCopyBufferToImage(commandBuffer, stagingBuffer, texture->image.image, texture->imageLayout,
+			(uint32_t)bufferImageCopies.size(), bufferImageCopies.data());
 
-	texture->generalCommandBuffer = VulkanBackend::AllocateCommandBuffer(backendData, backendData.generalCommandPool);
-	texture->operationSemaphore = VulkanBackend::CreateSemaphore(backendData);
-	texture->uploadSemaphore = VulkanBackend::CreateSemaphore(backendData);
+		if (transferOwnership)
+		{
+			// Release half of the ownership transfer, the general family acquires the texture before its first use.
+			const VkImageLayout releasedLayout = gpuMips ? VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL :
+				VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+			RecordImageOwnershipTransfer(commandBuffer, texture, rendererData->uploadFamilyIndex, backendData.generalFamilyIndex,
+				texture->imageLayout, releasedLayout, true);
+			texture->imageLayout = releasedLayout;
+		}
+		// Transition layout shader read only optimal.
+		else if (!gpuMips)
+		{
+			VulkanBackend::TransitionImageLayout(commandBuffer, texture->imageLayout, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+				texture->image.image, mipCount, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, VK_IMAGE_ASPECT_COLOR_BIT,
+				VK_ACCESS_TRANSFER_WRITE_BIT, 0);
+			texture->imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+		}
+		else
+		{
+			GenerateTextureMips(backendData, commandBuffer, texture);
+		}
+	});
 
-	// All in a single command buffer.
-	VkCommandBufferBeginInfo commandBufferBeginInfo{};
-	commandBufferBeginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
-	VulkanCheck(vkBeginCommandBuffer(texture->generalCommandBuffer, &commandBufferBeginInfo));
+	TrackTextureOwnership(rendererData, texture, transferOwnership);
 
-	// Transition layout to dst optimal.
-	VulkanBackend::TransitionImageLayout(texture->generalCommandBuffer, texture->imageLayout, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-		texture->image.image, mipCount, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_IMAGE_ASPECT_COLOR_BIT,
-		0, VK_ACCESS_TRANSFER_WRITE_BIT);
-	texture->imageLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+	return uploadValue;
+}
+
+HawkEye::HTexture HawkEye::UploadTexture(HRendererData rendererData, void* data, int dataSize, int width, int height,
+	TextureFormat format, ColorCompression colorCompression, TextureCompression textureCompression,
+	bool generateMips, TextureQueue usage, MipFilter mipFilter)
+{
+	HTexture texture = new HTexture_t;
+	texture->uploadValue = RecordTextureUpload(rendererData, texture, data, dataSize, width, height, format, colorCompression,
+		textureCompression, generateMips, usage, mipFilter);
+	return texture;
+}
 
-	// Copy from staging buffer to GPU.
-	VulkanBackend::CopyBufferToImage(backendData, texture->stagingBuffer.buffer, texture->image.image, texture->imageLayout,
-		texture->generalCommandBuffer, width, height, VK_IMAGE_ASPECT_COLOR_BIT);
+HawkEye::HTexture HawkEye::UploadTextureAsync(HRendererData rendererData, void* data, int dataSize, int width, int height,
+	TextureFormat format, ColorCompression colorCompression, TextureCompression textureCompression,
+	bool generateMips, TextureQueue usage, MipFilter mipFilter, std::function<void(HTexture)> onRecorded)
+{
+	HTexture texture = new HTexture_t;
+	texture->uploadValue = ResourceUtils::recordingUploadValue;
+	rendererData->uploadThreadPool.Submit([=]()
+	{
+		PublishUploadValue(rendererData, texture->uploadValue, RecordTextureUpload(rendererData, texture, data, dataSize,
+			width, height, format, colorCompression, textureCompression, generateMips, usage, mipFilter));
+		if (onRecorded)
+		{
+			onRecorded(texture);
+		}
+	});
+	return texture;
+}
 
-	// Transition layout shader read only optimal.
-	if (!generateMips)
+HawkEye::HTexture HawkEye::LoadTextureFile(HRendererData rendererData, const char* path, TextureQueue usage)
+{
+	MappedFile file;
+	if (!file.Open(path))
 	{
-		VulkanBackend::TransitionImageLayout(texture->generalCommandBuffer, texture->imageLayout, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
-			texture->image.image, mipCount, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, VK_IMAGE_ASPECT_COLOR_BIT,
-			VK_ACCESS_TRANSFER_WRITE_BIT, 0);
+		CoreLogError(DefaultLogger, "Texture loading: Could not map \'%s\'.", path);
+		return nullptr;
 	}
-	else
+	TextureContainer container;
+	if (!TextureContainerUtils::Parse(file.GetData(), file.GetSize(), container))
 	{
-		VulkanBackend::GenerateMips(backendData, texture->generalCommandBuffer, texture->image.image, imageFormat, width, height, mipCount);
-		texture->imageLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+		CoreLogError(DefaultLogger, "Texture loading: Could not parse \'%s\'.", path);
+		return nullptr;
+	}
 
-		VulkanBackend::TransitionImageLayout(texture->generalCommandBuffer, texture->imageLayout, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
-			texture->image.image, mipCount, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, VK_IMAGE_ASPECT_COLOR_BIT,
-			VK_ACCESS_TRANSFER_READ_BIT, 0);
+	const VulkanBackend::BackendData& backendData = rendererData->backendData;
+	const bool transferOwnership = rendererData->uploadFamilyIndex != backendData.generalFamilyIndex;
+
+	// Files may hold formats and extents the device cannot sample, image creation would fail on them.
+	VkFormatProperties formatProperties;
+	vkGetPhysicalDeviceFormatProperties(backendData.physicalDevice, container.format, &formatProperties);
+	const VkFormatFeatureFlags requiredFeatures = VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT | VK_FORMAT_FEATURE_TRANSFER_DST_BIT;
+	VkImageFormatProperties imageFormatProperties;
+	if ((formatProperties.optimalTilingFeatures & requiredFeatures) != requiredFeatures ||
+		vkGetPhysicalDeviceImageFormatProperties(backendData.physicalDevice, container.format, VK_IMAGE_TYPE_2D,
+			VK_IMAGE_TILING_OPTIMAL, VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT, 0,
+			&imageFormatProperties) != VK_SUCCESS)
+	{
+		CoreLogError(DefaultLogger, "Texture loading: The device cannot sample the format of '%s'.", path);
+		return nullptr;
+	}
+	if ((uint32_t)container.width > imageFormatProperties.maxExtent.width ||
+		(uint32_t)container.height > imageFormatProperties.maxExtent.height ||
+		(uint32_t)container.mipCount > imageFormatProperties.maxMipLevels ||
+		(uint32_t)container.layerCount > imageFormatProperties.maxArrayLayers)
+	{
+		CoreLogError(DefaultLogger, "Texture loading: '%s' exceeds the device's image limits.", path);
+		return nullptr;
 	}
 
-	texture->imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-	texture->currentFamilyIndex = backendData.generalFamilyIndex;
+	HTexture texture = new HTexture_t;
+	texture->width = container.width;
+	texture->height = container.height;
+	texture->format = container.format;
+	texture->mipCount = container.mipCount;
+	texture->layerCount = container.layerCount;
+	texture->currentUsage = usage;
+
+	VkImageCreateInfo imageCreateInfo{};
+	imageCreateInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+	imageCreateInfo.imageType = VK_IMAGE_TYPE_2D;
+	imageCreateInfo.format = container.format;
+	imageCreateInfo.extent = { (uint32_t)container.width, (uint32_t)container.height, 1 };
+	imageCreateInfo.mipLevels = (uint32_t)container.mipCount;
+	imageCreateInfo.arrayLayers = (uint32_t)container.layerCount;
+	imageCreateInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+	imageCreateInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+	imageCreateInfo.usage = VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+	imageCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+	imageCreateInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+
+	VmaAllocationCreateInfo allocationCreateInfo{};
+	allocationCreateInfo.usage = VMA_MEMORY_USAGE_GPU_ONLY;
+	VulkanCheck(vmaCreateImage(backendData.allocator, &imageCreateInfo, &allocationCreateInfo, &texture->image.image,
+		&texture->image.allocation, nullptr));
+	texture->allocationSize = GetAllocationSize(backendData, texture->image.allocation);
+	rendererData->deviceLocalBytes += texture->allocationSize;
+
+	VkImageViewCreateInfo imageViewCreateInfo{};
+	imageViewCreateInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+	imageViewCreateInfo.image = texture->image.image;
+	imageViewCreateInfo.viewType = container.layerCount > 1 ? VK_IMAGE_VIEW_TYPE_2D_ARRAY : VK_IMAGE_VIEW_TYPE_2D;
+	imageViewCreateInfo.format = container.format;
+	imageViewCreateInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+	imageViewCreateInfo.subresourceRange.baseMipLevel = 0;
+	imageViewCreateInfo.subresourceRange.levelCount = (uint32_t)container.mipCount;
+	imageViewCreateInfo.subresourceRange.baseArrayLayer = 0;
+	imageViewCreateInfo.subresourceRange.layerCount = (uint32_t)container.layerCount;
+	VulkanCheck(vkCreateImageView(backendData.logicalDevice, &imageViewCreateInfo, nullptr, &texture->imageView));
+
+	texture->sampler = rendererData->objectCache.AcquireSampler(VK_FILTER_LINEAR, VK_FILTER_LINEAR, VK_BORDER_COLOR_INT_TRANSPARENT_BLACK,
+		VK_SAMPLER_ADDRESS_MODE_REPEAT, VK_SAMPLER_ADDRESS_MODE_REPEAT, VK_SAMPLER_ADDRESS_MODE_REPEAT, 0.f, (float)container.mipCount);
+
+	// Regions go straight from the mapping into staging, aligned for block sizes and transfer-only queues.
+	std::vector<VkDeviceSize> stagingOffsets(container.regions.size());
+	size_t stagingSize = 0;
+	for (int r = 0; r < container.regions.size(); ++r)
+	{
+		stagingOffsets[r] = stagingSize;
+		stagingSize = (stagingSize + container.regions[r].size + 15) & ~(size_t)15;
+	}
 
-	VulkanCheck(vkEndCommandBuffer(texture->generalCommandBuffer));
+	// The regions are copied out of the mapping without holding the upload manager's lock.
+	texture->uploadValue = rendererData->uploadManager.UploadFilled(stagingSize,
+		[&](uint8_t* stagingData)
+	{
+		for (int r = 0; r < container.regions.size(); ++r)
+		{
+			memcpy(stagingData + stagingOffsets[r], file.GetData() + container.regions[r].offset, container.regions[r].size);
+		}
+	},
+		[&](VkCommandBuffer commandBuffer, VkBuffer stagingBuffer, VkDeviceSize stagingOffset)
+	{
+		RecordImageLayoutTransition(commandBuffer, texture, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+			VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, VK_ACCESS_TRANSFER_WRITE_BIT);
 
-	// Queue submit.
-	VkSubmitInfo submitInfo{};
-	submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-	submitInfo.commandBufferCount = 1;
-	submitInfo.pCommandBuffers = &texture->generalCommandBuffer;
-	submitInfo.signalSemaphoreCount = 1;
-	submitInfo.pSignalSemaphores = &texture->operationSemaphore;
-	VulkanCheck(vkQueueSubmit(backendData.generalQueues[1], 1, &submitInfo, texture->uploadFence));
+		std::vector<VkBufferImageCopy> bufferImageCopies(container.regions.size());
+		for (int r = 0; r < container.regions.size(); ++r)
+		{
+			const TextureContainer::Region& region = container.regions[r];
+			VkBufferImageCopy& bufferImageCopy = bufferImageCopies[r];
+			bufferImageCopy = {};
+			bufferImageCopy.bufferOffset = stagingOffset + stagingOffsets[r];
+			bufferImageCopy.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+			bufferImageCopy.imageSubresource.mipLevel = region.mipLevel;
+			bufferImageCopy.imageSubresource.baseArrayLayer = region.layer;
+			bufferImageCopy.imageSubresource.layerCount = 1;
+			bufferImageCopy.imageExtent = { (uint32_t)std::max(container.width >> region.mipLevel, 1),
+				(uint32_t)std::max(container.height >> region.mipLevel, 1), 1 };
+		}
+		vkCmdCopyBufferToImage(commandBuffer, stagingBuffer, texture->image.image, texture->imageLayout,
+			(uint32_t)bufferImageCopies.size(), bufferImageCopies.data());
 
+		if (transferOwnership)
+		{
+			RecordImageOwnershipTransfer(commandBuffer, texture, rendererData->uploadFamilyIndex, backendData.generalFamilyIndex,
+				texture->imageLayout, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, true);
+			texture->imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+		}
+		else
+		{
+			RecordImageLayoutTransition(commandBuffer, texture, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+				VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, VK_ACCESS_TRANSFER_WRITE_BIT, 0);
+		}
+	});
+
+	TrackTextureOwnership(rendererData, texture, transferOwnership);
 	return texture;
 }
 
-void HawkEye::DeleteTexture(HRendererData rendererData, HTexture& texture)
+static void DestroyTextureResources(HawkEye::HRendererData rendererData, HawkEye::HTexture texture)
 {
-	const VulkanBackend::BackendData& backendData = *(VulkanBackend::BackendData*)rendererData;
-
-	WaitForUpload(rendererData, texture);
+	const VulkanBackend::BackendData& backendData = rendererData->backendData;
+	rendererData->deviceLocalBytes -= texture->allocationSize;
+	if (texture->bindlessIndex >= 0)
+	{
+		rendererData->bindlessSet.RemoveTexture(texture->bindlessIndex);
+	}
 
-	VulkanBackend::FreeCommandBuffer(backendData, backendData.generalCommandPool, texture->generalCommandBuffer);
-	VulkanBackend::DestroySemaphore(backendData, texture->operationSemaphore);
-	VulkanBackend::DestroySemaphore(backendData, texture->uploadSemaphore);
-	VulkanBackend::DestroyFence(backendData, texture->uploadFence);
-	VulkanBackend::DestroyBuffer(backendData, texture->stagingBuffer);
-	VulkanBackend::DestroyImageSampler(backendData, texture->sampler);
+	rendererData->objectCache.ReleaseSampler(texture->sampler);
 	VulkanBackend::DestroyImageView(backendData, texture->imageView);
 	VulkanBackend::DestroyImage(backendData, texture->image);
 
 	delete texture;
+}
+
+// Returns the buffer's range to its arena.
+static void ReleaseArenaRange(HawkEye::HBuffer buffer)
+{
+	HawkEye::HBufferArena arena = buffer->arena;
+	std::lock_guard<std::mutex> lock(arena->mutex);
+	auto& freeRanges = arena->freeRanges;
+	BufferArenaRange range{ buffer->offset, (int)buffer->allocationSize };
+
+	auto next = std::lower_bound(freeRanges.begin(), freeRanges.end(), range,
+		[](const BufferArenaRange& left, const BufferArenaRange& right) { return left.offset < right.offset; });
+	if (next != freeRanges.end() && range.offset + range.size == next->offset)
+	{
+		range.size += next->size;
+		next = freeRanges.erase(next);
+	}
+	if (next != freeRanges.begin() && (next - 1)->offset + (next - 1)->size == range.offset)
+	{
+		(next - 1)->size += range.size;
+	}
+	else
+	{
+		freeRanges.insert(next, range);
+	}
+	--arena->liveBufferCount;
+}
+
+static void DestroyBufferResources(HawkEye::HRendererData rendererData, HawkEye::HBuffer buffer)
+{
+	const VulkanBackend::BackendData& backendData = rendererData->backendData;
+	if (buffer->bindlessIndex >= 0)
+	{
+		rendererData->bindlessSet.RemoveBuffer(buffer->bindlessIndex);
+	}
+	if (buffer->arena)
+	{
+		ReleaseArenaRange(buffer);
+		delete buffer;
+		return;
+	}
+
+	if (buffer->mappedBuffer)
+	{
+		rendererData->hostVisibleBytes -= buffer->allocationSize;
+		vmaUnmapMemory(backendData.allocator, buffer->buffer.allocation);
+		buffer->mappedBuffer = nullptr;
+	}
+	else
+	{
+		rendererData->deviceLocalBytes -= buffer->allocationSize;
+	}
+	VulkanBackend::DestroyBuffer(backendData, buffer->buffer);
+
+	delete buffer;
+}
+
+static void DeferDeletion(HawkEye::HRendererData rendererData, uint64_t uploadValue, uint64_t graphicsValue,
+	HawkEye::HTexture texture, HawkEye::HBuffer buffer)
+{
+	std::lock_guard<std::mutex> lock(rendererData->deferredDeletionMutex);
+	rendererData->deferredDeletions.push_back({ uploadValue, graphicsValue, texture, buffer });
+}
+
+void ResourceUtils::CollectDeferredDeletions(HawkEye::HRendererData rendererData, bool waitForAll)
+{
+	std::lock_guard<std::mutex> lock(rendererData->deferredDeletionMutex);
+	auto& deletions = rendererData->deferredDeletions;
+	for (int d = (int)deletions.size() - 1; d >= 0; --d)
+	{
+		if (waitForAll)
+		{
+			rendererData->uploadManager.Wait(deletions[d].uploadValue);
+			rendererData->graphicsTimeline.Wait(deletions[d].graphicsValue);
+		}
+		else if (!rendererData->uploadTimeline.Reached(deletions[d].uploadValue) ||
+			!rendererData->graphicsTimeline.Reached(deletions[d].graphicsValue))
+		{
+			continue;
+		}
+
+		if (deletions[d].texture)
+		{
+			DestroyTextureResources(rendererData, deletions[d].texture);
+		}
+		if (deletions[d].buffer)
+		{
+			DestroyBufferResources(rendererData, deletions[d].buffer);
+		}
+
+		deletions[d] = deletions.back();
+		deletions.pop_back();
+	}
+}
+
+bool ResourceUtils::RecordPendingAcquisitions(HawkEye::HRendererData rendererData, VkCommandBuffer commandBuffer)
+{
+	const VulkanBackend::BackendData& backendData = rendererData->backendData;
+
+	std::lock_guard<std::mutex> lock(rendererData->pendingAcquisitionMutex);
+	auto& acquisitions = rendererData->pendingAcquisitions;
+	bool recorded = false;
+	for (int a = (int)acquisitions.size() - 1; a >= 0; --a)
+	{
+		// Textures are acquired once their upload completed, so that frames never wait for them on the GPU.
+		HawkEye::HTexture texture = acquisitions[a];
+		if (!HawkEye::UploadFinished(rendererData, texture))
+		{
+			continue;
+		}
+
+		RecordImageOwnershipTransfer(commandBuffer, texture, texture->currentFamilyIndex, backendData.generalFamilyIndex,
+			texture->imageLayout, texture->imageLayout, false);
+		if (texture->imageLayout == VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL)
+		{
+			GenerateTextureMips(backendData, commandBuffer, texture);
+		}
+
+		texture->currentFamilyIndex = backendData.generalFamilyIndex;
+		texture->firstUse = false;
+		acquisitions[a] = acquisitions.back();
+		acquisitions.pop_back();
+		recorded = true;
+	}
+	return recorded;
+}
+
+int ResourceUtils::GetBindlessIndex(HawkEye::HRendererData rendererData, HawkEye::HTexture texture)
+{
+	if (texture->bindlessIndex < 0 && rendererData->bindlessSet.IsAvailable())
+	{
+		texture->bindlessIndex = rendererData->bindlessSet.AddTexture(texture);
+	}
+	return texture->bindlessIndex;
+}
+
+int ResourceUtils::GetBindlessIndex(HawkEye::HRendererData rendererData, HawkEye::HBuffer buffer)
+{
+	if (buffer->bindlessIndex < 0 && rendererData->bindlessSet.IsAvailable())
+	{
+		ResourceUtils::WaitForRecording(rendererData, buffer->uploadValue);
+		buffer->bindlessIndex = rendererData->bindlessSet.AddBuffer(buffer);
+	}
+	return buffer->bindlessIndex;
+}
+
+void HawkEye::DeleteTexture(HRendererData rendererData, HTexture& texture)
+{
+	ResourceUtils::WaitForRecording(rendererData, texture->uploadValue);
+
+	{
+		std::lock_guard<std::mutex> lock(rendererData->pendingAcquisitionMutex);
+		auto& acquisitions = rendererData->pendingAcquisitions;
+		for (int a = 0; a < acquisitions.size(); ++a)
+		{
+			if (acquisitions[a] == texture)
+			{
+				acquisitions[a] = acquisitions.back();
+				acquisitions.pop_back();
+				break;
+			}
+		}
+	}
+
+	// Resources still being uploaded or used by submitted frames are destroyed once both timelines pass their values.
+	const uint64_t graphicsValue = rendererData->graphicsTimeline.GetSubmittedValue();
+	if (!UploadFinished(rendererData, texture) || !rendererData->graphicsTimeline.Reached(graphicsValue))
+	{
+		DeferDeletion(rendererData, texture->uploadValue, graphicsValue, texture, nullptr);
+	}
+	else
+	{
+		DestroyTextureResources(rendererData, texture);
+	}
 
 	texture = nullptr;
 }
 
 void HawkEye::WaitForUpload(HRendererData rendererData, HTexture texture)
 {
-	const VulkanBackend::BackendData& backendData = *(VulkanBackend::BackendData*)rendererData;
-
-	VulkanCheck(vkWaitForFences(backendData.logicalDevice, 1, &texture->uploadFence, VK_FALSE, UINT64_MAX));
+	ResourceUtils::WaitForRecording(rendererData, texture->uploadValue);
+	rendererData->uploadManager.Wait(texture->uploadValue);
 }
 
 bool HawkEye::UploadFinished(HRendererData rendererData, HTexture texture)
 {
-	const VulkanBackend::BackendData& backendData = *(VulkanBackend::BackendData*)rendererData;
+	return rendererData->uploadTimeline.Reached(texture->uploadValue);
+}
 
-	VkResult status = vkGetFenceStatus(backendData.logicalDevice, texture->uploadFence);
-	return status == VK_SUCCESS;
+int HawkEye::GetTextureDataSize(int width, int height, TextureFormat format, TextureCompression textureCompression)
+{
+	if (textureCompression != TextureCompression::None)
+	{
+		return ((width + 3) / 4) * ((height + 3) / 4) * BlockCompression::GetBlockSize(textureCompression);
+	}
+	return width * height * ((int)format + 1);
 }
 
-HawkEye::HBuffer HawkEye::UploadBuffer(HRendererData rendererData, void* data, int dataSize, BufferUsage usage,
-	BufferType type, BufferQueue bufferQueue)
+bool HawkEye::CompressTexture(HRendererData rendererData, const void* rgbaData, int width, int height,
+	TextureCompression textureCompression, void* compressedData)
 {
-	const VulkanBackend::BackendData& backendData = *(VulkanBackend::BackendData*)rendererData;
+	if (textureCompression == TextureCompression::None)
+	{
+		CoreLogError(DefaultLogger, "Texture compression: No block compression specified.");
+		return false;
+	}
 
-	HBuffer buffer = new HBuffer_t;
-	VkBufferUsageFlags bufferUsage{};
-	switch (usage)
+	// A few tasks per worker even out blocks of different cost. Only these tasks are waited for, uploads share the pool.
+	ThreadPool& threadPool = rendererData->textureThreadPool;
+	TaskGroup taskGroup;
+	const int blockRowCount = (height + 3) / 4;
+	const int taskCount = std::min(blockRowCount, threadPool.GetThreadCount() * 4);
+	for (int t = 0; t < taskCount; ++t)
 	{
-	case HawkEye::BufferUsage::Vertex:
-		bufferUsage = VK_BUFFER_USAGE_VERTEX_BUFFER_BIT;
-		break;
-	case HawkEye::BufferUsage::Index:
-		bufferUsage = VK_BUFFER_USAGE_INDEX_BUFFER_BIT;
-		break;
-	case HawkEye::BufferUsage::Uniform:
-		bufferUsage = VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT;
-		break;
-	case HawkEye::BufferUsage::Storage:
-		bufferUsage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT;
-		break;
-	default:
-		break;
+		const int firstBlockRow = blockRowCount * t / taskCount;
+		const int lastBlockRow = blockRowCount * (t + 1) / taskCount;
+		threadPool.Submit([=]()
+		{
+			BlockCompression::EncodeBlockRows((const uint8_t*)rgbaData, width, height, textureCompression,
+				firstBlockRow, lastBlockRow, (uint8_t*)compressedData);
+		}, taskGroup);
 	}
+	taskGroup.Wait();
+	return true;
+}
+
+// Returns the upload timeline value of the copy (0 if nothing was copied).
+static uint64_t RecordBufferUpload(HawkEye::HRendererData rendererData, HawkEye::HBuffer buffer, void* data, int dataSize,
+	HawkEye::BufferUsage usage, HawkEye::BufferType type, HawkEye::BufferQueue bufferQueue)
+{
+	const VulkanBackend::BackendData& backendData = rendererData->backendData;
+	const VkBufferUsageFlags bufferUsage = TranslateBufferUsage(usage);
 
 	buffer->dataSize = dataSize;
 
-	if (type == BufferType::Mapped)
+	if (type == HawkEye::BufferType::Mapped)
 	{
 		buffer->buffer = VulkanBackend::CreateBuffer(backendData, bufferUsage, dataSize, VMA_MEMORY_USAGE_CPU_TO_GPU);
+		buffer->allocationSize = GetAllocationSize(backendData, buffer->buffer.allocation);
+		rendererData->hostVisibleBytes += buffer->allocationSize;
 
 		VulkanCheck(vmaMapMemory(backendData.allocator, buffer->buffer.allocation, &buffer->mappedBuffer));
 		if (data)
@@ -217,131 +814,264 @@ HawkEye::HBuffer HawkEye::UploadBuffer(HRendererData rendererData, void* data, i
 			memcpy(buffer->mappedBuffer, data, dataSize);
 		}
 
-		return buffer;
+		return 0;
 	}
 
-	buffer->buffer = VulkanBackend::CreateBuffer(backendData, VK_BUFFER_USAGE_TRANSFER_DST_BIT | bufferUsage, dataSize,
-		VMA_MEMORY_USAGE_GPU_ONLY);
-	buffer->stagingBuffer = VulkanBackend::CreateBuffer(backendData, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-		dataSize, VMA_MEMORY_USAGE_CPU_ONLY);
+	buffer->buffer = CreateDeviceLocalBuffer(rendererData, VK_BUFFER_USAGE_TRANSFER_DST_BIT | bufferUsage, dataSize);
+	buffer->allocationSize = GetAllocationSize(backendData, buffer->buffer.allocation);
+	rendererData->deviceLocalBytes += buffer->allocationSize;
 
-	// Copy data to staging buffer.
+	// Staging memory comes from the upload manager's ring and is reclaimed as soon as the copy finishes.
+	uint64_t uploadValue = 0;
 	if (data)
 	{
-		void* stagingBufferData;
-		VulkanCheck(vmaMapMemory(backendData.allocator, buffer->stagingBuffer.allocation, &stagingBufferData));
-		memcpy(stagingBufferData, data, dataSize);
-		vmaUnmapMemory(backendData.allocator, buffer->stagingBuffer.allocation);
-
-		buffer->uploadFence = VulkanBackend::CreateFence(backendData);
-
-		buffer->generalCommandBuffer = VulkanBackend::AllocateCommandBuffer(backendData, backendData.generalCommandPool);
-
-		// All in a single command buffer.
-		VkCommandBufferBeginInfo commandBufferBeginInfo{};
-		commandBufferBeginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
-		VulkanCheck(vkBeginCommandBuffer(buffer->generalCommandBuffer, &commandBufferBeginInfo));
-
-		VulkanBackend::CopyBufferToBuffer(backendData, buffer->stagingBuffer.buffer, buffer->buffer.buffer, dataSize,
-			buffer->generalCommandBuffer);
+		uploadValue = rendererData->uploadManager.Upload(data, dataSize,
+			[&](VkCommandBuffer commandBuffer, VkBuffer stagingBuffer, VkDeviceSize stagingOffset)
+		{
+			VkBufferCopy bufferCopy{ stagingOffset, 0, (VkDeviceSize)dataSize };
+			vkCmdCopyBuffer(commandBuffer, stagingBuffer, buffer->buffer.buffer, 1, &bufferCopy);
+		});
+		RequireUploadForFrames(rendererData, uploadValue);
 
 		buffer->currentFamilyIndex = backendData.generalFamilyIndex;
-
-		VulkanCheck(vkEndCommandBuffer(buffer->generalCommandBuffer));
-
-		// Queue submit.
-		VkSubmitInfo submitInfo{};
-		submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-		submitInfo.commandBufferCount = 1;
-		submitInfo.pCommandBuffers = &buffer->generalCommandBuffer;
-
-		VulkanCheck(vkQueueSubmit(backendData.generalQueues[1], 1, &submitInfo, buffer->uploadFence));
 	}
 	else
 	{
-		buffer->uploadFence = VulkanBackend::CreateFence(backendData, VK_FENCE_CREATE_SIGNALED_BIT);
-		buffer->currentFamilyIndex = bufferQueue == BufferQueue::General ? backendData.generalFamilyIndex :
+		buffer->currentFamilyIndex = bufferQueue == HawkEye::BufferQueue::General ? backendData.generalFamilyIndex :
 			backendData.computeFamilyIndex;
 	}
 
+	return uploadValue;
+}
+
+HawkEye::HBuffer HawkEye::UploadBuffer(HRendererData rendererData, void* data, int dataSize, BufferUsage usage,
+	BufferType type, BufferQueue bufferQueue)
+{
+	HBuffer buffer = new HBuffer_t;
+	buffer->uploadValue = RecordBufferUpload(rendererData, buffer, data, dataSize, usage, type, bufferQueue);
 	return buffer;
 }
 
-void HawkEye::DeleteBuffer(HRendererData rendererData, HBuffer& buffer)
+HawkEye::HBuffer HawkEye::UploadBufferAsync(HRendererData rendererData, void* data, int dataSize, BufferUsage usage,
+	BufferType type, BufferQueue bufferQueue, std::function<void(HBuffer)> onRecorded)
 {
-	const VulkanBackend::BackendData& backendData = *(VulkanBackend::BackendData*)rendererData;
+	HBuffer buffer = new HBuffer_t;
+	buffer->uploadValue = ResourceUtils::recordingUploadValue;
+	rendererData->uploadThreadPool.Submit([=]()
+	{
+		PublishUploadValue(rendererData, buffer->uploadValue, RecordBufferUpload(rendererData, buffer, data, dataSize,
+			usage, type, bufferQueue));
+		if (onRecorded)
+		{
+			onRecorded(buffer);
+		}
+	});
+	return buffer;
+}
 
-	WaitForUpload(rendererData, buffer);
+void HawkEye::DeleteBuffer(HRendererData rendererData, HBuffer& buffer)
+{
+	ResourceUtils::WaitForRecording(rendererData, buffer->uploadValue);
 
-	if (buffer->uploadFence != VK_NULL_HANDLE)
+	const uint64_t graphicsValue = rendererData->graphicsTimeline.GetSubmittedValue();
+	if (!UploadFinished(rendererData, buffer) || !rendererData->graphicsTimeline.Reached(graphicsValue))
 	{
-		VulkanBackend::FreeCommandBuffer(backendData, backendData.generalCommandPool, buffer->generalCommandBuffer);
-		VulkanBackend::DestroyFence(backendData, buffer->uploadFence);
-		VulkanBackend::DestroyBuffer(backendData, buffer->stagingBuffer);
+		DeferDeletion(rendererData, buffer->uploadValue, graphicsValue, nullptr, buffer);
 	}
 	else
 	{
-		vmaUnmapMemory(backendData.allocator, buffer->buffer.allocation);
-		buffer->mappedBuffer = nullptr;
+		DestroyBufferResources(rendererData, buffer);
 	}
-	VulkanBackend::DestroyBuffer(backendData, buffer->buffer);
-
-	delete buffer;
 
 	buffer = nullptr;
 }
 
 void HawkEye::UpdateBuffer(HRendererData rendererData, HBuffer buffer, void* data, int dataSize)
 {
-	if (dataSize > buffer->dataSize)
+	UpdateBuffer(rendererData, buffer, 0, data, dataSize);
+}
+
+void HawkEye::UpdateBuffer(HRendererData rendererData, HBuffer buffer, int offset, void* data, int dataSize)
+{
+	if (offset < 0 || offset + dataSize > buffer->dataSize)
 	{
-		CoreLogError(DefaultLogger, "Data upload: Specified data size is bigger than buffer size.");
+		CoreLogError(DefaultLogger, "Data upload: Specified range is outside of the buffer.");
 		return;
 	}
 
+	ResourceUtils::WaitForRecording(rendererData, buffer->uploadValue);
+
 	if (buffer->mappedBuffer)
 	{
-		memcpy(buffer->mappedBuffer, data, dataSize);
+		memcpy((uint8_t*)buffer->mappedBuffer + offset, data, dataSize);
 	}
 	else
 	{
-		// TODO: Probably memory barrier.
-		const VulkanBackend::BackendData& backendData = *(VulkanBackend::BackendData*)rendererData;
+		// Every update gets its own staging memory, so there is no need to wait for the previous one.
+		// The copy waits on the GPU for the frames already submitted, which may still read the old data. Only waiting copies
+		// go into the upload manager's waiting batch, along with the ones that must follow an unfinished copy.
+		const TimelineWait graphicsWait{ &rendererData->graphicsTimeline, rendererData->graphicsTimeline.GetSubmittedValue(),
+			VK_PIPELINE_STAGE_TRANSFER_BIT };
+		const bool previousCopyPending = !rendererData->uploadTimeline.Reached(buffer->uploadValue);
+		const bool waitForGraphics = !rendererData->graphicsTimeline.Reached(graphicsWait.value) || previousCopyPending;
+		buffer->uploadValue = rendererData->uploadManager.Upload(data, dataSize,
+			[&](VkCommandBuffer commandBuffer, VkBuffer stagingBuffer, VkDeviceSize stagingOffset)
+		{
+			// Copies are not ordered, so a write following an unfinished one waits for it. The barrier also orders
+			// against copies of earlier submits on the upload queue.
+			if (previousCopyPending)
+			{
+				VkMemoryBarrier memoryBarrier{};
+				memoryBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+				memoryBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+				memoryBarrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+				vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0,
+					1, &memoryBarrier, 0, nullptr, 0, nullptr);
+			}
+
+			VkBufferCopy bufferCopy{ stagingOffset, (VkDeviceSize)(buffer->offset + offset), (VkDeviceSize)dataSize };
+			vkCmdCopyBuffer(commandBuffer, stagingBuffer, buffer->buffer.buffer, 1, &bufferCopy);
+		}, waitForGraphics ? &graphicsWait : nullptr);
+		RequireUploadForFrames(rendererData, buffer->uploadValue);
+	}
+}
 
-		WaitForUpload(rendererData, buffer);
-		vkResetFences(backendData.logicalDevice, 1, &buffer->uploadFence);
+HawkEye::HBufferArena HawkEye::CreateBufferArena(HRendererData rendererData, int size, BufferUsage usage)
+{
+	const VulkanBackend::BackendData& backendData = rendererData->backendData;
 
-		{
-			void* stagingBufferData;
-			VulkanCheck(vmaMapMemory(backendData.allocator, buffer->stagingBuffer.allocation, &stagingBufferData));
-			memcpy(stagingBufferData, data, dataSize);
-			vmaUnmapMemory(backendData.allocator, buffer->stagingBuffer.allocation);
-		}
+	VkBufferUsageFlags bufferUsage = TranslateBufferUsage(usage);
+	if (usage == BufferUsage::Vertex || usage == BufferUsage::Index)
+	{
+		bufferUsage = VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT;
+	}
 
-		// Queue submit.
-		VkSubmitInfo submitInfo{};
-		submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-		submitInfo.commandBufferCount = 1;
-		submitInfo.pCommandBuffers = &buffer->generalCommandBuffer;
+	// Uniform and storage ranges are bound at their offsets, which have to respect the device limits (powers of two).
+	VkPhysicalDeviceProperties physicalDeviceProperties;
+	vkGetPhysicalDeviceProperties(backendData.physicalDevice, &physicalDeviceProperties);
+	int alignment = arenaAlignment;
+	if (usage == BufferUsage::Uniform)
+	{
+		alignment = std::max(alignment, (int)physicalDeviceProperties.limits.minUniformBufferOffsetAlignment);
+	}
+	else if (usage == BufferUsage::Storage)
+	{
+		alignment = std::max(alignment, (int)physicalDeviceProperties.limits.minStorageBufferOffsetAlignment);
+	}
 
-		VulkanCheck(vkQueueSubmit(backendData.generalQueues[0], 1, &submitInfo, buffer->uploadFence));
+	HBufferArena arena = new HBufferArena_t;
+	arena->alignment = alignment;
+	arena->buffer = CreateDeviceLocalBuffer(rendererData, VK_BUFFER_USAGE_TRANSFER_DST_BIT | bufferUsage, size);
+	arena->allocationSize = GetAllocationSize(backendData, arena->buffer.allocation);
+	rendererData->deviceLocalBytes += arena->allocationSize;
+	arena->freeRanges.push_back({ 0, size });
+	return arena;
+}
+
+void HawkEye::DeleteBufferArena(HRendererData rendererData, HBufferArena& arena)
+{
+	if (arena->liveBufferCount > 0)
+	{
+		// Buffers deleted while frames still used them only release their ranges once those frames finish.
+		ResourceUtils::CollectDeferredDeletions(rendererData, true);
 	}
+	if (arena->liveBufferCount > 0)
+	{
+		CoreLogError(DefaultLogger, "Buffer arena: Trying to delete an arena with %d live buffers.", arena->liveBufferCount);
+		return;
+	}
+
+	rendererData->deviceLocalBytes -= arena->allocationSize;
+	VulkanBackend::DestroyBuffer(rendererData->backendData, arena->buffer);
+
+	delete arena;
+	arena = nullptr;
 }
 
-void HawkEye::WaitForUpload(HRendererData rendererData, HBuffer buffer)
+HawkEye::HBuffer HawkEye::UploadBuffer(HRendererData rendererData, HBufferArena arena, void* data, int dataSize)
 {
-	if (buffer->uploadFence != VK_NULL_HANDLE)
+	const VulkanBackend::BackendData& backendData = rendererData->backendData;
+	// Ranges start at multiples of the alignment as long as their sizes are multiples of it.
+	const int alignedSize = (dataSize + arena->alignment - 1) & ~(arena->alignment - 1);
+
+	HBuffer buffer = nullptr;
+	{
+		// First fit, ranges are merged on release so the arena does not fragment into slivers.
+		std::lock_guard<std::mutex> lock(arena->mutex);
+		auto& freeRanges = arena->freeRanges;
+		for (int r = 0; r < freeRanges.size(); ++r)
+		{
+			if (freeRanges[r].size < alignedSize)
+			{
+				continue;
+			}
+
+			buffer = new HBuffer_t;
+			buffer->offset = freeRanges[r].offset;
+			freeRanges[r].offset += alignedSize;
+			freeRanges[r].size -= alignedSize;
+			if (freeRanges[r].size == 0)
+			{
+				freeRanges.erase(freeRanges.begin() + r);
+			}
+			++arena->liveBufferCount;
+			break;
+		}
+	}
+
+	if (!buffer)
 	{
-		const VulkanBackend::BackendData& backendData = *(VulkanBackend::BackendData*)rendererData;
+		CoreLogError(DefaultLogger, "Buffer arena: No free range for %d bytes.", dataSize);
+		return nullptr;
+	}
+
+	buffer->buffer.buffer = arena->buffer.buffer;
+	buffer->arena = arena;
+	// The arena's memory is accounted for as a whole, this is the size of the range.
+	buffer->allocationSize = alignedSize;
+	buffer->dataSize = dataSize;
+	buffer->currentFamilyIndex = backendData.generalFamilyIndex;
 
-		VulkanCheck(vkWaitForFences(backendData.logicalDevice, 1, &buffer->uploadFence, VK_FALSE, UINT64_MAX));
+	if (data)
+	{
+		buffer->uploadValue = rendererData->uploadManager.Upload(data, dataSize,
+			[&](VkCommandBuffer commandBuffer, VkBuffer stagingBuffer, VkDeviceSize stagingOffset)
+		{
+			VkBufferCopy bufferCopy{ stagingOffset, (VkDeviceSize)buffer->offset, (VkDeviceSize)dataSize };
+			vkCmdCopyBuffer(commandBuffer, stagingBuffer, buffer->buffer.buffer, 1, &bufferCopy);
+		});
+		RequireUploadForFrames(rendererData, buffer->uploadValue);
 	}
+
+	return buffer;
+}
+
+void HawkEye::WaitForUpload(HRendererData rendererData, HBuffer buffer)
+{
+	ResourceUtils::WaitForRecording(rendererData, buffer->uploadValue);
+	rendererData->uploadManager.Wait(buffer->uploadValue);
 }
 
 bool HawkEye::UploadFinished(HRendererData rendererData, HBuffer buffer)
 {
-	const VulkanBackend::BackendData& backendData = *(VulkanBackend::BackendData*)rendererData;
+	return rendererData->uploadTimeline.Reached(buffer->uploadValue);
+}
+
+void HawkEye::FlushUploads(HRendererData rendererData)
+{
+	rendererData->uploadManager.Flush();
+}
 
-	VkResult status = vkGetFenceStatus(backendData.logicalDevice, buffer->uploadFence);
-	return status == VK_SUCCESS;
+HawkEye::UploadStatistics HawkEye::GetUploadStatistics(HRendererData rendererData)
+{
+	return rendererData->uploadManager.GetStatistics();
+}
+
+HawkEye::MemoryReport HawkEye::GetMemoryReport(HRendererData rendererData)
+{
+	MemoryReport memoryReport{};
+	rendererData->uploadManager.GetStagingUsage(memoryReport.stagingBytes, memoryReport.stagingBytesInUse);
+	memoryReport.deviceLocalBytes = rendererData->deviceLocalBytes;
+	memoryReport.hostVisibleBytes = rendererData->hostVisibleBytes;
+	return memoryReport;
 }
@@ -1,6 +1,10 @@
 #pragma once
 #include <VulkanBackend/VulkanBackendAPI.hpp>
+#include <atomic>
+#include <cstdint>
+#include <mutex>
 #include <unordered_map>
+#include <vector>
 
 struct HawkEye::HTexture_t
 {
@@ -8,25 +12,72 @@ struct HawkEye::HTexture_t
 	VkImageView imageView = VK_NULL_HANDLE;
 	VkSampler sampler = VK_NULL_HANDLE;
 	VkImageLayout imageLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-	VkFence uploadFence = VK_NULL_HANDLE;
-	VkCommandBuffer generalCommandBuffer = VK_NULL_HANDLE;
-	VulkanBackend::Buffer stagingBuffer{};
-	VkSemaphore operationSemaphore = VK_NULL_HANDLE;
-	VkSemaphore uploadSemaphore = VK_NULL_HANDLE;
+	// Upload timeline value signaled once the upload finishes (0 if there is nothing to wait for).
+	std::atomic<uint64_t> uploadValue{ 0 };
+	uint64_t allocationSize = 0;
+	int width = 0;
+	int height = 0;
+	VkFormat format = VK_FORMAT_UNDEFINED;
 	int mipCount = 1;
+	int layerCount = 1;
+	// Set while the texture waits to be acquired from the upload queue family (mips are generated on acquisition).
 	bool firstUse = true;
 	int currentFamilyIndex;
 	TextureQueue currentUsage;
+	// Slot in the bindless set, assigned when first referenced (-1 until then).
+	int bindlessIndex = -1;
 };
 
 struct HawkEye::HBuffer_t
 {
 	VulkanBackend::Buffer buffer{};
-	VkFence uploadFence = VK_NULL_HANDLE;
-	VkCommandBuffer generalCommandBuffer = VK_NULL_HANDLE;
-	VulkanBackend::Buffer stagingBuffer{};
+	// Upload timeline value signaled once the last upload finishes (0 if there is nothing to wait for).
+	std::atomic<uint64_t> uploadValue{ 0 };
+	uint64_t allocationSize = 0;
 	void* mappedBuffer = nullptr;
 	int dataSize = 0;
 	bool firstUse = true;
 	int currentFamilyIndex;
+	// Set for buffers sub-allocated from an arena, whose buffer is shared with the rest of the arena.
+	HawkEye::HBufferArena arena = nullptr;
+	int offset = 0;
+	// Slot in the bindless set, assigned when first referenced (-1 until then).
+	int bindlessIndex = -1;
 };
+
+struct BufferArenaRange
+{
+	int offset;
+	int size;
+};
+
+struct HawkEye::HBufferArena_t
+{
+	VulkanBackend::Buffer buffer{};
+	uint64_t allocationSize = 0;
+	// Granularity of the ranges, depends on the usage.
+	int alignment = 0;
+	// Sorted by offset, neighbouring ranges are merged when a buffer is released.
+	std::vector<BufferArenaRange> freeRanges;
+	int liveBufferCount = 0;
+	std::mutex mutex;
+};
+
+namespace ResourceUtils
+{
+	// Upload value of resources whose asynchronous upload has not been recorded yet.
+	constexpr uint64_t recordingUploadValue = UINT64_MAX;
+
+	// Blocks until a worker has recorded the asynchronous upload, the resource's handles are valid afterwards.
+	void WaitForRecording(HawkEye::HRendererData rendererData, const std::atomic<uint64_t>& uploadValue);
+
+	// Destroys resources whose deletion was deferred until their uploads and the frames using them finished.
+	void CollectDeferredDeletions(HawkEye::HRendererData rendererData, bool waitForAll);
+	// Records the acquisition of textures released by the upload queue family into the (begun) command buffer.
+	// Textures still being uploaded stay pending. Returns false if nothing was recorded.
+	bool RecordPendingAcquisitions(HawkEye::HRendererData rendererData, VkCommandBuffer commandBuffer);
+	// Adds the resource to the bindless set on first use. Returns -1 if the set is unavailable or full.
+	// Texture slots hold a placeholder until the upload completes.
+	int GetBindlessIndex(HawkEye::HRendererData rendererData, HawkEye::HTexture texture);
+	int GetBindlessIndex(HawkEye::HRendererData rendererData, HawkEye::HBuffer buffer);
+}
@@ -0,0 +1,370 @@
+#include "TextureContainer.hpp"
+#include <SoftwareCore/DefaultLogger.hpp>
+#include <algorithm>
+#include <cstring>
+
+// Both containers are little-endian.
+static uint32_t ReadUInt32(const uint8_t* data)
+{
+	uint32_t value;
+	memcpy(&value, data, sizeof(value));
+	return value;
+}
+
+static uint64_t ReadUInt64(const uint8_t* data)
+{
+	uint64_t value;
+	memcpy(&value, data, sizeof(value));
+	return value;
+}
+
+static constexpr uint32_t MakeFourCC(char a, char b, char c, char d)
+{
+	return (uint32_t)a | ((uint32_t)b << 8) | ((uint32_t)c << 16) | ((uint32_t)d << 24);
+}
+
+// Bytes per block and the block's extent in texels (1 for uncompressed formats).
+static bool GetFormatBlockInfo(VkFormat format, int& blockSize, int& blockExtent)
+{
+	blockExtent = 1;
+	switch (format)
+	{
+	case VK_FORMAT_R8_UNORM:
+		blockSize = 1;
+		return true;
+	case VK_FORMAT_R8G8_UNORM:
+		blockSize = 2;
+		return true;
+	case VK_FORMAT_R8G8B8A8_UNORM:
+	case VK_FORMAT_R8G8B8A8_SRGB:
+	case VK_FORMAT_B8G8R8A8_UNORM:
+	case VK_FORMAT_B8G8R8A8_SRGB:
+		blockSize = 4;
+		return true;
+	case VK_FORMAT_R16G16B16A16_SFLOAT:
+		blockSize = 8;
+		return true;
+	case VK_FORMAT_R32G32B32A32_SFLOAT:
+		blockSize = 16;
+		return true;
+	default:
+		break;
+	}
+
+	blockExtent = 4;
+	switch (format)
+	{
+	case VK_FORMAT_BC1_RGBA_UNORM_BLOCK:
+	case VK_FORMAT_BC1_RGBA_SRGB_BLOCK:
+	case VK_FORMAT_BC4_UNORM_BLOCK:
+	case VK_FORMAT_BC4_SNORM_BLOCK:
+		blockSize = 8;
+		return true;
+	case VK_FORMAT_BC2_UNORM_BLOCK:
+	case VK_FORMAT_BC2_SRGB_BLOCK:
+	case VK_FORMAT_BC3_UNORM_BLOCK:
+	case VK_FORMAT_BC3_SRGB_BLOCK:
+	case VK_FORMAT_BC5_UNORM_BLOCK:
+	case VK_FORMAT_BC5_SNORM_BLOCK:
+	case VK_FORMAT_BC6H_UFLOAT_BLOCK:
+	case VK_FORMAT_BC6H_SFLOAT_BLOCK:
+	case VK_FORMAT_BC7_UNORM_BLOCK:
+	case VK_FORMAT_BC7_SRGB_BLOCK:
+		blockSize = 16;
+		return true;
+	default:
+		return false;
+	}
+}
+
+static size_t GetRegionSize(const TextureContainer& container, int mipLevel, int blockSize, int blockExtent)
+{
+	const size_t blocksWide = (std::max(container.width >> mipLevel, 1) + blockExtent - 1) / blockExtent;
+	const size_t blocksHigh = (std::max(container.height >> mipLevel, 1) + blockExtent - 1) / blockExtent;
+	return blocksWide * blocksHigh * blockSize;
+}
+
+static VkFormat TranslateDXGIFormat(uint32_t dxgiFormat)
+{
+	switch (dxgiFormat)
+	{
+	case 2:
+		return VK_FORMAT_R32G32B32A32_SFLOAT;
+	case 10:
+		return VK_FORMAT_R16G16B16A16_SFLOAT;
+	case 28:
+		return VK_FORMAT_R8G8B8A8_UNORM;
+	case 29:
+		return VK_FORMAT_R8G8B8A8_SRGB;
+	case 49:
+		return VK_FORMAT_R8G8_UNORM;
+	case 61:
+		return VK_FORMAT_R8_UNORM;
+	case 71:
+		return VK_FORMAT_BC1_RGBA_UNORM_BLOCK;
+	case 72:
+		return VK_FORMAT_BC1_RGBA_SRGB_BLOCK;
+	case 74:
+		return VK_FORMAT_BC2_UNORM_BLOCK;
+	case 75:
+		return VK_FORMAT_BC2_SRGB_BLOCK;
+	case 77:
+		return VK_FORMAT_BC3_UNORM_BLOCK;
+	case 78:
+		return VK_FORMAT_BC3_SRGB_BLOCK;
+	case 80:
+		return VK_FORMAT_BC4_UNORM_BLOCK;
+	case 81:
+		return VK_FORMAT_BC4_SNORM_BLOCK;
+	case 83:
+		return VK_FORMAT_BC5_UNORM_BLOCK;
+	case 84:
+		return VK_FORMAT_BC5_SNORM_BLOCK;
+	case 87:
+		return VK_FORMAT_B8G8R8A8_UNORM;
+	case 91:
+		return VK_FORMAT_B8G8R8A8_SRGB;
+	case 95:
+		return VK_FORMAT_BC6H_UFLOAT_BLOCK;
+	case 96:
+		return VK_FORMAT_BC6H_SFLOAT_BLOCK;
+	case 98:
+		return VK_FORMAT_BC7_UNORM_BLOCK;
+	case 99:
+		return VK_FORMAT_BC7_SRGB_BLOCK;
+	default:
+		return VK_FORMAT_UNDEFINED;
+	}
+}
+
+// Dimensions are checked before they are narrowed, image extents beyond 2^16 are not supported by any device anyway.
+// The level count is bounded by the extent, not only by the device limit (which depends on the format alone).
+static bool ValidDimensions(uint32_t width, uint32_t height, uint32_t layerCount, uint32_t mipCount)
+{
+	const uint32_t maxExtent = 1 << 16;
+	if (width == 0 || height == 0 || width > maxExtent || height > maxExtent || layerCount == 0 || layerCount > maxExtent)
+	{
+		return false;
+	}
+	uint32_t maxMipCount = 1;
+	while ((std::max(width, height) >> maxMipCount) > 0)
+	{
+		++maxMipCount;
+	}
+	return mipCount > 0 && mipCount <= maxMipCount;
+}
+
+static bool ParseKTX2(const uint8_t* data, size_t size, TextureContainer& container)
+{
+	const size_t levelIndexOffset = 80;
+	if (size < levelIndexOffset)
+	{
+		CoreLogError(DefaultLogger, "KTX2: Truncated header.");
+		return false;
+	}
+
+	const uint32_t width = ReadUInt32(data + 20);
+	const uint32_t height = std::max(ReadUInt32(data + 24), 1u);
+	const uint32_t depth = ReadUInt32(data + 28);
+	const uint32_t layerCount = std::max(ReadUInt32(data + 32), 1u);
+	const uint32_t faceCount = ReadUInt32(data + 36);
+	// Zero levels asks the loader to generate the mips, only the base level is stored then.
+	const uint32_t mipCount = std::max(ReadUInt32(data + 40), 1u);
+	const uint32_t supercompressionScheme = ReadUInt32(data + 44);
+
+	container.format = (VkFormat)ReadUInt32(data + 12);
+	int blockSize;
+	int blockExtent;
+	if (container.format == VK_FORMAT_UNDEFINED || supercompressionScheme != 0)
+	{
+		CoreLogError(DefaultLogger, "KTX2: Basis Universal and supercompressed files are not supported.");
+		return false;
+	}
+	if (!GetFormatBlockInfo(container.format, blockSize, blockExtent))
+	{
+		CoreLogError(DefaultLogger, "KTX2: Unsupported pixel format %d.", (int)container.format);
+		return false;
+	}
+	if (depth > 1 || faceCount != 1)
+	{
+		CoreLogError(DefaultLogger, "KTX2: 3D textures and cubemaps are not supported.");
+		return false;
+	}
+	if (!ValidDimensions(width, height, layerCount, mipCount))
+	{
+		CoreLogError(DefaultLogger, "KTX2: Invalid dimensions (%u x %u, %u layers, %u levels).", width, height, layerCount, mipCount);
+		return false;
+	}
+	container.width = (int)width;
+	container.height = (int)height;
+	container.layerCount = (int)layerCount;
+	container.mipCount = (int)mipCount;
+
+	if (levelIndexOffset + (size_t)container.mipCount * 24 > size)
+	{
+		CoreLogError(DefaultLogger, "KTX2: Truncated level index.");
+		return false;
+	}
+
+	// Every level holds all of its layers one after another.
+	for (int m = 0; m < container.mipCount; ++m)
+	{
+		const uint64_t levelOffset = ReadUInt64(data + levelIndexOffset + m * 24);
+		const uint64_t levelSize = ReadUInt64(data + levelIndexOffset + m * 24 + 8);
+		// Written so that neither side can overflow.
+		if (levelOffset > size || levelSize > size - levelOffset)
+		{
+			CoreLogError(DefaultLogger, "KTX2: Level %d lies outside of the file.", m);
+			return false;
+		}
+
+		// The copies read whole layers, so a level that is too short would let them read past its end.
+		const size_t layerSize = GetRegionSize(container, m, blockSize, blockExtent);
+		if (levelSize / container.layerCount < layerSize)
+		{
+			CoreLogError(DefaultLogger, "KTX2: Level %d is smaller than its extent.", m);
+			return false;
+		}
+		for (int l = 0; l < container.layerCount; ++l)
+		{
+			container.regions.push_back({ (size_t)levelOffset + l * layerSize, layerSize, m, l });
+		}
+	}
+	return true;
+}
+
+static bool ParseDDS(const uint8_t* data, size_t size, TextureContainer& container)
+{
+	const size_t headerSize = 128;
+	if (size < headerSize)
+	{
+		CoreLogError(DefaultLogger, "DDS: Truncated header.");
+		return false;
+	}
+
+	const uint32_t height = ReadUInt32(data + 12);
+	const uint32_t width = ReadUInt32(data + 16);
+	const uint32_t mipCount = std::max(ReadUInt32(data + 28), 1u);
+	uint32_t layerCount = 1;
+	const uint32_t pixelFormatFlags = ReadUInt32(data + 80);
+	const uint32_t fourCC = ReadUInt32(data + 84);
+	const uint32_t caps2 = ReadUInt32(data + 112);
+
+	const uint32_t fourCCFlag = 0x4;
+	const uint32_t rgbFlag = 0x40;
+	const uint32_t luminanceFlag = 0x20000;
+	const uint32_t cubemapFlag = 0x200;
+	const uint32_t volumeFlag = 0x200000;
+	if (caps2 & (cubemapFlag | volumeFlag))
+	{
+		CoreLogError(DefaultLogger, "DDS: 3D textures and cubemaps are not supported.");
+		return false;
+	}
+
+	size_t dataOffset = headerSize;
+	if ((pixelFormatFlags & fourCCFlag) && fourCC == MakeFourCC('D', 'X', '1', '0'))
+	{
+		const size_t extendedHeaderSize = 20;
+		if (size < headerSize + extendedHeaderSize)
+		{
+			CoreLogError(DefaultLogger, "DDS: Truncated DX10 header.");
+			return false;
+		}
+		container.format = TranslateDXGIFormat(ReadUInt32(data + 128));
+		const uint32_t resourceDimension = ReadUInt32(data + 132);
+		const uint32_t miscFlags = ReadUInt32(data + 136);
+		layerCount = std::max(ReadUInt32(data + 140), 1u);
+		// Only 2D textures, without the cube flag.
+		if (resourceDimension != 3 || (miscFlags & 0x4))
+		{
+			CoreLogError(DefaultLogger, "DDS: Only 2D textures and 2D texture arrays are supported.");
+			return false;
+		}
+		dataOffset += extendedHeaderSize;
+	}
+	else if (pixelFormatFlags & fourCCFlag)
+	{
+		switch (fourCC)
+		{
+		case MakeFourCC('D', 'X', 'T', '1'):
+			container.format = VK_FORMAT_BC1_RGBA_UNORM_BLOCK;
+			break;
+		case MakeFourCC('D', 'X', 'T', '3'):
+			container.format = VK_FORMAT_BC2_UNORM_BLOCK;
+			break;
+		case MakeFourCC('D', 'X', 'T', '5'):
+			container.format = VK_FORMAT_BC3_UNORM_BLOCK;
+			break;
+		case MakeFourCC('A', 'T', 'I', '1'):
+		case MakeFourCC('B', 'C', '4', 'U'):
+			container.format = VK_FORMAT_BC4_UNORM_BLOCK;
+			break;
+		case MakeFourCC('A', 'T', 'I', '2'):
+		case MakeFourCC('B', 'C', '5', 'U'):
+			container.format = VK_FORMAT_BC5_UNORM_BLOCK;
+			break;
+		default:
+			break;
+		}
+	}
+	else if ((pixelFormatFlags & rgbFlag) && ReadUInt32(data + 88) == 32)
+	{
+		// The red mask tells RGBA and BGRA apart.
+		container.format = ReadUInt32(data + 92) == 0xFF ? VK_FORMAT_R8G8B8A8_UNORM : VK_FORMAT_B8G8R8A8_UNORM;
+	}
+	else if ((pixelFormatFlags & luminanceFlag) && ReadUInt32(data + 88) == 8)
+	{
+		container.format = VK_FORMAT_R8_UNORM;
+	}
+
+	int blockSize;
+	int blockExtent;
+	if (container.format == VK_FORMAT_UNDEFINED || !GetFormatBlockInfo(container.format, blockSize, blockExtent))
+	{
+		CoreLogError(DefaultLogger, "DDS: Unsupported pixel format.");
+		return false;
+	}
+	if (!ValidDimensions(width, height, layerCount, mipCount))
+	{
+		CoreLogError(DefaultLogger, "DDS: Invalid dimensions (%u x %u, %u layers, %u levels).", width, height, layerCount, mipCount);
+		return false;
+	}
+	container.width = (int)width;
+	container.height = (int)height;
+	container.layerCount = (int)layerCount;
+	container.mipCount = (int)mipCount;
+
+	// Every layer holds its whole mip chain.
+	size_t offset = dataOffset;
+	for (int l = 0; l < container.layerCount; ++l)
+	{
+		for (int m = 0; m < container.mipCount; ++m)
+		{
+			const size_t regionSize = GetRegionSize(container, m, blockSize, blockExtent);
+			if (regionSize > size - offset)
+			{
+				CoreLogError(DefaultLogger, "DDS: Level %d of layer %d lies outside of the file.", m, l);
+				return false;
+			}
+			container.regions.push_back({ offset, regionSize, m, l });
+			offset += regionSize;
+		}
+	}
+	return true;
+}
+
+bool TextureContainerUtils::Parse(const uint8_t* data, size_t size, TextureContainer& container)
+{
+	static const uint8_t ktx2Identifier[12] = { 0xAB, 'K', 'T', 'X', ' ', '2', '0', 0xBB, '\r', '\n', 0x1A, '\n' };
+	if (size >= sizeof(ktx2Identifier) && memcmp(data, ktx2Identifier, sizeof(ktx2Identifier)) == 0)
+	{
+		return ParseKTX2(data, size, container);
+	}
+	if (size >= 4 && ReadUInt32(data) == MakeFourCC('D', 'D', 'S', ' '))
+	{
+		return ParseDDS(data, size, container);
+	}
+
+	CoreLogError(DefaultLogger, "Texture container: Neither a KTX2 nor a DDS file.");
+	return false;
+}
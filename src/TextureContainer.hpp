@@ -0,0 +1,31 @@
+#pragma once
+#include <vulkan/vulkan.hpp>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Layout of a texture stored in a KTX2 or DDS file. Regions are byte ranges of the file, one per level and layer.
+struct TextureContainer
+{
+	struct Region
+	{
+		size_t offset;
+		size_t size;
+		int mipLevel;
+		int layer;
+	};
+
+	VkFormat format = VK_FORMAT_UNDEFINED;
+	int width = 0;
+	int height = 0;
+	int mipCount = 1;
+	int layerCount = 1;
+	std::vector<Region> regions;
+};
+
+namespace TextureContainerUtils
+{
+	// Recognizes the container by its identifier. Supercompressed KTX2 files, cubemaps and 3D textures are not supported.
+	// Every region lies within the data and is large enough for its level's extent in the container's format.
+	bool Parse(const uint8_t* data, size_t size, TextureContainer& container);
+}
@@ -0,0 +1,338 @@
+#include "TextureProcessing.hpp"
+#include <algorithm>
+#include <cmath>
+
+// Splits the rows into a few tasks per worker and waits for them (not for other uploads sharing the pool).
+template<typename ProcessRows>
+static void ProcessRowsInParallel(int rowCount, ThreadPool& threadPool, ProcessRows&& processRows)
+{
+	TaskGroup taskGroup;
+	const int taskCount = std::min(rowCount, std::max(threadPool.GetThreadCount(), 1) * 4);
+	for (int t = 0; t < taskCount; ++t)
+	{
+		const int firstRow = rowCount * t / taskCount;
+		const int lastRow = rowCount * (t + 1) / taskCount;
+		threadPool.Submit([=]() { processRows(firstRow, lastRow); }, taskGroup);
+	}
+	taskGroup.Wait();
+}
+
+static const float* GetSRGBToLinearTable()
+{
+	static const std::vector<float> table = []()
+	{
+		std::vector<float> srgbToLinear(256);
+		for (int v = 0; v < 256; ++v)
+		{
+			const float srgb = v / 255.f;
+			srgbToLinear[v] = srgb <= .04045f ? srgb / 12.92f : std::pow((srgb + .055f) / 1.055f, 2.4f);
+		}
+		return srgbToLinear;
+	}();
+	return table.data();
+}
+
+// Fine enough that every 8-bit sRGB value is reachable.
+static constexpr int linearToSRGBTableSize = 1 << 14;
+
+static const uint8_t* GetLinearToSRGBTable()
+{
+	static const std::vector<uint8_t> table = []()
+	{
+		std::vector<uint8_t> linearToSRGB(linearToSRGBTableSize);
+		for (int v = 0; v < linearToSRGBTableSize; ++v)
+		{
+			const float linear = v / float(linearToSRGBTableSize - 1);
+			const float srgb = linear <= .0031308f ? linear * 12.92f : 1.055f * std::pow(linear, 1.f / 2.4f) - .055f;
+			linearToSRGB[v] = (uint8_t)std::min(std::max(srgb * 255.f + .5f, 0.f), 255.f);
+		}
+		return linearToSRGB;
+	}();
+	return table.data();
+}
+
+// Values outside [0, 1] (ringing of the Kaiser filter) are clamped.
+static uint8_t LinearToSRGB(const uint8_t* linearToSRGB, float linear)
+{
+	return linearToSRGB[(int)(std::min(std::max(linear, 0.f), 1.f) * (linearToSRGBTableSize - 1) + .5f)];
+}
+
+static uint8_t LinearToUnorm(float linear)
+{
+	return (uint8_t)(std::min(std::max(linear, 0.f), 1.f) * 255.f + .5f);
+}
+
+// Gray-alpha and RGBA keep alpha in the last channel, which is never sRGB encoded.
+static constexpr int GetSRGBChannelCount(int channelCount, bool srgb)
+{
+	return !srgb ? 0 : (channelCount == 2 || channelCount == 4) ? channelCount - 1 : channelCount;
+}
+
+template<int ChannelCount, bool SRGB>
+static void FilterBoxTexel(const uint8_t* row0, const uint8_t* row1, int x0, int x1, uint8_t* destination,
+	const float* srgbToLinear, const uint8_t* linearToSRGB)
+{
+	constexpr int srgbChannelCount = GetSRGBChannelCount(ChannelCount, SRGB);
+	for (int c = 0; c < srgbChannelCount; ++c)
+	{
+		const float linear = (srgbToLinear[row0[x0 + c]] + srgbToLinear[row0[x1 + c]] +
+			srgbToLinear[row1[x0 + c]] + srgbToLinear[row1[x1 + c]]) * .25f;
+		destination[c] = LinearToSRGB(linearToSRGB, linear);
+	}
+	for (int c = srgbChannelCount; c < ChannelCount; ++c)
+	{
+		destination[c] = (uint8_t)((row0[x0 + c] + row0[x1 + c] + row1[x0 + c] + row1[x1 + c] + 2) >> 2);
+	}
+}
+
+template<int ChannelCount, bool SRGB>
+static void DownsampleBoxRows(const uint8_t* source, int sourceWidth, int sourceHeight, uint8_t* destination,
+	int levelWidth, int firstRow, int lastRow)
+{
+	const float* srgbToLinear = GetSRGBToLinearTable();
+	const uint8_t* linearToSRGB = GetLinearToSRGBTable();
+	// Every destination texel but the one of a single texel wide source covers two source columns.
+	const int pairCount = std::min(sourceWidth / 2, levelWidth);
+
+	for (int y = firstRow; y < lastRow; ++y)
+	{
+		// Odd sizes repeat the edge texels.
+		const uint8_t* row0 = source + (size_t)std::min(2 * y, sourceHeight - 1) * sourceWidth * ChannelCount;
+		const uint8_t* row1 = source + (size_t)std::min(2 * y + 1, sourceHeight - 1) * sourceWidth * ChannelCount;
+		uint8_t* destinationRow = destination + (size_t)y * levelWidth * ChannelCount;
+		int x = 0;
+		for (; x < pairCount; ++x)
+		{
+			FilterBoxTexel<ChannelCount, SRGB>(row0, row1, 2 * x * ChannelCount, (2 * x + 1) * ChannelCount,
+				destinationRow + x * ChannelCount, srgbToLinear, linearToSRGB);
+		}
+		for (; x < levelWidth; ++x)
+		{
+			FilterBoxTexel<ChannelCount, SRGB>(row0, row1, 0, 0, destinationRow + x * ChannelCount, srgbToLinear, linearToSRGB);
+		}
+	}
+}
+
+static constexpr int kaiserTapCount = 6;
+
+static float BesselI0(float x)
+{
+	float sum = 1.f;
+	float term = 1.f;
+	for (int k = 1; k < 32; ++k)
+	{
+		term *= (x * .5f / k) * (x * .5f / k);
+		sum += term;
+	}
+	return sum;
+}
+
+// Kaiser windowed sinc (alpha 4, 3 destination texels wide) sampled at the six source texels around
+// a destination texel: 2x - 2 to 2x + 3.
+static const float* GetKaiserWeights()
+{
+	static const std::vector<float> weights = []()
+	{
+		const float pi = 3.14159265f;
+		const float alpha = 4.f;
+		const float halfWidth = 1.5f;
+		std::vector<float> kaiserWeights(kaiserTapCount);
+		float sum = 0.f;
+		for (int t = 0; t < kaiserTapCount; ++t)
+		{
+			// In destination texels from the center of the destination texel.
+			const float distance = (t - 2.5f) * .5f;
+			const float sinc = std::sin(pi * distance) / (pi * distance);
+			const float windowPosition = distance / halfWidth;
+			const float window = BesselI0(alpha * std::sqrt(1.f - windowPosition * windowPosition)) / BesselI0(alpha);
+			kaiserWeights[t] = sinc * window;
+			sum += kaiserWeights[t];
+		}
+		for (int t = 0; t < kaiserTapCount; ++t)
+		{
+			kaiserWeights[t] /= sum;
+		}
+		return kaiserWeights;
+	}();
+	return weights.data();
+}
+
+// Separable: the source rows under the taps are filtered horizontally into linear floats first, then the
+// destination rows are filtered vertically from those.
+template<int ChannelCount, bool SRGB>
+static void DownsampleKaiserRows(const uint8_t* source, int sourceWidth, int sourceHeight, uint8_t* destination,
+	int levelWidth, int firstRow, int lastRow)
+{
+	constexpr int srgbChannelCount = GetSRGBChannelCount(ChannelCount, SRGB);
+	const float* srgbToLinear = GetSRGBToLinearTable();
+	const uint8_t* linearToSRGB = GetLinearToSRGBTable();
+	const float* weights = GetKaiserWeights();
+
+	// The source row with two texels of padding on the left and four on the right (repeating the edge texels),
+	// split into the even and the odd texels. Tap t of destination texel x then is texel x + t / 2 of one of them,
+	// so every tap reads a contiguous run.
+	const int pairCount = (sourceWidth + 6) / 2;
+	std::vector<float> evenTexels((size_t)pairCount * ChannelCount);
+	std::vector<float> oddTexels((size_t)pairCount * ChannelCount);
+
+	const int firstSourceRow = 2 * firstRow - 2;
+	const int filteredRowCount = 2 * (lastRow - firstRow) + 4;
+	const size_t rowSize = (size_t)levelWidth * ChannelCount;
+	std::vector<float> filteredRows(filteredRowCount * rowSize);
+	for (int r = 0; r < filteredRowCount; ++r)
+	{
+		const int sourceY = std::min(std::max(firstSourceRow + r, 0), sourceHeight - 1);
+		const uint8_t* sourceRow = source + (size_t)sourceY * sourceWidth * ChannelCount;
+		for (int p = 0; p < pairCount; ++p)
+		{
+			// Padded texel 2p is source texel 2p - 2.
+			const uint8_t* evenTexel = sourceRow + std::min(std::max(2 * p - 2, 0), sourceWidth - 1) * ChannelCount;
+			const uint8_t* oddTexel = sourceRow + std::min(std::max(2 * p - 1, 0), sourceWidth - 1) * ChannelCount;
+			for (int c = 0; c < srgbChannelCount; ++c)
+			{
+				evenTexels[p * ChannelCount + c] = srgbToLinear[evenTexel[c]];
+				oddTexels[p * ChannelCount + c] = srgbToLinear[oddTexel[c]];
+			}
+			for (int c = srgbChannelCount; c < ChannelCount; ++c)
+			{
+				evenTexels[p * ChannelCount + c] = evenTexel[c] * (1.f / 255.f);
+				oddTexels[p * ChannelCount + c] = oddTexel[c] * (1.f / 255.f);
+			}
+		}
+
+		// Accumulated tap by tap, so that every pass runs along the whole row.
+		float* filteredRow = filteredRows.data() + r * rowSize;
+		for (int t = 0; t < kaiserTapCount; ++t)
+		{
+			const float* taps = ((t & 1) ? oddTexels.data() : evenTexels.data()) + (t >> 1) * ChannelCount;
+			const float weight = weights[t];
+			for (size_t i = 0; i < rowSize; ++i)
+			{
+				filteredRow[i] += weight * taps[i];
+			}
+		}
+	}
+
+	std::vector<float> values(rowSize);
+	for (int y = firstRow; y < lastRow; ++y)
+	{
+		// Filtered row 2 * (y - firstRow) is source row 2y - 2.
+		const float* taps = filteredRows.data() + 2 * (y - firstRow) * rowSize;
+		std::fill(values.begin(), values.end(), 0.f);
+		for (int t = 0; t < kaiserTapCount; ++t)
+		{
+			const float* tapRow = taps + t * rowSize;
+			const float weight = weights[t];
+			for (size_t i = 0; i < rowSize; ++i)
+			{
+				values[i] += weight * tapRow[i];
+			}
+		}
+
+		uint8_t* destinationRow = destination + (size_t)y * rowSize;
+		for (int x = 0; x < levelWidth; ++x)
+		{
+			for (int c = 0; c < srgbChannelCount; ++c)
+			{
+				destinationRow[x * ChannelCount + c] = LinearToSRGB(linearToSRGB, values[x * ChannelCount + c]);
+			}
+			for (int c = srgbChannelCount; c < ChannelCount; ++c)
+			{
+				destinationRow[x * ChannelCount + c] = LinearToUnorm(values[x * ChannelCount + c]);
+			}
+		}
+	}
+}
+
+template<int ChannelCount, bool SRGB>
+static void GenerateMipLevel(const uint8_t* source, int sourceWidth, int sourceHeight, uint8_t* destination,
+	int levelWidth, int levelHeight, HawkEye::MipFilter mipFilter, ThreadPool& threadPool)
+{
+	ProcessRowsInParallel(levelHeight, threadPool, [=](int firstRow, int lastRow)
+	{
+		if (mipFilter == HawkEye::MipFilter::CpuKaiser)
+		{
+			DownsampleKaiserRows<ChannelCount, SRGB>(source, sourceWidth, sourceHeight, destination, levelWidth, firstRow, lastRow);
+		}
+		else
+		{
+			DownsampleBoxRows<ChannelCount, SRGB>(source, sourceWidth, sourceHeight, destination, levelWidth, firstRow, lastRow);
+		}
+	});
+}
+
+template<int ChannelCount>
+static void GenerateMipLevels(uint8_t* mipChain, const std::vector<size_t>& levelOffsets, int width, int height, int mipCount,
+	bool srgb, HawkEye::MipFilter mipFilter, ThreadPool& threadPool)
+{
+	for (int m = 1; m < mipCount; ++m)
+	{
+		const uint8_t* source = mipChain + levelOffsets[m - 1];
+		uint8_t* destination = mipChain + levelOffsets[m];
+		const int sourceWidth = std::max(width >> (m - 1), 1);
+		const int sourceHeight = std::max(height >> (m - 1), 1);
+		const int levelWidth = std::max(width >> m, 1);
+		const int levelHeight = std::max(height >> m, 1);
+		if (srgb)
+		{
+			GenerateMipLevel<ChannelCount, true>(source, sourceWidth, sourceHeight, destination, levelWidth, levelHeight,
+				mipFilter, threadPool);
+		}
+		else
+		{
+			GenerateMipLevel<ChannelCount, false>(source, sourceWidth, sourceHeight, destination, levelWidth, levelHeight,
+				mipFilter, threadPool);
+		}
+	}
+}
+
+std::vector<size_t> TextureProcessing::GetMipLevelOffsets(int width, int height, int mipCount, int channelCount)
+{
+	std::vector<size_t> levelOffsets(mipCount + 1);
+	size_t offset = 0;
+	for (int m = 0; m < mipCount; ++m)
+	{
+		levelOffsets[m] = offset;
+		offset += (size_t)std::max(width >> m, 1) * std::max(height >> m, 1) * channelCount;
+		offset = (offset + 3) & ~(size_t)3;
+	}
+	levelOffsets[mipCount] = offset;
+	return levelOffsets;
+}
+
+void TextureProcessing::ExpandRGBToRGBA(const uint8_t* rgbData, int width, int height, uint8_t* rgbaData,
+	ThreadPool& threadPool)
+{
+	ProcessRowsInParallel(height, threadPool, [=](int firstRow, int lastRow)
+	{
+		for (size_t t = (size_t)firstRow * width; t < (size_t)lastRow * width; ++t)
+		{
+			rgbaData[t * 4 + 0] = rgbData[t * 3 + 0];
+			rgbaData[t * 4 + 1] = rgbData[t * 3 + 1];
+			rgbaData[t * 4 + 2] = rgbData[t * 3 + 2];
+			rgbaData[t * 4 + 3] = 255;
+		}
+	});
+}
+
+void TextureProcessing::GenerateMipChain(uint8_t* mipChain, const std::vector<size_t>& levelOffsets, int width, int height,
+	int mipCount, int channelCount, bool srgb, HawkEye::MipFilter mipFilter, ThreadPool& threadPool)
+{
+	switch (channelCount)
+	{
+	case 1:
+		GenerateMipLevels<1>(mipChain, levelOffsets, width, height, mipCount, srgb, mipFilter, threadPool);
+		break;
+	case 2:
+		GenerateMipLevels<2>(mipChain, levelOffsets, width, height, mipCount, srgb, mipFilter, threadPool);
+		break;
+	case 3:
+		GenerateMipLevels<3>(mipChain, levelOffsets, width, height, mipCount, srgb, mipFilter, threadPool);
+		break;
+	case 4:
+		GenerateMipLevels<4>(mipChain, levelOffsets, width, height, mipCount, srgb, mipFilter, threadPool);
+		break;
+	default:
+		break;
+	}
+}
@@ -0,0 +1,21 @@
+#pragma once
+#include "HawkEye/HawkEyeAPI.hpp"
+#include "ThreadPool.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// CPU side texel processing for formats the GPU cannot handle by itself. Rows are split across the thread pool.
+namespace TextureProcessing
+{
+	// Offsets of the tightly packed levels of a mip chain (4 byte aligned, as required by copies on transfer queues)
+	// followed by the size of the whole chain.
+	std::vector<size_t> GetMipLevelOffsets(int width, int height, int mipCount, int channelCount);
+
+	void ExpandRGBToRGBA(const uint8_t* rgbData, int width, int height, uint8_t* rgbaData, ThreadPool& threadPool);
+
+	// Builds levels 1 and up from level 0 (already at the start of the chain) with a 2x2 box or a 6x6 Kaiser filter.
+	// sRGB color channels are filtered in linear space, alpha always is.
+	void GenerateMipChain(uint8_t* mipChain, const std::vector<size_t>& levelOffsets, int width, int height, int mipCount,
+		int channelCount, bool srgb, HawkEye::MipFilter mipFilter, ThreadPool& threadPool);
+}
@@ -0,0 +1,109 @@
+#include "ThreadPool.hpp"
+
+void TaskGroup::Wait()
+{
+	std::unique_lock<std::mutex> lock(mutex);
+	tasksFinished.wait(lock, [this]() { return unfinishedTaskCount == 0; });
+}
+
+void TaskGroup::Add()
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	++unfinishedTaskCount;
+}
+
+void TaskGroup::Finish()
+{
+	// Notified under the lock, the waiter may destroy the group as soon as it wakes up.
+	std::lock_guard<std::mutex> lock(mutex);
+	if (--unfinishedTaskCount == 0)
+	{
+		tasksFinished.notify_all();
+	}
+}
+
+ThreadPool::~ThreadPool()
+{
+	Shutdown();
+}
+
+void ThreadPool::Init(int threadCount)
+{
+	stopping = false;
+	for (int t = 0; t < threadCount; ++t)
+	{
+		workers.emplace_back(&ThreadPool::WorkerLoop, this);
+	}
+}
+
+void ThreadPool::Shutdown()
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		stopping = true;
+	}
+	taskAvailable.notify_all();
+
+	for (auto& worker : workers)
+	{
+		worker.join();
+	}
+	workers.clear();
+}
+
+void ThreadPool::Submit(std::function<void()>&& task)
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		tasks.push_back(std::move(task));
+		++unfinishedTaskCount;
+	}
+	taskAvailable.notify_one();
+}
+
+void ThreadPool::Submit(std::function<void()>&& task, TaskGroup& group)
+{
+	group.Add();
+	Submit([task = std::move(task), &group]()
+	{
+		task();
+		group.Finish();
+	});
+}
+
+void ThreadPool::Wait()
+{
+	std::unique_lock<std::mutex> lock(mutex);
+	tasksFinished.wait(lock, [this]() { return unfinishedTaskCount == 0; });
+}
+
+int ThreadPool::GetThreadCount() const
+{
+	return (int)workers.size();
+}
+
+void ThreadPool::WorkerLoop()
+{
+	while (true)
+	{
+		std::function<void()> task;
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			taskAvailable.wait(lock, [this]() { return stopping || !tasks.empty(); });
+			if (stopping && tasks.empty())
+			{
+				return;
+			}
+			task = std::move(tasks.front());
+			tasks.pop_front();
+		}
+
+		task();
+
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			--unfinishedTaskCount;
+		}
+		tasksFinished.notify_all();
+	}
+}
@@ -0,0 +1,58 @@
+#pragma once
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Tracks the tasks of one caller, so that it can wait for them without waiting for the other callers' tasks.
+class TaskGroup
+{
+public:
+	// Blocks until every task submitted with this group has finished.
+	void Wait();
+
+private:
+	friend class ThreadPool;
+
+	void Add();
+	void Finish();
+
+	std::mutex mutex;
+	std::condition_variable tasksFinished;
+	int unfinishedTaskCount = 0;
+};
+
+// Fixed set of worker threads executing submitted tasks in FIFO order.
+class ThreadPool
+{
+public:
+	ThreadPool() = default;
+	~ThreadPool();
+
+	ThreadPool(const ThreadPool&) = delete;
+	ThreadPool& operator=(const ThreadPool&) = delete;
+
+	void Init(int threadCount);
+	void Shutdown();
+
+	void Submit(std::function<void()>&& task);
+	// The group has to outlive the task.
+	void Submit(std::function<void()>&& task, TaskGroup& group);
+	// Blocks until every submitted task has finished.
+	void Wait();
+
+	int GetThreadCount() const;
+
+private:
+	void WorkerLoop();
+
+	std::vector<std::thread> workers;
+	std::deque<std::function<void()>> tasks;
+	std::mutex mutex;
+	std::condition_variable taskAvailable;
+	std::condition_variable tasksFinished;
+	int unfinishedTaskCount = 0;
+	bool stopping = false;
+};
@@ -0,0 +1,137 @@
+#include "Timeline.hpp"
+#include <VulkanBackend/ErrorCheck.hpp>
+#include <vector>
+
+void Timeline::Init(VulkanBackend::BackendData* backendData, VkQueue queue)
+{
+	this->backendData = backendData;
+	this->queue = queue;
+
+	VkSemaphoreTypeCreateInfo semaphoreTypeCreateInfo{};
+	semaphoreTypeCreateInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO;
+	semaphoreTypeCreateInfo.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE;
+	semaphoreTypeCreateInfo.initialValue = 0;
+
+	VkSemaphoreCreateInfo semaphoreCreateInfo{};
+	semaphoreCreateInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+	semaphoreCreateInfo.pNext = &semaphoreTypeCreateInfo;
+	VulkanCheck(vkCreateSemaphore(backendData->logicalDevice, &semaphoreCreateInfo, nullptr, &semaphore));
+
+	submittedValue = 0;
+	completedValue = 0;
+}
+
+void Timeline::Shutdown()
+{
+	if (semaphore != VK_NULL_HANDLE)
+	{
+		VulkanBackend::DestroySemaphore(*backendData, semaphore);
+		semaphore = VK_NULL_HANDLE;
+	}
+}
+
+uint64_t Timeline::Submit(const VkSubmitInfo& submitInfo, const TimelineWait* waits, int waitCount)
+{
+	// Binary semaphores ignore their values, but the value arrays have to cover all of them.
+	std::vector<VkSemaphore> waitSemaphores(submitInfo.pWaitSemaphores,
+		submitInfo.pWaitSemaphores + submitInfo.waitSemaphoreCount);
+	std::vector<VkPipelineStageFlags> waitStages(submitInfo.pWaitDstStageMask,
+		submitInfo.pWaitDstStageMask + submitInfo.waitSemaphoreCount);
+	std::vector<uint64_t> waitValues(submitInfo.waitSemaphoreCount, 0);
+	for (int w = 0; w < waitCount; ++w)
+	{
+		// Waiting for a point that was already reached only costs the GPU a comparison, but it can be skipped entirely.
+		if (waits[w].timeline->Reached(waits[w].value))
+		{
+			continue;
+		}
+		waitSemaphores.push_back(waits[w].timeline->GetSemaphore());
+		waitStages.push_back(waits[w].stageMask);
+		waitValues.push_back(waits[w].value);
+	}
+
+	std::vector<VkSemaphore> signalSemaphores(submitInfo.pSignalSemaphores,
+		submitInfo.pSignalSemaphores + submitInfo.signalSemaphoreCount);
+	std::vector<uint64_t> signalValues(submitInfo.signalSemaphoreCount, 0);
+	signalSemaphores.push_back(semaphore);
+
+	std::lock_guard<std::mutex> lock(submitMutex);
+
+	const uint64_t signalValue = submittedValue + 1;
+	signalValues.push_back(signalValue);
+
+	VkTimelineSemaphoreSubmitInfo timelineSubmitInfo{};
+	timelineSubmitInfo.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+	timelineSubmitInfo.waitSemaphoreValueCount = (uint32_t)waitValues.size();
+	timelineSubmitInfo.pWaitSemaphoreValues = waitValues.data();
+	timelineSubmitInfo.signalSemaphoreValueCount = (uint32_t)signalValues.size();
+	timelineSubmitInfo.pSignalSemaphoreValues = signalValues.data();
+
+	VkSubmitInfo timelineSubmit = submitInfo;
+	timelineSubmit.pNext = &timelineSubmitInfo;
+	timelineSubmit.waitSemaphoreCount = (uint32_t)waitSemaphores.size();
+	timelineSubmit.pWaitSemaphores = waitSemaphores.data();
+	timelineSubmit.pWaitDstStageMask = waitStages.data();
+	timelineSubmit.signalSemaphoreCount = (uint32_t)signalSemaphores.size();
+	timelineSubmit.pSignalSemaphores = signalSemaphores.data();
+
+	VulkanCheck(vkQueueSubmit(queue, 1, &timelineSubmit, VK_NULL_HANDLE));
+
+	submittedValue = signalValue;
+	return signalValue;
+}
+
+void Timeline::Wait(uint64_t value)
+{
+	if (value <= completedValue)
+	{
+		return;
+	}
+
+	VkSemaphoreWaitInfo waitInfo{};
+	waitInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO;
+	waitInfo.semaphoreCount = 1;
+	waitInfo.pSemaphores = &semaphore;
+	waitInfo.pValues = &value;
+	VulkanCheck(vkWaitSemaphores(backendData->logicalDevice, &waitInfo, UINT64_MAX));
+
+	UpdateCompletedValue(value);
+}
+
+bool Timeline::Reached(uint64_t value)
+{
+	if (value <= completedValue)
+	{
+		return true;
+	}
+	return GetCompletedValue() >= value;
+}
+
+uint64_t Timeline::GetCompletedValue()
+{
+	uint64_t value = 0;
+	VulkanCheck(vkGetSemaphoreCounterValue(backendData->logicalDevice, semaphore, &value));
+	UpdateCompletedValue(value);
+	return value;
+}
+
+uint64_t Timeline::GetSubmittedValue() const
+{
+	return submittedValue;
+}
+
+VkSemaphore Timeline::GetSemaphore() const
+{
+	return semaphore;
+}
+
+VkQueue Timeline::GetQueue() const
+{
+	return queue;
+}
+
+void Timeline::UpdateCompletedValue(uint64_t value)
+{
+	uint64_t current = completedValue;
+	while (current < value && !completedValue.compare_exchange_weak(current, value)) {}
+}
@@ -0,0 +1,51 @@
+#pragma once
+#include <VulkanBackend/VulkanBackendAPI.hpp>
+#include <vulkan/vulkan.hpp>
+#include <atomic>
+#include <mutex>
+
+class Timeline;
+
+struct TimelineWait
+{
+	Timeline* timeline;
+	uint64_t value;
+	VkPipelineStageFlags stageMask;
+};
+
+// Timeline semaphore signaled by every submit to a single queue. Each submit gets the next value,
+// so waiting for any submit (or any point in the queue's history) is a comparison of two integers.
+// The device has to be created with the timelineSemaphore feature enabled.
+class Timeline
+{
+public:
+	Timeline() = default;
+	~Timeline() = default;
+
+	void Init(VulkanBackend::BackendData* backendData, VkQueue queue);
+	void Shutdown();
+
+	// Submits the batch to the queue, additionally signaling the timeline, and returns the signaled value.
+	// The waits are performed on the GPU, except for the ones whose value has already been reached.
+	uint64_t Submit(const VkSubmitInfo& submitInfo, const TimelineWait* waits = nullptr, int waitCount = 0);
+
+	void Wait(uint64_t value);
+	bool Reached(uint64_t value);
+
+	uint64_t GetCompletedValue();
+	uint64_t GetSubmittedValue() const;
+
+	VkSemaphore GetSemaphore() const;
+	VkQueue GetQueue() const;
+
+private:
+	void UpdateCompletedValue(uint64_t value);
+
+	VulkanBackend::BackendData* backendData = nullptr;
+	VkQueue queue = VK_NULL_HANDLE;
+	VkSemaphore semaphore = VK_NULL_HANDLE;
+	std::atomic<uint64_t> submittedValue{ 0 };
+	std::atomic<uint64_t> completedValue{ 0 };
+	// Queue submission has to be externally synchronized.
+	std::mutex submitMutex;
+};
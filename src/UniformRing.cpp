@@ -0,0 +1,60 @@
+#include "UniformRing.hpp"
+#include <SoftwareCore/DefaultLogger.hpp>
+#include <VulkanBackend/ErrorCheck.hpp>
+
+int UniformRing::Reserve(int size)
+{
+	if (mappedData)
+	{
+		CoreLogError(DefaultLogger, "Uniform ring: Reserving space after initialization.");
+		return -1;
+	}
+
+	const int offset = frameStride;
+	frameStride += (size + alignment - 1) / alignment * alignment;
+	return offset;
+}
+
+void UniformRing::Init(VulkanBackend::BackendData* backendData, int framesInFlightCount)
+{
+	this->backendData = backendData;
+	this->framesInFlightCount = framesInFlightCount;
+
+	if (frameStride == 0)
+	{
+		return;
+	}
+
+	buffer = VulkanBackend::CreateBuffer(*backendData, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
+		(VkDeviceSize)frameStride * framesInFlightCount, VMA_MEMORY_USAGE_CPU_TO_GPU);
+
+	void* data;
+	VulkanCheck(vmaMapMemory(backendData->allocator, buffer.allocation, &data));
+	mappedData = (uint8_t*)data;
+}
+
+void UniformRing::Shutdown()
+{
+	if (mappedData)
+	{
+		vmaUnmapMemory(backendData->allocator, buffer.allocation);
+		VulkanBackend::DestroyBuffer(*backendData, buffer);
+		mappedData = nullptr;
+	}
+	frameStride = 0;
+}
+
+VkBuffer UniformRing::GetBuffer() const
+{
+	return buffer.buffer;
+}
+
+uint32_t UniformRing::GetFrameOffset(int frameInFlight) const
+{
+	return (uint32_t)(frameInFlight * frameStride);
+}
+
+uint8_t* UniformRing::GetFrameData(int frameInFlight) const
+{
+	return mappedData + frameInFlight * frameStride;
+}
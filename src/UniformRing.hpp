@@ -0,0 +1,33 @@
+#pragma once
+#include <VulkanBackend/VulkanBackendAPI.hpp>
+#include <vulkan/vulkan.hpp>
+#include <cstdint>
+
+// Per-pipeline, persistently mapped buffer holding the host-visible uniforms of all nodes.
+// Every frame in flight gets its own slice; descriptors use dynamic offsets to select the slice.
+class UniformRing
+{
+public:
+	UniformRing() = default;
+	~UniformRing() = default;
+
+	// Maximum minUniformBufferOffsetAlignment allowed by the specification.
+	static const int alignment = 256;
+
+	// Reserves space in every frame's slice and returns its offset within the slice. Only valid before Init.
+	int Reserve(int size);
+
+	void Init(VulkanBackend::BackendData* backendData, int framesInFlightCount);
+	void Shutdown();
+
+	VkBuffer GetBuffer() const;
+	uint32_t GetFrameOffset(int frameInFlight) const;
+	uint8_t* GetFrameData(int frameInFlight) const;
+
+private:
+	VulkanBackend::BackendData* backendData = nullptr;
+	VulkanBackend::Buffer buffer{};
+	uint8_t* mappedData = nullptr;
+	int frameStride = 0;
+	int framesInFlightCount = 0;
+};
@@ -0,0 +1,108 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+// Bounded lock-free multi-producer single-consumer queue (D. Vyukov's sequenced ring).
+// Records are constructed once and reused, so steady state pushes never allocate as long
+// as the record types reuse their own storage (e.g. std::string/std::vector assignment).
+template<typename Record>
+class UpdateQueue
+{
+public:
+	UpdateQueue() = default;
+	~UpdateQueue() = default;
+
+	UpdateQueue(const UpdateQueue&) = delete;
+	UpdateQueue& operator=(const UpdateQueue&) = delete;
+
+	// Capacity is rounded up to a power of two.
+	void Init(int capacity)
+	{
+		size_t cellCount = 1;
+		while (cellCount < (size_t)capacity)
+		{
+			cellCount <<= 1;
+		}
+
+		cells.reset(new Cell[cellCount]);
+		mask = cellCount - 1;
+		for (size_t c = 0; c < cellCount; ++c)
+		{
+			cells[c].sequence.store(c, std::memory_order_relaxed);
+		}
+		enqueuePosition.store(0, std::memory_order_relaxed);
+		dequeuePosition = 0;
+	}
+
+	// Safe to call from any number of threads. The fill function receives the record to write into.
+	// Returns false if the queue is full.
+	template<typename Fill>
+	bool Push(Fill&& fill)
+	{
+		Cell* cell;
+		size_t position = enqueuePosition.load(std::memory_order_relaxed);
+		while (true)
+		{
+			cell = &cells[position & mask];
+			const size_t sequence = cell->sequence.load(std::memory_order_acquire);
+			const intptr_t difference = (intptr_t)sequence - (intptr_t)position;
+			if (difference == 0)
+			{
+				if (enqueuePosition.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
+				{
+					break;
+				}
+			}
+			else if (difference < 0)
+			{
+				return false;
+			}
+			else
+			{
+				position = enqueuePosition.load(std::memory_order_relaxed);
+			}
+		}
+
+		fill(cell->record);
+		cell->sequence.store(position + 1, std::memory_order_release);
+		return true;
+	}
+
+	// Must only be called from the consumer thread. Records still being pushed are counted as well.
+	size_t GetSize() const
+	{
+		return enqueuePosition.load(std::memory_order_acquire) - dequeuePosition;
+	}
+
+	// Must only be called from the consumer thread. Returns false if there is no published record.
+	template<typename Consume>
+	bool Pop(Consume&& consume)
+	{
+		Cell& cell = cells[dequeuePosition & mask];
+		const size_t sequence = cell.sequence.load(std::memory_order_acquire);
+		if (sequence != dequeuePosition + 1)
+		{
+			return false;
+		}
+
+		consume(cell.record);
+		cell.sequence.store(dequeuePosition + mask + 1, std::memory_order_release);
+		++dequeuePosition;
+		return true;
+	}
+
+private:
+	struct Cell
+	{
+		std::atomic<size_t> sequence;
+		Record record;
+	};
+
+	std::unique_ptr<Cell[]> cells;
+	size_t mask = 0;
+	// Producers and the consumer touch different cache lines.
+	alignas(64) std::atomic<size_t> enqueuePosition{ 0 };
+	alignas(64) size_t dequeuePosition = 0;
+};
@@ -0,0 +1,336 @@
+#include "UploadManager.hpp"
+#include <SoftwareCore/DefaultLogger.hpp>
+#include <VulkanBackend/ErrorCheck.hpp>
+#include <algorithm>
+
+// Satisfies the buffer offset requirements of buffer to image copies for all formats in use.
+const size_t stagingAlignment = 16;
+
+static size_t AlignStagingOffset(size_t offset)
+{
+	return (offset + stagingAlignment - 1) & ~(stagingAlignment - 1);
+}
+
+void UploadManager::Init(VulkanBackend::BackendData* backendData, Timeline* uploadTimeline, int familyIndex, size_t stagingCapacity)
+{
+	this->backendData = backendData;
+	this->uploadTimeline = uploadTimeline;
+	this->stagingCapacity = stagingCapacity;
+
+	commandPool = VulkanBackend::CreateCommandPool(*backendData, familyIndex,
+		VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT);
+
+	stagingRing = VulkanBackend::CreateBuffer(*backendData, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, stagingCapacity,
+		VMA_MEMORY_USAGE_CPU_ONLY);
+	void* mappedData;
+	VulkanCheck(vmaMapMemory(backendData->allocator, stagingRing.allocation, &mappedData));
+	stagingRingData = (uint8_t*)mappedData;
+
+	stagingHead = 0;
+	stagingTail = 0;
+	reservations.clear();
+	firstReservation = 0;
+	statistics = {};
+}
+
+void UploadManager::Shutdown()
+{
+	Flush();
+
+	std::lock_guard<std::mutex> lock(mutex);
+	while (!submittedBatches.empty())
+	{
+		uploadTimeline->Wait(submittedBatches.front().value);
+		RetireBatch(submittedBatches.front());
+		submittedBatches.pop_front();
+	}
+
+	vmaUnmapMemory(backendData->allocator, stagingRing.allocation);
+	VulkanBackend::DestroyBuffer(*backendData, stagingRing);
+	stagingRingData = nullptr;
+
+	// Destroying the pool frees the command buffers.
+	VulkanBackend::DestroyCommandPool(*backendData, commandPool);
+	freeCommandBuffers.clear();
+}
+
+void UploadManager::Flush()
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	FlushBatch();
+	RetireCompletedBatches();
+}
+
+void UploadManager::Wait(uint64_t value)
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		if (value > uploadTimeline->GetSubmittedValue())
+		{
+			FlushBatch();
+		}
+	}
+	uploadTimeline->Wait(value);
+}
+
+HawkEye::UploadStatistics UploadManager::GetStatistics()
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	RetireCompletedBatches();
+	return statistics;
+}
+
+void UploadManager::GetStagingUsage(uint64_t& stagingBytes, uint64_t& stagingBytesInUse)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	RetireCompletedBatches();
+
+	size_t ringBytesInUse = 0;
+	if (!IsStagingEmpty())
+	{
+		ringBytesInUse = stagingHead > stagingTail ? stagingHead - stagingTail : stagingCapacity - stagingTail + stagingHead;
+	}
+	stagingBytes = stagingCapacity + dedicatedStagingBytes;
+	stagingBytesInUse = ringBytesInUse + dedicatedStagingBytes;
+}
+
+UploadManager::Staging UploadManager::AllocateStaging(size_t dataSize, std::unique_lock<std::mutex>& lock)
+{
+	Staging staging;
+	if (dataSize > stagingCapacity)
+	{
+		// Rare enough to not be worth growing the ring for.
+		staging.dedicatedBuffer = VulkanBackend::CreateBuffer(*backendData, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+			dataSize, VMA_MEMORY_USAGE_CPU_ONLY);
+		void* mappedData;
+		VulkanCheck(vmaMapMemory(backendData->allocator, staging.dedicatedBuffer.allocation, &mappedData));
+
+		VmaAllocationInfo allocationInfo;
+		vmaGetAllocationInfo(backendData->allocator, staging.dedicatedBuffer.allocation, &allocationInfo);
+		dedicatedStagingBytes += allocationInfo.size;
+		staging.data = (uint8_t*)mappedData;
+		staging.buffer = staging.dedicatedBuffer.buffer;
+		return staging;
+	}
+
+	size_t offset;
+	while (!TryAllocateStaging(dataSize, offset))
+	{
+		// Make room by reclaiming finished batches, submitting the current one and finally waiting for the oldest one.
+		RetireCompletedBatches();
+		if (TryAllocateStaging(dataSize, offset))
+		{
+			break;
+		}
+		if (HasOpenBatch())
+		{
+			FlushBatch();
+		}
+		else if (!submittedBatches.empty())
+		{
+			uploadTimeline->Wait(submittedBatches.front().value);
+		}
+		else
+		{
+			// Only fills still in progress hold the ring.
+			stagingCommitted.wait(lock);
+		}
+	}
+
+	staging.data = stagingRingData + offset;
+	staging.buffer = stagingRing.buffer;
+	staging.offset = (VkDeviceSize)offset;
+	staging.reservation = firstReservation + reservations.size();
+	reservations.push_back({ offset, false });
+	return staging;
+}
+
+void UploadManager::CommitStaging(const Staging& staging, Batch& batch)
+{
+	BeginBatch(batch);
+	if (staging.dedicatedBuffer.buffer != VK_NULL_HANDLE)
+	{
+		batch.dedicatedStagingBuffers.push_back(staging.dedicatedBuffer);
+		return;
+	}
+
+	reservations[(size_t)(staging.reservation - firstReservation)].committed = true;
+	while (!reservations.empty() && reservations.front().committed)
+	{
+		reservations.pop_front();
+		++firstReservation;
+	}
+	stagingCommitted.notify_all();
+}
+
+bool UploadManager::IsStagingEmpty() const
+{
+	return submittedBatches.empty() && !HasOpenBatch() && reservations.empty();
+}
+
+bool UploadManager::HasOpenBatch() const
+{
+	return currentBatch.commandBuffer != VK_NULL_HANDLE || waitingBatch.commandBuffer != VK_NULL_HANDLE;
+}
+
+bool UploadManager::TryAllocateStaging(size_t dataSize, size_t& offset)
+{
+	const bool empty = IsStagingEmpty();
+	if (empty)
+	{
+		stagingHead = 0;
+		stagingTail = 0;
+	}
+
+	// The region in use is [tail, head), or [tail, capacity) and [0, head) once it wrapped around.
+	const bool wrapped = stagingHead < stagingTail || (stagingHead == stagingTail && !empty);
+	const size_t start = AlignStagingOffset(stagingHead);
+	if (!wrapped)
+	{
+		if (start + dataSize <= stagingCapacity)
+		{
+			offset = start;
+			stagingHead = start + dataSize;
+			return true;
+		}
+		if (dataSize <= stagingTail)
+		{
+			offset = 0;
+			stagingHead = dataSize;
+			return true;
+		}
+		return false;
+	}
+
+	if (start + dataSize <= stagingTail)
+	{
+		offset = start;
+		stagingHead = start + dataSize;
+		return true;
+	}
+	return false;
+}
+
+void UploadManager::BeginBatch(Batch& batch)
+{
+	if (batch.commandBuffer != VK_NULL_HANDLE)
+	{
+		return;
+	}
+
+	if (freeCommandBuffers.empty())
+	{
+		batch.commandBuffer = VulkanBackend::AllocateCommandBuffer(*backendData, commandPool);
+	}
+	else
+	{
+		batch.commandBuffer = freeCommandBuffers.back();
+		freeCommandBuffers.pop_back();
+		VulkanBackend::ResetCommandBuffer(batch.commandBuffer);
+	}
+
+	VkCommandBufferBeginInfo commandBufferBeginInfo{};
+	commandBufferBeginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+	commandBufferBeginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+	VulkanCheck(vkBeginCommandBuffer(batch.commandBuffer, &commandBufferBeginInfo));
+
+	// Nobody else submits to the upload timeline, so this is the value the batch will signal.
+	batch.value = uploadTimeline->GetSubmittedValue() + (&batch == &waitingBatch ? 2 : 1);
+}
+
+void UploadManager::AddWait(Batch& batch, const TimelineWait& wait)
+{
+	for (int w = 0; w < batch.waits.size(); ++w)
+	{
+		if (batch.waits[w].timeline == wait.timeline)
+		{
+			batch.waits[w].value = std::max(batch.waits[w].value, wait.value);
+			batch.waits[w].stageMask |= wait.stageMask;
+			return;
+		}
+	}
+	batch.waits.push_back(wait);
+}
+
+void UploadManager::FlushBatch()
+{
+	if (!HasOpenBatch())
+	{
+		return;
+	}
+
+	const size_t stagingEnd = reservations.empty() ? stagingHead : reservations.front().offset;
+	if (waitingBatch.commandBuffer == VK_NULL_HANDLE)
+	{
+		SubmitBatch(currentBatch, stagingEnd);
+		return;
+	}
+
+	// The waiting batch was handed out the value after the current batch's, so the current one is submitted even if empty.
+	// Their staging data is interleaved, so only the waiting batch frees the ring.
+	SubmitBatch(currentBatch, submittedBatches.empty() ? stagingTail : submittedBatches.back().stagingEnd);
+	SubmitBatch(waitingBatch, stagingEnd);
+}
+
+void UploadManager::SubmitBatch(Batch& batch, size_t stagingEnd)
+{
+	VkSubmitInfo submitInfo{};
+	submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+	if (batch.commandBuffer != VK_NULL_HANDLE)
+	{
+		VulkanCheck(vkEndCommandBuffer(batch.commandBuffer));
+		submitInfo.commandBufferCount = 1;
+		submitInfo.pCommandBuffers = &batch.commandBuffer;
+		++statistics.batchCount;
+	}
+	const uint64_t value = uploadTimeline->Submit(submitInfo, batch.waits.data(), (int)batch.waits.size());
+	if (batch.commandBuffer != VK_NULL_HANDLE && value != batch.value)
+	{
+		CoreLogError(DefaultLogger, "Upload manager: The upload timeline was submitted to from outside of the manager.");
+	}
+	batch.value = value;
+
+	batch.stagingEnd = stagingEnd;
+	batch.submitTime = std::chrono::steady_clock::now();
+
+	statistics.copyCount += batch.copyCount;
+	statistics.uploadedBytes += batch.byteCount;
+
+	submittedBatches.push_back(std::move(batch));
+	batch = Batch();
+}
+
+void UploadManager::RetireCompletedBatches()
+{
+	while (!submittedBatches.empty() && uploadTimeline->Reached(submittedBatches.front().value))
+	{
+		RetireBatch(submittedBatches.front());
+		submittedBatches.pop_front();
+	}
+}
+
+void UploadManager::RetireBatch(Batch& batch)
+{
+	stagingTail = batch.stagingEnd;
+	if (batch.commandBuffer == VK_NULL_HANDLE)
+	{
+		return;
+	}
+
+	// Only as precise as the polling, good enough to spot badly sized batches.
+	const std::chrono::duration<double, std::milli> batchTime = std::chrono::steady_clock::now() - batch.submitTime;
+	statistics.lastBatchCopyCount = batch.copyCount;
+	statistics.lastBatchBytes = batch.byteCount;
+	statistics.lastBatchMilliseconds = batchTime.count();
+
+	for (int b = 0; b < batch.dedicatedStagingBuffers.size(); ++b)
+	{
+		VmaAllocationInfo allocationInfo;
+		vmaGetAllocationInfo(backendData->allocator, batch.dedicatedStagingBuffers[b].allocation, &allocationInfo);
+		dedicatedStagingBytes -= allocationInfo.size;
+
+		vmaUnmapMemory(backendData->allocator, batch.dedicatedStagingBuffers[b].allocation);
+		VulkanBackend::DestroyBuffer(*backendData, batch.dedicatedStagingBuffers[b]);
+	}
+	freeCommandBuffers.push_back(batch.commandBuffer);
+}
@@ -0,0 +1,144 @@
+#pragma once
+#include "HawkEye/HawkEyeAPI.hpp"
+#include "Timeline.hpp"
+#include <VulkanBackend/VulkanBackendAPI.hpp>
+#include <vulkan/vulkan.hpp>
+#include <chrono>
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+// Batches uploads into one command buffer per submit. Data is staged in a persistently mapped ring buffer
+// whose regions are reclaimed once the upload timeline passes the batch that used them.
+// Uploads that have to wait on the GPU are recorded into a second batch, submitted right after the first one,
+// so that the other uploads are not held back by the wait.
+// All submits to the upload timeline have to go through the manager, so that the value a batch will signal
+// is known while it is being recorded.
+class UploadManager
+{
+public:
+	UploadManager() = default;
+	~UploadManager() = default;
+
+	void Init(VulkanBackend::BackendData* backendData, Timeline* uploadTimeline, int familyIndex, size_t stagingCapacity);
+	void Shutdown();
+
+	// Stages the data and lets the record function copy it out of the staging buffer at the given offset.
+	// Returns the upload timeline value that will be signaled once the copy finishes.
+	// The optional wait delays the upload on the GPU, e.g. until the frames reading an overwritten buffer finish.
+	// Waiting uploads execute after the other uploads recorded before the next flush.
+	template<typename Record>
+	uint64_t Upload(const void* data, size_t dataSize, Record&& record, const TimelineWait* wait = nullptr)
+	{
+		return UploadFilled(dataSize, [&](uint8_t* stagingData) { memcpy(stagingData, data, dataSize); },
+			std::forward<Record>(record), wait);
+	}
+
+	// Lets the fill function write the data straight into the staging memory, e.g. from a mapped file.
+	// The fill runs without holding the manager's lock, so uploads from several threads and Flush do not wait for it.
+	template<typename Fill, typename Record>
+	uint64_t UploadFilled(size_t dataSize, Fill&& fill, Record&& record, const TimelineWait* wait = nullptr)
+	{
+		Staging staging;
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			staging = AllocateStaging(dataSize, lock);
+		}
+
+		fill(staging.data);
+
+		std::lock_guard<std::mutex> lock(mutex);
+		Batch& batch = wait ? waitingBatch : currentBatch;
+		CommitStaging(staging, batch);
+		if (wait)
+		{
+			AddWait(batch, *wait);
+		}
+		record(batch.commandBuffer, staging.buffer, staging.offset);
+		++batch.copyCount;
+		batch.byteCount += dataSize;
+		return batch.value;
+	}
+
+	// Submits the batches being recorded (if any).
+	void Flush();
+	// Flushes first if the value belongs to the batch being recorded.
+	void Wait(uint64_t value);
+
+	HawkEye::UploadStatistics GetStatistics();
+	void GetStagingUsage(uint64_t& stagingBytes, uint64_t& stagingBytesInUse);
+
+private:
+	struct Batch
+	{
+		VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
+		uint64_t value = 0;
+		// Ring offset right after the batch's staging data.
+		size_t stagingEnd = 0;
+		// Uploads that did not fit into the ring.
+		std::vector<VulkanBackend::Buffer> dedicatedStagingBuffers;
+		// At most one per timeline.
+		std::vector<TimelineWait> waits;
+		uint64_t copyCount = 0;
+		uint64_t byteCount = 0;
+		std::chrono::steady_clock::time_point submitTime;
+	};
+
+	// Staging memory handed out to a fill, recorded into whichever batch is current once the fill is done.
+	struct Staging
+	{
+		uint8_t* data = nullptr;
+		VkBuffer buffer = VK_NULL_HANDLE;
+		VkDeviceSize offset = 0;
+		// Sequence number of the ring reservation, or the dedicated buffer for uploads that did not fit into the ring.
+		uint64_t reservation = 0;
+		VulkanBackend::Buffer dedicatedBuffer{};
+	};
+	struct Reservation
+	{
+		size_t offset;
+		bool committed;
+	};
+
+	// May wait with the lock released if only uncommitted reservations hold the ring.
+	Staging AllocateStaging(size_t dataSize, std::unique_lock<std::mutex>& lock);
+	void CommitStaging(const Staging& staging, Batch& batch);
+	bool TryAllocateStaging(size_t dataSize, size_t& offset);
+	bool IsStagingEmpty() const;
+	bool HasOpenBatch() const;
+	// The waiting batch is always submitted right after the current one, so its value is known up front as well.
+	void BeginBatch(Batch& batch);
+	void AddWait(Batch& batch, const TimelineWait& wait);
+	void FlushBatch();
+	// Batches without a command buffer only signal their value.
+	void SubmitBatch(Batch& batch, size_t stagingEnd);
+	void RetireCompletedBatches();
+	void RetireBatch(Batch& batch);
+
+	VulkanBackend::BackendData* backendData = nullptr;
+	Timeline* uploadTimeline = nullptr;
+	VkCommandPool commandPool = VK_NULL_HANDLE;
+	std::vector<VkCommandBuffer> freeCommandBuffers;
+
+	VulkanBackend::Buffer stagingRing{};
+	uint8_t* stagingRingData = nullptr;
+	size_t stagingCapacity = 0;
+	size_t stagingHead = 0;
+	size_t stagingTail = 0;
+	uint64_t dedicatedStagingBytes = 0;
+	// Ring regions whose fill has not been recorded yet, in ring order. A batch only frees the ring up to the oldest one,
+	// as its copy ends up in a later batch.
+	std::deque<Reservation> reservations;
+	uint64_t firstReservation = 0;
+	std::condition_variable stagingCommitted;
+
+	Batch currentBatch;
+	Batch waitingBatch;
+	std::deque<Batch> submittedBatches;
+
+	HawkEye::UploadStatistics statistics{};
+	std::mutex mutex;
+};
@@ -2,7 +2,8 @@
 #include <SoftwareCore/DefaultLogger.hpp>
 #include <regex>
 
-void ConfigureUniforms(const YAML::Node& passNode, std::vector<UniformData>& uniformData)
+void ConfigureUniforms(const YAML::Node& passNode, std::vector<UniformData>& uniformData,
+	std::vector<PushConstantData>* pushConstantData)
 {
 	if (passNode)
 	{
@@ -10,6 +11,7 @@ void ConfigureUniforms(const YAML::Node& passNode, std::vector<UniformData>& uni
 		for (int u = 0; u < passNode.size(); ++u)
 		{
 			VkDescriptorType type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+			bool pushConstant = false;
 			if (passNode[u]["type"])
 			{
 				std::string typeStr = passNode[u]["type"].as<std::string>();
@@ -23,6 +25,15 @@ void ConfigureUniforms(const YAML::Node& passNode, std::vector<UniformData>& uni
 					{
 						type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
 					}
+					else if (typeStr == "push-constant")
+					{
+						if (!pushConstantData)
+						{
+							CoreLogWarn(DefaultLogger, "Pipeline uniforms: Push constants are not supported here - skipping.");
+							continue;
+						}
+						pushConstant = true;
+					}
 				}
 			}
 
@@ -107,12 +118,17 @@ void ConfigureUniforms(const YAML::Node& passNode, std::vector<UniformData>& uni
 			std::string name = passNode[u]["name"].as<std::string>();
 
 			bool deviceLocal = false;
-			if (passNode["residency"])
+			if (passNode[u]["residency"])
 			{
 				if (type == VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER)
 				{
-					std::string residency = passNode["residency"].as<std::string>();
-					if (residency == "gpu")
+					std::string residency = passNode[u]["residency"].as<std::string>();
+					// Device-local uniforms are written with vkCmdUpdateBuffer, which works in multiples of 4 bytes.
+					if (residency == "gpu" && size % 4 != 0)
+					{
+						CoreLogError(DefaultLogger, "Pipeline uniforms: Device-local uniform size has to be a multiple of 4 - defaulting to cpu.");
+					}
+					else if (residency == "gpu")
 					{
 						deviceLocal = true;
 					}
@@ -132,6 +148,18 @@ void ConfigureUniforms(const YAML::Node& passNode, std::vector<UniformData>& uni
 				CoreLogError(DefaultLogger, "Pipeline uniforms: Name may not start with \'_\' - skipping.");
 				continue;
 			}
+
+			if (pushConstant)
+			{
+				// Push constant offsets and sizes have to be multiples of 4.
+				int offset = 0;
+				if (!pushConstantData->empty())
+				{
+					offset = pushConstantData->back().offset + pushConstantData->back().size;
+				}
+				pushConstantData->push_back({ name, offset, (size + 3) / 4 * 4, visibility });
+				continue;
+			}
 			uniformData.push_back(
 				{
 					name,
@@ -154,7 +182,7 @@ std::string FrameGraphConfigurator::GetName(const YAML::Node& nodeConfiguration)
 	return "";
 }
 
-VkFormat GetFormat(const YAML::Node& nodeConfiguration)
+static VkFormat GetFormat(const YAML::Node& nodeConfiguration)
 {
 	static std::map<std::string, int> typeOffset8
 	{
@@ -274,7 +302,7 @@ VkFormat GetFormat(const YAML::Node& nodeConfiguration)
 	return VK_FORMAT_UNDEFINED;
 }
 
-ImageFormat GetImageFormat(const YAML::Node& nodeConfiguration, TargetType type)
+static ImageFormat GetImageFormat(const YAML::Node& nodeConfiguration, TargetType type)
 {
 	ImageFormat imageFormat;
 	if (!nodeConfiguration["format"].IsDefined())
@@ -314,7 +342,7 @@ ImageFormat GetImageFormat(const YAML::Node& nodeConfiguration, TargetType type)
 	return imageFormat;
 }
 
-std::unique_ptr<OutputImageCharacteristics> GetOutputImageCharacteristics(const YAML::Node& nodeConfiguration, TargetType type)
+static std::unique_ptr<OutputImageCharacteristics> GetOutputImageCharacteristics(const YAML::Node& nodeConfiguration, TargetType type)
 {
 	// width modifier
 	float widthModifier = 1.f;
@@ -364,7 +392,7 @@ std::unique_ptr<OutputImageCharacteristics> GetOutputImageCharacteristics(const
 		OutputImageCharacteristics{ widthModifier, heightModifier, imageFormat, read, write });
 }
 
-std::unique_ptr<InputImageCharacteristics> GetInputImageCharacteristics(const YAML::Node& nodeConfiguration, TargetType type)
+static std::unique_ptr<InputImageCharacteristics> GetInputImageCharacteristics(const YAML::Node& nodeConfiguration, TargetType type)
 {
 	// width modifier
 	float widthModifier = 1.f;
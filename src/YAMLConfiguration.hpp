@@ -14,6 +14,15 @@ struct UniformData
 	bool deviceLocal;
 };
 
+// Uniform recorded into the command buffer with vkCmdPushConstants.
+struct PushConstantData
+{
+	std::string name;
+	int offset;
+	int size;
+	VkShaderStageFlags visibility;
+};
+
 struct VertexAttribute
 {
 	int byteCount;
@@ -32,7 +41,9 @@ enum class Shader
 	Compute
 };
 
-void ConfigureUniforms(const YAML::Node& passNode, std::vector<UniformData>& uniformData);
+// Push constants are only accepted if pushConstantData is provided.
+void ConfigureUniforms(const YAML::Node& passNode, std::vector<UniformData>& uniformData,
+	std::vector<PushConstantData>* pushConstantData = nullptr);
 
 namespace FrameGraphConfigurator
 {